@@ -291,6 +291,51 @@ static void cleanup_all_fds(void)
 	cleanup_fd(srst_fd, srst_gpio);
 }
 
+/*
+ * Batched scan: bit count (32 bit LE), flags, TMS and TDI vectors, answered
+ * with the TDO vector when bit 0 of the flags is set.
+ */
+static void process_scan(void)
+{
+	unsigned char hdr[5];
+	if (fread(hdr, 1, sizeof(hdr), stdin) != sizeof(hdr)) {
+		LOG_ERROR("Truncated scan request");
+		return;
+	}
+
+	unsigned bits = hdr[0] | hdr[1] << 8 | hdr[2] << 16 | (unsigned)hdr[3] << 24;
+	unsigned bytes = (bits + 7) / 8;
+	unsigned char *tms = malloc(bytes);
+	unsigned char *tdi = malloc(bytes);
+	unsigned char *tdo = calloc(bytes, 1);
+	if (!tms || !tdi || !tdo) {
+		LOG_ERROR("Out of memory");
+		goto done;
+	}
+
+	if (fread(tms, 1, bytes, stdin) != bytes || fread(tdi, 1, bytes, stdin) != bytes) {
+		LOG_ERROR("Truncated scan request");
+		goto done;
+	}
+
+	for (unsigned i = 0; i < bits; i++) {
+		int tms_bit = !!(tms[i / 8] & (1 << (i % 8)));
+		int tdi_bit = !!(tdi[i / 8] & (1 << (i % 8)));
+		sysfsgpio_write(0, tms_bit, tdi_bit);
+		if (sysfsgpio_read() == '1')
+			tdo[i / 8] |= 1 << (i % 8);
+		sysfsgpio_write(1, tms_bit, tdi_bit);
+	}
+
+	if (hdr[4] & 1)
+		fwrite(tdo, 1, bytes, stdout);
+
+done:
+	free(tms);
+	free(tdi);
+	free(tdo);
+}
+
 static void process_remote_protocol(void)
 {
 	int c;
@@ -311,6 +356,10 @@ static void process_remote_protocol(void)
 					(d & 1));
 		} else if (c == 'R')
 			putchar(sysfsgpio_read());
+		else if (c == 'V') /* Version: batched scans supported */
+			putchar('1');
+		else if (c == 'S')
+			process_scan();
 		else
 			LOG_ERROR("Unknown command '%c' received", c);
 	}
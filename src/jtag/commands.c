@@ -37,12 +37,41 @@
 struct cmd_queue_page {
 	struct cmd_queue_page *next;
 	void *address;
+	size_t size;
 	size_t used;
 };
 
 #define CMD_QUEUE_PAGE_SIZE (1024 * 1024)
+
+/*
+ * Pages are kept across jtag_command_queue_reset(), which only rewinds
+ * cmd_queue_cur; each page is emptied when the allocator steps onto it.
+ * Once the queue has grown to its high-water mark no further malloc() is
+ * needed.
+ */
 static struct cmd_queue_page *cmd_queue_pages;
-static struct cmd_queue_page *cmd_queue_pages_tail;
+static struct cmd_queue_page *cmd_queue_cur;
+static size_t cmd_queue_used;
+
+/*
+ * Scan buffers handed out by jtag_build_buffer() are recycled through
+ * per-size free lists, in power of two buckets from JTAG_BUFFER_MIN_SIZE
+ * up to JTAG_BUFFER_MAX_SIZE. Bigger buffers go straight to malloc().
+ */
+struct jtag_buffer {
+	struct jtag_buffer *next;
+	size_t bucket;
+	uint8_t data[];
+};
+
+#define JTAG_BUFFER_MIN_SHIFT 6
+#define JTAG_BUFFER_MIN_SIZE (1 << JTAG_BUFFER_MIN_SHIFT)
+#define JTAG_BUFFER_BUCKETS 11
+#define JTAG_BUFFER_MAX_SIZE (JTAG_BUFFER_MIN_SIZE << (JTAG_BUFFER_BUCKETS - 1))
+
+static struct jtag_buffer *jtag_buffer_free_list[JTAG_BUFFER_BUCKETS];
+
+static struct jtag_queue_stats cmd_queue_stats;
 
 struct jtag_command *jtag_command_queue;
 static struct jtag_command **next_command_pointer = &jtag_command_queue;
@@ -74,12 +103,21 @@ void jtag_queue_command(struct jtag_command *cmd)
 	next_command_pointer = &cmd->next;
 }
 
-void *cmd_queue_alloc(size_t size)
+static struct cmd_queue_page *cmd_queue_page_new(size_t size)
 {
-	struct cmd_queue_page **p_page = &cmd_queue_pages;
-	int offset;
-	uint8_t *t;
+	struct cmd_queue_page *page = malloc(sizeof(struct cmd_queue_page));
+	page->size = (size < CMD_QUEUE_PAGE_SIZE) ? CMD_QUEUE_PAGE_SIZE : size;
+	page->address = malloc(page->size);
+	page->used = 0;
+	page->next = NULL;
+
+	cmd_queue_stats.page_allocs++;
+	cmd_queue_stats.page_bytes += page->size;
+	return page;
+}
 
+void *cmd_queue_alloc(size_t size)
+{
 	/*
 	 * WARNING:
 	 *    We align/round the *SIZE* per below
@@ -112,27 +150,35 @@ void *cmd_queue_alloc(size_t size)
 	size = (size + ALIGN_SIZE - 1) & (~(ALIGN_SIZE - 1));
 	/* Done... */
 
-	if (*p_page) {
-		p_page = &cmd_queue_pages_tail;
-		if (CMD_QUEUE_PAGE_SIZE - (*p_page)->used < size)
-			p_page = &((*p_page)->next);
-	}
+	struct cmd_queue_page *page = cmd_queue_cur;
+	if (!page || page->size - page->used < size) {
+		struct cmd_queue_page *next = page ? page->next : cmd_queue_pages;
+
+		/* only an oversized request can miss a retained page */
+		if (!next || next->size < size) {
+			struct cmd_queue_page *fresh = cmd_queue_page_new(size);
+			fresh->next = next;
+			if (page)
+				page->next = fresh;
+			else
+				cmd_queue_pages = fresh;
+			next = fresh;
+		}
 
-	if (!*p_page) {
-		*p_page = malloc(sizeof(struct cmd_queue_page));
-		(*p_page)->used = 0;
-		size_t alloc_size = (size < CMD_QUEUE_PAGE_SIZE) ?
-					CMD_QUEUE_PAGE_SIZE : size;
-		(*p_page)->address = malloc(alloc_size);
-		(*p_page)->next = NULL;
-		cmd_queue_pages_tail = *p_page;
+		next->used = 0;
+		page = next;
+		cmd_queue_cur = page;
 	}
 
-	offset = (*p_page)->used;
-	(*p_page)->used += size;
+	uint8_t *t = page->address;
+	t += page->used;
+	page->used += size;
+
+	cmd_queue_used += size;
+	if (cmd_queue_used > cmd_queue_stats.high_water)
+		cmd_queue_stats.high_water = cmd_queue_used;
 
-	t = (*p_page)->address;
-	return t + offset;
+	return t;
 }
 
 static void cmd_queue_free(void)
@@ -147,17 +193,87 @@ static void cmd_queue_free(void)
 	}
 
 	cmd_queue_pages = NULL;
-	cmd_queue_pages_tail = NULL;
+	cmd_queue_cur = NULL;
+	cmd_queue_used = 0;
+	cmd_queue_stats.page_bytes = 0;
 }
 
 void jtag_command_queue_reset(void)
 {
-	cmd_queue_free();
+	/* keep the pages for the next queue */
+	cmd_queue_cur = NULL;
+	cmd_queue_used = 0;
 
 	jtag_command_queue = NULL;
 	next_command_pointer = &jtag_command_queue;
 }
 
+void jtag_command_queue_free(void)
+{
+	jtag_command_queue_reset();
+	cmd_queue_free();
+
+	for (unsigned int i = 0; i < JTAG_BUFFER_BUCKETS; i++) {
+		while (jtag_buffer_free_list[i]) {
+			struct jtag_buffer *b = jtag_buffer_free_list[i];
+			jtag_buffer_free_list[i] = b->next;
+			free(b);
+		}
+	}
+}
+
+void jtag_command_queue_stats(struct jtag_queue_stats *stats)
+{
+	*stats = cmd_queue_stats;
+}
+
+/* returns a zeroed buffer, to be released with jtag_free_buffer() */
+static uint8_t *jtag_alloc_buffer(size_t size)
+{
+	size_t bucket = 0;
+	while (bucket < JTAG_BUFFER_BUCKETS
+			&& ((size_t)JTAG_BUFFER_MIN_SIZE << bucket) < size)
+		bucket++;
+
+	struct jtag_buffer *b = NULL;
+	if (bucket < JTAG_BUFFER_BUCKETS) {
+		b = jtag_buffer_free_list[bucket];
+		if (b) {
+			jtag_buffer_free_list[bucket] = b->next;
+			cmd_queue_stats.buffer_reuses++;
+		} else {
+			b = malloc(sizeof(*b) + ((size_t)JTAG_BUFFER_MIN_SIZE << bucket));
+			cmd_queue_stats.buffer_allocs++;
+		}
+	} else {
+		b = malloc(sizeof(*b) + size);
+		cmd_queue_stats.buffer_allocs++;
+		cmd_queue_stats.buffer_oversize++;
+	}
+
+	if (!b)
+		return NULL;
+
+	b->bucket = bucket;
+	memset(b->data, 0, size);
+	return b->data;
+}
+
+void jtag_free_buffer(uint8_t *buffer)
+{
+	if (!buffer)
+		return;
+
+	struct jtag_buffer *b = (struct jtag_buffer *)(buffer - offsetof(struct jtag_buffer, data));
+	if (b->bucket >= JTAG_BUFFER_BUCKETS) {
+		free(b);
+		return;
+	}
+
+	b->next = jtag_buffer_free_list[b->bucket];
+	jtag_buffer_free_list[b->bucket] = b;
+}
+
 /**
  * Copy a struct scan_field for insertion into the queue.
  *
@@ -203,7 +319,7 @@ int jtag_build_buffer(const struct scan_command *cmd, uint8_t **buffer)
 	int i;
 
 	bit_count = jtag_scan_size(cmd);
-	*buffer = calloc(1, DIV_ROUND_UP(bit_count, 8));
+	*buffer = jtag_alloc_buffer(DIV_ROUND_UP(bit_count, 8));
 
 	bit_count = 0;
 
@@ -254,7 +370,7 @@ int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
 		if (cmd->fields[i].in_value) {
 			int num_bits = cmd->fields[i].num_bits;
 			uint8_t *captured = buf_set_buf(buffer, bit_count,
-					malloc(DIV_ROUND_UP(num_bits, 8)), 0, num_bits);
+					jtag_alloc_buffer(DIV_ROUND_UP(num_bits, 8)), 0, num_bits);
 
 			if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
 				char *char_buf = buf_to_str(captured,
@@ -270,7 +386,7 @@ int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
 			if (cmd->fields[i].in_value)
 				buf_cpy(captured, cmd->fields[i].in_value, num_bits);
 
-			free(captured);
+			jtag_free_buffer(captured);
 		}
 		bit_count += cmd->fields[i].num_bits;
 	}
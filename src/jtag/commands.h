@@ -167,11 +167,33 @@ void *cmd_queue_alloc(size_t size);
 
 void jtag_queue_command(struct jtag_command *cmd);
 void jtag_command_queue_reset(void);
+/** Release the memory retained by the command queue, on shutdown. */
+void jtag_command_queue_free(void);
+
+/** Allocation counters for the command queue and the scan buffers. */
+struct jtag_queue_stats {
+	/** Number of queue pages allocated. */
+	unsigned long page_allocs;
+	/** Memory held by the queue pages. */
+	size_t page_bytes;
+	/** Most queue memory used between two queue resets. */
+	size_t high_water;
+	/** Scan buffers obtained from malloc(). */
+	unsigned long buffer_allocs;
+	/** Scan buffers served from the free lists. */
+	unsigned long buffer_reuses;
+	/** Scan buffers too big for the free lists. */
+	unsigned long buffer_oversize;
+};
+
+void jtag_command_queue_stats(struct jtag_queue_stats *stats);
 
 void jtag_scan_field_clone(struct scan_field *dst, const struct scan_field *src);
 enum scan_type jtag_scan_type(const struct scan_command *cmd);
 int jtag_scan_size(const struct scan_command *cmd);
 int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd);
 int jtag_build_buffer(const struct scan_command *cmd, uint8_t **buffer);
+/** Release a buffer returned by jtag_build_buffer(). */
+void jtag_free_buffer(uint8_t *buffer);
 
 #endif /* OPENOCD_JTAG_COMMANDS_H */
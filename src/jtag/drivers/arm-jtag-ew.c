@@ -665,7 +665,7 @@ static int armjtagew_tap_execute(void)
 				}
 
 				if (pending_scan_result->buffer != NULL)
-					free(pending_scan_result->buffer);
+					jtag_free_buffer(pending_scan_result->buffer);
 			}
 		} else {
 			LOG_ERROR("armjtagew_tap_execute, wrong result %d, expected %d",
@@ -200,6 +200,39 @@ static int bitbang_stableclocks(int num_cycles)
 	return ERROR_OK;
 }
 
+/* Send the whole scan to the interface as TMS and TDI bit vectors */
+static int bitbang_scan_vector(enum scan_type type, uint8_t *buffer, unsigned scan_size)
+{
+	unsigned num_bytes = DIV_ROUND_UP(scan_size, 8);
+	int retval;
+
+	/* TMS is only set on the last bit, to leave the shift state */
+	uint8_t *tms = calloc(num_bytes, 1);
+	if (!tms) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	buf_set_u32(tms, scan_size - 1, 1, 1);
+
+	/* output 'low' when just reading the scan, like the bit by bit path */
+	uint8_t *tdi = buffer;
+	if (type == SCAN_IN) {
+		tdi = calloc(num_bytes, 1);
+		if (!tdi) {
+			free(tms);
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	retval = bitbang_interface->scan(tms, tdi, (type != SCAN_OUT) ? buffer : NULL, scan_size);
+
+	free(tms);
+	if (tdi != buffer)
+		free(tdi);
+	return retval;
+}
+
 static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		unsigned scan_size)
 {
@@ -219,62 +252,67 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		bitbang_end_state(saved_end_state);
 	}
 
-	size_t buffered = 0;
-	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
-		int tms = (bit_cnt == scan_size-1) ? 1 : 0;
-		int tdi;
-		int bytec = bit_cnt/8;
-		int bcval = 1 << (bit_cnt % 8);
-
-		/* if we're just reading the scan, but don't care about the output
-		 * default to outputting 'low', this also makes valgrind traces more readable,
-		 * as it removes the dependency on an uninitialised value
-		 */
-		tdi = 0;
-		if ((type != SCAN_IN) && (buffer[bytec] & bcval))
-			tdi = 1;
-
-		if (bitbang_interface->write(0, tms, tdi) != ERROR_OK)
+	if (bitbang_interface->scan) {
+		if (bitbang_scan_vector(type, buffer, scan_size) != ERROR_OK)
 			return ERROR_FAIL;
-
-		if (type != SCAN_OUT) {
-			if (bitbang_interface->buf_size) {
-				if (bitbang_interface->sample() != ERROR_OK)
-					return ERROR_FAIL;
-				buffered++;
-			} else {
-				switch (bitbang_interface->read()) {
-					case BB_LOW:
-						buffer[bytec] &= ~bcval;
-						break;
-					case BB_HIGH:
-						buffer[bytec] |= bcval;
-						break;
-					default:
+	} else {
+		size_t buffered = 0;
+		for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
+			int tms = (bit_cnt == scan_size-1) ? 1 : 0;
+			int tdi;
+			int bytec = bit_cnt/8;
+			int bcval = 1 << (bit_cnt % 8);
+
+			/* if we're just reading the scan, but don't care about the output
+			 * default to outputting 'low', this also makes valgrind traces more readable,
+			 * as it removes the dependency on an uninitialised value
+			 */
+			tdi = 0;
+			if ((type != SCAN_IN) && (buffer[bytec] & bcval))
+				tdi = 1;
+
+			if (bitbang_interface->write(0, tms, tdi) != ERROR_OK)
+				return ERROR_FAIL;
+
+			if (type != SCAN_OUT) {
+				if (bitbang_interface->buf_size) {
+					if (bitbang_interface->sample() != ERROR_OK)
 						return ERROR_FAIL;
+					buffered++;
+				} else {
+					switch (bitbang_interface->read()) {
+						case BB_LOW:
+							buffer[bytec] &= ~bcval;
+							break;
+						case BB_HIGH:
+							buffer[bytec] |= bcval;
+							break;
+						default:
+							return ERROR_FAIL;
+					}
 				}
 			}
-		}
 
-		if (bitbang_interface->write(1, tms, tdi) != ERROR_OK)
-			return ERROR_FAIL;
-
-		if (type != SCAN_OUT && bitbang_interface->buf_size &&
-				(buffered == bitbang_interface->buf_size ||
-				 bit_cnt == scan_size - 1)) {
-			for (unsigned i = bit_cnt + 1 - buffered; i <= bit_cnt; i++) {
-				switch (bitbang_interface->read_sample()) {
-					case BB_LOW:
-						buffer[i/8] &= ~(1 << (i % 8));
-						break;
-					case BB_HIGH:
-						buffer[i/8] |= 1 << (i % 8);
-						break;
-					default:
-						return ERROR_FAIL;
+			if (bitbang_interface->write(1, tms, tdi) != ERROR_OK)
+				return ERROR_FAIL;
+
+			if (type != SCAN_OUT && bitbang_interface->buf_size &&
+					(buffered == bitbang_interface->buf_size ||
+					 bit_cnt == scan_size - 1)) {
+				for (unsigned i = bit_cnt + 1 - buffered; i <= bit_cnt; i++) {
+					switch (bitbang_interface->read_sample()) {
+						case BB_LOW:
+							buffer[i/8] &= ~(1 << (i % 8));
+							break;
+						case BB_HIGH:
+							buffer[i/8] |= 1 << (i % 8);
+							break;
+						default:
+							return ERROR_FAIL;
+					}
 				}
+				buffered = 0;
 			}
-			buffered = 0;
 		}
 	}
 
@@ -289,6 +327,65 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 	return ERROR_OK;
 }
 
+/* Scans sent through bitbang_interface->scan whose TDO data is checked
+ * only after bitbang_interface->flush(), at the end of the queue */
+struct bitbang_pending_scan {
+	struct scan_command *scan;
+	uint8_t *buffer;
+};
+
+static struct bitbang_pending_scan *pending_scans;
+static unsigned pending_scan_count;
+static unsigned pending_scan_size;
+
+static int bitbang_add_pending_scan(struct scan_command *scan, uint8_t *buffer)
+{
+	if (pending_scan_count == pending_scan_size) {
+		unsigned new_size = pending_scan_size ? 2 * pending_scan_size : 64;
+		struct bitbang_pending_scan *new_scans = realloc(pending_scans,
+				new_size * sizeof(*pending_scans));
+		if (!new_scans) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		pending_scans = new_scans;
+		pending_scan_size = new_size;
+	}
+
+	pending_scans[pending_scan_count].scan = scan;
+	pending_scans[pending_scan_count].buffer = buffer;
+	pending_scan_count++;
+	return ERROR_OK;
+}
+
+static void bitbang_discard_pending_scans(void)
+{
+	for (unsigned i = 0; i < pending_scan_count; i++)
+		jtag_free_buffer(pending_scans[i].buffer);
+	pending_scan_count = 0;
+}
+
+static int bitbang_read_pending_scans(void)
+{
+	int retval = ERROR_OK;
+
+	if (!pending_scan_count)
+		return ERROR_OK;
+
+	if (bitbang_interface->flush() != ERROR_OK) {
+		bitbang_discard_pending_scans();
+		return ERROR_FAIL;
+	}
+
+	for (unsigned i = 0; i < pending_scan_count; i++) {
+		if (jtag_read_buffer(pending_scans[i].buffer, pending_scans[i].scan) != ERROR_OK)
+			retval = ERROR_JTAG_QUEUE_FAILED;
+	}
+
+	bitbang_discard_pending_scans();
+	return retval;
+}
+
 int bitbang_execute_queue(void)
 {
 	struct jtag_command *cmd = jtag_command_queue;	/* currently processed command */
@@ -307,6 +404,9 @@ int bitbang_execute_queue(void)
 	 */
 	retval = ERROR_OK;
 
+	/* left over from a queue that failed */
+	bitbang_discard_pending_scans();
+
 	if (bitbang_interface->blink) {
 		if (bitbang_interface->blink(1) != ERROR_OK)
 			return ERROR_FAIL;
@@ -354,15 +454,31 @@ int bitbang_execute_queue(void)
 					tap_state_name(cmd->cmd.scan->end_state));
 				type = jtag_scan_type(cmd->cmd.scan);
 				if (bitbang_scan(cmd->cmd.scan->ir_scan, type, buffer,
-							scan_size) != ERROR_OK)
+							scan_size) != ERROR_OK) {
+					jtag_free_buffer(buffer);
 					return ERROR_FAIL;
+				}
+				if (bitbang_interface->scan) {
+					if (bitbang_add_pending_scan(cmd->cmd.scan, buffer) != ERROR_OK) {
+						jtag_free_buffer(buffer);
+						return ERROR_FAIL;
+					}
+					break;
+				}
 				if (jtag_read_buffer(buffer, cmd->cmd.scan) != ERROR_OK)
 					retval = ERROR_JTAG_QUEUE_FAILED;
 				if (buffer)
-					free(buffer);
+					jtag_free_buffer(buffer);
 				break;
 			case JTAG_SLEEP:
 				LOG_DEBUG_IO("sleep %" PRIi32, cmd->cmd.sleep->us);
+				if (bitbang_interface->scan) {
+					int pending_retval = bitbang_read_pending_scans();
+					if (pending_retval == ERROR_FAIL)
+						return ERROR_FAIL;
+					if (pending_retval != ERROR_OK)
+						retval = pending_retval;
+				}
 				jtag_sleep(cmd->cmd.sleep->us);
 				break;
 			case JTAG_TMS:
@@ -374,6 +490,15 @@ int bitbang_execute_queue(void)
 		}
 		cmd = cmd->next;
 	}
+
+	if (bitbang_interface->scan) {
+		int pending_retval = bitbang_read_pending_scans();
+		if (pending_retval == ERROR_FAIL)
+			return ERROR_FAIL;
+		if (pending_retval != ERROR_OK)
+			retval = pending_retval;
+	}
+
 	if (bitbang_interface->blink) {
 		if (bitbang_interface->blink(0) != ERROR_OK)
 			return ERROR_FAIL;
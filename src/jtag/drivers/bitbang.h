@@ -51,6 +51,15 @@ struct bitbang_interface {
 
 	/** Set TCK, TMS, and TDI to the given values. */
 	int (*write)(int tck, int tms, int tdi);
+
+	/** Optional: clock out a whole scan of @a bits cycles at once. For each
+	 * bit TCK is driven low with the TMS and TDI values, TDO is sampled,
+	 * then TCK is driven high. If @a tdo is not NULL the TDO samples are
+	 * stored there, but possibly only once flush() returns. */
+	int (*scan)(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo, unsigned bits);
+	/** Wait for the TDO samples of all the scans issued so far. Required
+	 * if scan is provided. */
+	int (*flush)(void);
 	int (*blink)(int on);
 	int (*swdio_read)(void);
 	void (*swdio_drive)(bool on);
@@ -181,6 +181,8 @@ struct pending_transfer_result {
 struct pending_request_block {
 	struct pending_transfer_result *transfers;
 	int transfer_count;
+	/** CMD_DAP_TFER or CMD_DAP_TFER_BLOCK, decided when the block is sent */
+	uint8_t command;
 };
 
 struct pending_scan_result {
@@ -194,14 +196,16 @@ struct pending_scan_result {
 	unsigned buffer_offset;
 };
 
-/* Up to MIN(packet_count, MAX_PENDING_REQUESTS) requests may be issued
- * until the first response arrives */
-#define MAX_PENDING_REQUESTS 3
-
-/* Pending requests are organized as a FIFO - circular buffer */
-/* Each block in FIFO can contain up to pending_queue_len transfers */
+/* Pending requests are organized as a FIFO - circular buffer.
+ * Up to packet_count requests (as reported by the adapter) may be issued
+ * until the first response arrives, so the FIFO is sized at init time. */
+/* Each block in FIFO can contain up to pending_queue_len transfers of
+ * mixed registers (sent as DAP_Transfer), or up to pending_block_len
+ * transfers when all of them access the same register (sent as
+ * DAP_TransferBlock) */
 static int pending_queue_len;
-static struct pending_request_block pending_fifo[MAX_PENDING_REQUESTS];
+static int pending_block_len;
+static struct pending_request_block *pending_fifo;
 static int pending_fifo_put_idx, pending_fifo_get_idx;
 static int pending_fifo_block_count;
 
@@ -320,6 +324,7 @@ static int cmsis_dap_usb_open(void)
 	dap->dev_handle = dev;
 	dap->caps = 0;
 	dap->mode = 0;
+	dap->packet_count = 0;
 
 	cmsis_dap_handle = dap;
 
@@ -354,17 +359,19 @@ static void cmsis_dap_usb_close(struct cmsis_dap *dap)
 	hid_close(dap->dev_handle);
 	hid_exit();
 
+	if (pending_fifo) {
+		for (int i = 0; i < dap->packet_count; i++)
+			free(pending_fifo[i].transfers);
+		free(pending_fifo);
+		pending_fifo = NULL;
+	}
+
 	free(cmsis_dap_handle->packet_buffer);
 	free(cmsis_dap_handle);
 	cmsis_dap_handle = NULL;
 	free(cmsis_dap_serial);
 	cmsis_dap_serial = NULL;
 
-	for (int i = 0; i < MAX_PENDING_REQUESTS; i++) {
-		free(pending_fifo[i].transfers);
-		pending_fifo[i].transfers = NULL;
-	}
-
 	return;
 }
 
@@ -644,11 +651,29 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 	if (block->transfer_count == 0)
 		goto skip;
 
+	/* A run of accesses to one register (typically DRW during a
+	 * MEM-AP bulk transfer) is sent as a single DAP_TransferBlock,
+	 * which needs only one request byte for the whole run */
+	block->command = CMD_DAP_TFER;
+	if (block->transfer_count > 1) {
+		block->command = CMD_DAP_TFER_BLOCK;
+		for (int i = 1; i < block->transfer_count; i++) {
+			if (block->transfers[i].cmd != block->transfers[0].cmd) {
+				block->command = CMD_DAP_TFER;
+				break;
+			}
+		}
+	}
+
 	size_t idx = 0;
 	buffer[idx++] = 0;	/* report number */
-	buffer[idx++] = CMD_DAP_TFER;
+	buffer[idx++] = block->command;
 	buffer[idx++] = 0x00;	/* DAP Index */
-	buffer[idx++] = block->transfer_count;
+	buffer[idx++] = block->transfer_count & 0xff;
+	if (block->command == CMD_DAP_TFER_BLOCK) {
+		buffer[idx++] = (block->transfer_count >> 8) & 0xff;
+		buffer[idx++] = (block->transfers[0].cmd >> 1) & 0x0f;
+	}
 
 	for (int i = 0; i < block->transfer_count; i++) {
 		struct pending_transfer_result *transfer = &(block->transfers[i]);
@@ -679,7 +704,8 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 			data &= ~CORUNDETECT;
 		}
 
-		buffer[idx++] = (cmd >> 1) & 0x0f;
+		if (block->command == CMD_DAP_TFER)
+			buffer[idx++] = (cmd >> 1) & 0x0f;
 		if (!(cmd & SWD_CMD_RnW)) {
 			buffer[idx++] = (data) & 0xff;
 			buffer[idx++] = (data >> 8) & 0xff;
@@ -722,26 +748,46 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
 		goto skip;
 	}
 
-	if (buffer[2] & 0x08) {
-		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", buffer[1]);
+	if (buffer[0] != block->command) {
+		LOG_DEBUG("CMSIS-DAP response to wrong command 0x%02" PRIx8, buffer[0]);
+		queued_retval = ERROR_FAIL;
+		goto skip;
+	}
+
+	/* DAP_Transfer replies with an 8 bit transfer count, DAP_TransferBlock
+	 * with a 16 bit one, both followed by the transfer response byte */
+	int transfer_count;
+	uint8_t response;
+	size_t idx;
+	if (block->command == CMD_DAP_TFER_BLOCK) {
+		transfer_count = le_to_h_u16(&buffer[1]);
+		response = buffer[3];
+		idx = 4;
+	} else {
+		transfer_count = buffer[1];
+		response = buffer[2];
+		idx = 3;
+	}
+
+	if (response & 0x08) {
+		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", transfer_count);
 		queued_retval = ERROR_FAIL;
 		goto skip;
 	}
-	uint8_t ack = buffer[2] & 0x07;
+	uint8_t ack = response & 0x07;
 	if (ack != SWD_ACK_OK) {
-		LOG_DEBUG("SWD ack not OK @ %d %s", buffer[1],
+		LOG_DEBUG("SWD ack not OK @ %d %s", transfer_count,
 			  ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK");
 		queued_retval = ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
 		goto skip;
 	}
 
-	if (block->transfer_count != buffer[1])
+	if (block->transfer_count != transfer_count)
 		LOG_ERROR("CMSIS-DAP transfer count mismatch: expected %d, got %d",
-			  block->transfer_count, buffer[1]);
+			  block->transfer_count, transfer_count);
 
-	LOG_DEBUG_IO("Received results of %d queued transactions FIFO index %d", buffer[1], pending_fifo_get_idx);
-	size_t idx = 3;
-	for (int i = 0; i < buffer[1]; i++) {
+	LOG_DEBUG_IO("Received results of %d queued transactions FIFO index %d", transfer_count, pending_fifo_get_idx);
+	for (int i = 0; i < transfer_count && i < block->transfer_count; i++) {
 		struct pending_transfer_result *transfer = &(block->transfers[i]);
 		if (transfer->cmd & SWD_CMD_RnW) {
 			static uint32_t last_read;
@@ -788,9 +834,30 @@ static int cmsis_dap_swd_run_queue(void)
 	return retval;
 }
 
+/* Returns true if the transfer fits into the block being filled. Runs of
+ * transfers to the same register may grow up to pending_block_len, as they
+ * will be sent as a DAP_TransferBlock; anything else is limited to
+ * pending_queue_len by the DAP_Transfer encoding. */
+static bool cmsis_dap_swd_block_has_room(struct pending_request_block *block, uint8_t cmd)
+{
+	/* stays a valid DAP_Transfer whatever the mix of registers */
+	if (block->transfer_count < pending_queue_len)
+		return true;
+
+	if (block->transfer_count >= pending_block_len)
+		return false;
+
+	/* past the DAP_Transfer limit only a uniform run may continue */
+	for (int i = 0; i < block->transfer_count; i++) {
+		if (block->transfers[i].cmd != cmd)
+			return false;
+	}
+	return true;
+}
+
 static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 {
-	if (pending_fifo[pending_fifo_put_idx].transfer_count == pending_queue_len) {
+	if (!cmsis_dap_swd_block_has_room(&pending_fifo[pending_fifo_put_idx], cmd)) {
 		if (pending_fifo_block_count)
 			cmsis_dap_swd_read_process(cmsis_dap_handle, 0);
 
@@ -1011,6 +1078,7 @@ static int cmsis_dap_init(void)
 	 * until we get packet count info from the adaptor */
 	cmsis_dap_handle->packet_count = 1;
 	pending_queue_len = 12;
+	pending_block_len = (cmsis_dap_handle->packet_size - 1 - 5) / 4;
 
 	/* INFO_ID_PKT_SZ - short */
 	retval = cmsis_dap_cmd_DAP_Info(INFO_ID_PKT_SZ, &data);
@@ -1021,9 +1089,11 @@ static int cmsis_dap_init(void)
 		uint16_t pkt_sz = data[1] + (data[2] << 8);
 
 		/* 4 bytes of command header + 5 bytes per register
-		 * write. For bulk read sequences just 4 bytes are
-		 * needed per transfer, so this is suboptimal. */
+		 * write. Runs of accesses to the same register are sent
+		 * as DAP_TransferBlock, which has a 5 bytes header and
+		 * needs just 4 bytes per transfer in either direction. */
 		pending_queue_len = (pkt_sz - 4) / 5;
+		pending_block_len = (pkt_sz - 5) / 4;
 
 		if (cmsis_dap_handle->packet_size != pkt_sz + 1) {
 			/* reallocate buffer */
@@ -1047,14 +1117,20 @@ static int cmsis_dap_init(void)
 	if (data[0] == 1) { /* byte */
 		int pkt_cnt = data[1];
 		if (pkt_cnt > 1)
-			cmsis_dap_handle->packet_count = MIN(MAX_PENDING_REQUESTS, pkt_cnt);
+			cmsis_dap_handle->packet_count = pkt_cnt;
 
 		LOG_DEBUG("CMSIS-DAP: Packet Count = %d", pkt_cnt);
 	}
 
 	LOG_DEBUG("Allocating FIFO for %d pending HID requests", cmsis_dap_handle->packet_count);
+	pending_fifo = calloc(cmsis_dap_handle->packet_count, sizeof(struct pending_request_block));
+	if (!pending_fifo) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
+		return ERROR_FAIL;
+	}
 	for (int i = 0; i < cmsis_dap_handle->packet_count; i++) {
-		pending_fifo[i].transfers = malloc(pending_queue_len * sizeof(struct pending_transfer_result));
+		pending_fifo[i].transfers = malloc(MAX(pending_queue_len, pending_block_len)
+				* sizeof(struct pending_transfer_result));
 		if (!pending_fifo[i].transfers) {
 			LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
 			return ERROR_FAIL;
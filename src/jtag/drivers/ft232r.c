@@ -887,7 +887,7 @@ static int syncbb_execute_queue(void)
 				if (jtag_read_buffer(buffer, cmd->cmd.scan) != ERROR_OK)
 					retval = ERROR_JTAG_QUEUE_FAILED;
 				if (buffer)
-					free(buffer);
+					jtag_free_buffer(buffer);
 				break;
 
 			case JTAG_SLEEP:
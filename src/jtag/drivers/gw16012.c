@@ -328,7 +328,7 @@ static int gw16012_execute_queue(void)
 				if (jtag_read_buffer(buffer, cmd->cmd.scan) != ERROR_OK)
 					retval = ERROR_JTAG_QUEUE_FAILED;
 				if (buffer)
-					free(buffer);
+					jtag_free_buffer(buffer);
 				break;
 			case JTAG_SLEEP:
 				LOG_DEBUG_IO("sleep %i", cmd->cmd.sleep->us);
@@ -49,6 +49,11 @@
 #define CMD_SCAN_CHAIN_FLIP_TMS	3
 #define CMD_STOP_SIMU		4
 
+/* Number of commands gathered before they are sent in one go. This also
+ * bounds the responses in flight, which must fit in the socket buffers. */
+#define VPI_QUEUE_SIZE		64
+#define VPI_SOCKET_BUF		(2 * VPI_QUEUE_SIZE * sizeof(struct vpi_cmd))
+
 /* jtag_vpi server port and address to connect to */
 static int server_port = SERVER_PORT;
 static char *server_address;
@@ -77,6 +82,32 @@ struct vpi_cmd {
 	};
 };
 
+/* Send the commands of a whole JTAG queue before waiting for the responses? */
+static bool pipeline = true;
+
+/* Commands waiting to be sent, already in little endian */
+static struct vpi_cmd *vpi_queue;
+static unsigned vpi_queue_len;
+
+/* Scan responses expected for the commands sent */
+struct vpi_response {
+	uint8_t *bits;
+	int nb_bits;
+};
+
+static struct vpi_response vpi_responses[VPI_QUEUE_SIZE];
+static unsigned vpi_responses_len;
+
+/* Scans whose captured data is handed back at the end of the JTAG queue */
+struct vpi_pending_scan {
+	struct scan_command *cmd;
+	uint8_t *buf;
+};
+
+static struct vpi_pending_scan *pending_scans;
+static unsigned pending_scans_len;
+static unsigned pending_scans_size;
+
 static char *jtag_vpi_cmd_to_str(int cmd_num)
 {
 	switch (cmd_num) {
@@ -95,10 +126,53 @@ static char *jtag_vpi_cmd_to_str(int cmd_num)
 	}
 }
 
-static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
+static int jtag_vpi_flush(void);
+
+static int jtag_vpi_write(const char *buf, size_t len)
 {
-	int retval;
+	while (len) {
+		int retval = write_socket(sockfd, buf, len);
 
+		if (retval < 0) {
+			/* Account for the case when socket write is interrupted. */
+#ifdef _WIN32
+			int wsa_err = WSAGetLastError();
+			if (wsa_err == WSAEINTR)
+				continue;
+#else
+			if (errno == EINTR)
+				continue;
+#endif
+			/* Otherwise this is an error using the socket, most likely fatal
+			   for the connection. B*/
+			log_socket_error("jtag_vpi xmit");
+			/* TODO: Clean way how adapter drivers can report fatal errors
+			   to upper layers of OpenOCD and let it perform an orderly shutdown? */
+			exit(-1);
+		} else if (retval == 0) {
+			/* This means we could not send all data, which is most likely fatal
+			   for the jtag_vpi connection (the underlying TCP connection likely not
+			   usable anymore) */
+			LOG_ERROR("Could not send all data through jtag_vpi connection.");
+			exit(-1);
+		}
+
+		buf += retval;
+		len -= retval;
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_send_cmd - queue a command for the server
+ * @vpi: the command
+ *
+ * In pipeline mode the command is only sent once the queue is full or
+ * flushed, otherwise it is sent right away.
+ */
+static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
+{
 	/* Optional low-level JTAG debug */
 	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
 		if (vpi->nb_bits > 0) {
@@ -137,34 +211,16 @@ static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
 	h_u32_to_le(vpi->length_buf, vpi->length);
 	h_u32_to_le(vpi->nb_bits_buf, vpi->nb_bits);
 
-retry_write:
-	retval = write_socket(sockfd, vpi, sizeof(struct vpi_cmd));
+	if (!pipeline)
+		return jtag_vpi_write((char *)vpi, sizeof(struct vpi_cmd));
 
-	if (retval < 0) {
-		/* Account for the case when socket write is interrupted. */
-#ifdef _WIN32
-		int wsa_err = WSAGetLastError();
-		if (wsa_err == WSAEINTR)
-			goto retry_write;
-#else
-		if (errno == EINTR)
-			goto retry_write;
-#endif
-		/* Otherwise this is an error using the socket, most likely fatal
-		   for the connection. B*/
-		log_socket_error("jtag_vpi xmit");
-		/* TODO: Clean way how adapter drivers can report fatal errors
-		   to upper layers of OpenOCD and let it perform an orderly shutdown? */
-		exit(-1);
-	} else if (retval < (int)sizeof(struct vpi_cmd)) {
-		/* This means we could not send all data, which is most likely fatal
-		   for the jtag_vpi connection (the underlying TCP connection likely not
-		   usable anymore) */
-		LOG_ERROR("Could not send all data through jtag_vpi connection.");
-		exit(-1);
+	if (vpi_queue_len == VPI_QUEUE_SIZE) {
+		int retval = jtag_vpi_flush();
+		if (retval != ERROR_OK)
+			return retval;
 	}
 
-	/* Otherwise the packet has been sent successfully. */
+	memcpy(&vpi_queue[vpi_queue_len++], vpi, sizeof(struct vpi_cmd));
 	return ERROR_OK;
 }
 
@@ -207,6 +263,87 @@ static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
 	return ERROR_OK;
 }
 
+static int jtag_vpi_receive_response(struct vpi_response *response)
+{
+	struct vpi_cmd vpi;
+	int nb_bits = response->nb_bits;
+
+	int retval = jtag_vpi_receive_cmd(&vpi);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* Optional low-level JTAG debug */
+	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
+		char *char_buf = buf_to_str(vpi.buffer_in,
+				(nb_bits > DEBUG_JTAG_IOZ) ? DEBUG_JTAG_IOZ : nb_bits,
+				16);
+		LOG_DEBUG_IO("recvd JTAG VPI data: nb_bits=%d, buf_in=0x%s%s",
+			nb_bits, char_buf, (nb_bits > DEBUG_JTAG_IOZ) ? "(...)" : "");
+		free(char_buf);
+	}
+
+	if (response->bits)
+		memcpy(response->bits, vpi.buffer_in, DIV_ROUND_UP(nb_bits, 8));
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_flush - send the queued commands and collect their responses
+ *
+ * All the queued commands go out in a single write, then the responses to
+ * the scan commands among them are read back in order. The server only
+ * answers scans, so the round trip is paid once per flush.
+ */
+static int jtag_vpi_flush(void)
+{
+	int retval = ERROR_OK;
+
+	if (vpi_queue_len) {
+		retval = jtag_vpi_write((char *)vpi_queue, vpi_queue_len * sizeof(struct vpi_cmd));
+		vpi_queue_len = 0;
+	}
+
+	for (unsigned i = 0; retval == ERROR_OK && i < vpi_responses_len; i++)
+		retval = jtag_vpi_receive_response(&vpi_responses[i]);
+	vpi_responses_len = 0;
+
+	return retval;
+}
+
+static int jtag_vpi_add_pending_scan(struct scan_command *cmd, uint8_t *buf)
+{
+	if (pending_scans_len == pending_scans_size) {
+		unsigned new_size = pending_scans_size ? 2 * pending_scans_size : 32;
+		struct vpi_pending_scan *new_scans = realloc(pending_scans,
+				new_size * sizeof(*pending_scans));
+		if (!new_scans) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		pending_scans = new_scans;
+		pending_scans_size = new_size;
+	}
+
+	pending_scans[pending_scans_len].cmd = cmd;
+	pending_scans[pending_scans_len].buf = buf;
+	pending_scans_len++;
+	return ERROR_OK;
+}
+
+/* Hand the captured data of the scans back, once all the responses are in */
+static int jtag_vpi_read_pending_scans(int retval)
+{
+	for (unsigned i = 0; i < pending_scans_len; i++) {
+		if (retval == ERROR_OK)
+			retval = jtag_read_buffer(pending_scans[i].buf, pending_scans[i].cmd);
+		jtag_free_buffer(pending_scans[i].buf);
+	}
+	pending_scans_len = 0;
+
+	return retval;
+}
+
 /**
  * jtag_vpi_reset - ask to reset the JTAG device
  * @trst: 1 if TRST is to be asserted
@@ -322,22 +459,13 @@ static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = jtag_vpi_receive_cmd(&vpi);
-	if (retval != ERROR_OK)
-		return retval;
+	/* the response lands in bits once the queue is flushed */
+	vpi_responses[vpi_responses_len].bits = bits;
+	vpi_responses[vpi_responses_len].nb_bits = nb_bits;
+	vpi_responses_len++;
 
-	/* Optional low-level JTAG debug */
-	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
-		char *char_buf = buf_to_str(vpi.buffer_in,
-				(nb_bits > DEBUG_JTAG_IOZ) ? DEBUG_JTAG_IOZ : nb_bits,
-				16);
-		LOG_DEBUG_IO("recvd JTAG VPI data: nb_bits=%d, buf_in=0x%s%s",
-			nb_bits, char_buf, (nb_bits > DEBUG_JTAG_IOZ) ? "(...)" : "");
-		free(char_buf);
-	}
-
-	if (bits)
-		memcpy(bits, vpi.buffer_in, nb_bytes);
+	if (!pipeline)
+		return jtag_vpi_flush();
 
 	return ERROR_OK;
 }
@@ -437,12 +565,12 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 			tap_set_state(TAP_DRPAUSE);
 	}
 
-	retval = jtag_read_buffer(buf, cmd);
-	if (retval != ERROR_OK)
+	/* buf is filled in by the responses, possibly later in the queue */
+	retval = jtag_vpi_add_pending_scan(cmd, buf);
+	if (retval != ERROR_OK) {
+		jtag_free_buffer(buf);
 		return retval;
-
-	if (buf)
-		free(buf);
+	}
 
 	if (cmd->end_state != TAP_DRSHIFT) {
 		retval = jtag_vpi_state_move(cmd->end_state);
@@ -521,6 +649,7 @@ static int jtag_vpi_execute_queue(void)
 			retval = jtag_vpi_tms(cmd->cmd.tms);
 			break;
 		case JTAG_SLEEP:
+			retval = jtag_vpi_flush();
 			jtag_sleep(cmd->cmd.sleep->us);
 			break;
 		case JTAG_SCAN:
@@ -534,12 +663,26 @@ static int jtag_vpi_execute_queue(void)
 		}
 	}
 
-	return retval;
+	if (retval == ERROR_OK)
+		retval = jtag_vpi_flush();
+	else
+		jtag_vpi_flush();
+
+	return jtag_vpi_read_pending_scans(retval);
 }
 
 static int jtag_vpi_init(void)
 {
 	int flag = 1;
+	int buf_size = VPI_SOCKET_BUF;
+
+	vpi_queue = malloc(VPI_QUEUE_SIZE * sizeof(struct vpi_cmd));
+	if (!vpi_queue) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	vpi_queue_len = 0;
+	vpi_responses_len = 0;
 
 	sockfd = socket(AF_INET, SOCK_STREAM, 0);
 	if (sockfd < 0) {
@@ -575,6 +718,11 @@ static int jtag_vpi_init(void)
 		setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char *)&flag, sizeof(int));
 	}
 
+	/* Room for all the responses to a full queue, so that the server never
+	 * blocks on them while we are still sending. */
+	setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, (char *)&buf_size, sizeof(buf_size));
+	setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, (char *)&buf_size, sizeof(buf_size));
+
 	LOG_INFO("Connection to %s : %u succeed", server_address, server_port);
 
 	return ERROR_OK;
@@ -587,7 +735,12 @@ static int jtag_vpi_stop_simulation(void)
 	cmd.length = 0;
 	cmd.nb_bits = 0;
 	cmd.cmd = CMD_STOP_SIMU;
-	return jtag_vpi_send_cmd(&cmd);
+
+	int retval = jtag_vpi_send_cmd(&cmd);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return jtag_vpi_flush();
 }
 
 static int jtag_vpi_quit(void)
@@ -601,6 +754,11 @@ static int jtag_vpi_quit(void)
 		log_socket_error("jtag_vpi");
 	}
 	free(server_address);
+	free(vpi_queue);
+	vpi_queue = NULL;
+	free(pending_scans);
+	pending_scans = NULL;
+	pending_scans_size = 0;
 	return ERROR_OK;
 }
 
@@ -642,6 +800,15 @@ COMMAND_HANDLER(jtag_vpi_stop_sim_on_exit_handler)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(jtag_vpi_pipeline_handler)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], pipeline);
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_vpi_command_handlers[] = {
 	{
 		.name = "jtag_vpi_set_port",
@@ -665,6 +832,14 @@ static const struct command_registration jtag_vpi_command_handlers[] = {
 			"before OpenOCD exits (default: off)",
 		.usage = "<on|off>",
 	},
+	{
+		.name = "jtag_vpi_pipeline",
+		.handler = &jtag_vpi_pipeline_handler,
+		.mode = COMMAND_CONFIG,
+		.help = "Configure if the commands of a JTAG queue are sent "
+			"without waiting for each scan response (default: on)",
+		.usage = "<on|off>",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
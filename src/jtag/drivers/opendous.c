@@ -698,7 +698,7 @@ int opendous_tap_execute(void)
 			}
 
 			if (pending_scan_result->buffer != NULL)
-				free(pending_scan_result->buffer);
+				jtag_free_buffer(pending_scan_result->buffer);
 		}
 
 		opendous_tap_init();
@@ -23,6 +23,7 @@
 #ifndef _WIN32
 #include <sys/un.h>
 #include <netdb.h>
+#include <netinet/tcp.h>
 #endif
 #include <jtag/interface.h>
 #include "bitbang.h"
@@ -30,12 +31,34 @@
 /* arbitrary limit on host name length: */
 #define REMOTE_BITBANG_HOST_MAX 255
 
+/* socket buffers large enough to hold several pipelined scans */
+#define REMOTE_BITBANG_SOCKET_BUF	(256 * 1024)
+#define REMOTE_BITBANG_FILE_BUF		(64 * 1024)
+/* wait for the TDO data before the server may block sending it to us */
+#define REMOTE_BITBANG_MAX_PENDING_TDO	(64 * 1024)
+/* time to wait for the answer to the version request */
+#define REMOTE_BITBANG_VERSION_TIMEOUT_MS	1000
+
 static char *remote_bitbang_host;
 static char *remote_bitbang_port;
 
 static FILE *remote_bitbang_file;
 static int remote_bitbang_fd;
 
+/* use the batched scan protocol extension, if the server supports it */
+static bool remote_bitbang_use_batch;
+
+/* TDO data of the scans sent, not yet read back */
+struct remote_bitbang_pending_tdo {
+	uint8_t *buffer;
+	unsigned num_bytes;
+};
+
+static struct remote_bitbang_pending_tdo *remote_bitbang_pending;
+static unsigned remote_bitbang_pending_count;
+static unsigned remote_bitbang_pending_size;
+static unsigned remote_bitbang_pending_bytes;
+
 /* Circular buffer. When start == end, the buffer is empty. */
 static char remote_bitbang_buf[64];
 static unsigned remote_bitbang_start;
@@ -116,6 +139,10 @@ static int remote_bitbang_quit(void)
 
 	free(remote_bitbang_host);
 	free(remote_bitbang_port);
+	free(remote_bitbang_pending);
+	remote_bitbang_pending = NULL;
+	remote_bitbang_pending_count = 0;
+	remote_bitbang_pending_size = 0;
 
 	LOG_INFO("remote_bitbang interface quit");
 	return ERROR_OK;
@@ -194,6 +221,93 @@ static int remote_bitbang_blink(int on)
 	return remote_bitbang_putc(c);
 }
 
+/* Blocking read of exactly len bytes */
+static int remote_bitbang_read_bytes(uint8_t *buf, size_t len)
+{
+	socket_block(remote_bitbang_fd);
+	while (len) {
+		ssize_t count = read(remote_bitbang_fd, buf, len);
+		if (count <= 0) {
+			LOG_ERROR("read: count=%d, error=%s", (int) count, strerror(errno));
+			return ERROR_FAIL;
+		}
+		buf += count;
+		len -= count;
+	}
+	return ERROR_OK;
+}
+
+static int remote_bitbang_flush(void)
+{
+	if (EOF == fflush(remote_bitbang_file)) {
+		LOG_ERROR("fflush: %s", strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	for (unsigned i = 0; i < remote_bitbang_pending_count; i++) {
+		if (remote_bitbang_read_bytes(remote_bitbang_pending[i].buffer,
+					remote_bitbang_pending[i].num_bytes) != ERROR_OK) {
+			remote_bitbang_pending_count = 0;
+			remote_bitbang_pending_bytes = 0;
+			return ERROR_FAIL;
+		}
+	}
+
+	remote_bitbang_pending_count = 0;
+	remote_bitbang_pending_bytes = 0;
+	return ERROR_OK;
+}
+
+/*
+ * Batched scan: 'S', the number of bits as 32 bit little endian, a flags
+ * byte (bit 0 set if the TDO data is wanted), then the TMS and TDI bit
+ * vectors, LSB first. If requested the server answers with the TDO bit
+ * vector in the same format.
+ */
+static int remote_bitbang_scan(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		unsigned bits)
+{
+	unsigned num_bytes = DIV_ROUND_UP(bits, 8);
+	uint8_t header[6];
+
+	header[0] = 'S';
+	h_u32_to_le(&header[1], bits);
+	header[5] = tdo ? 1 : 0;
+
+	if (fwrite(header, 1, sizeof(header), remote_bitbang_file) != sizeof(header) ||
+			fwrite(tms, 1, num_bytes, remote_bitbang_file) != num_bytes ||
+			fwrite(tdi, 1, num_bytes, remote_bitbang_file) != num_bytes) {
+		LOG_ERROR("remote_bitbang_scan: %s", strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	if (!tdo)
+		return ERROR_OK;
+
+	if (remote_bitbang_pending_count == remote_bitbang_pending_size) {
+		unsigned new_size = remote_bitbang_pending_size ? 2 * remote_bitbang_pending_size : 64;
+		struct remote_bitbang_pending_tdo *new_pending = realloc(remote_bitbang_pending,
+				new_size * sizeof(*remote_bitbang_pending));
+		if (!new_pending) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		remote_bitbang_pending = new_pending;
+		remote_bitbang_pending_size = new_size;
+	}
+
+	remote_bitbang_pending[remote_bitbang_pending_count].buffer = tdo;
+	remote_bitbang_pending[remote_bitbang_pending_count].num_bytes = num_bytes;
+	remote_bitbang_pending_count++;
+	remote_bitbang_pending_bytes += num_bytes;
+
+	/* don't let the server block on a full socket while we keep sending */
+	if (remote_bitbang_pending_bytes >= REMOTE_BITBANG_MAX_PENDING_TDO)
+		return remote_bitbang_flush();
+
+	return ERROR_OK;
+}
+
 static struct bitbang_interface remote_bitbang_bitbang = {
 	.buf_size = sizeof(remote_bitbang_buf) - 1,
 	.sample = &remote_bitbang_sample,
@@ -202,6 +316,52 @@ static struct bitbang_interface remote_bitbang_bitbang = {
 	.blink = &remote_bitbang_blink,
 };
 
+/*
+ * Ask the server for its protocol version: 'V' is answered with an ASCII
+ * digit. Servers not implementing the request don't answer at all.
+ */
+static int remote_bitbang_negotiate(void)
+{
+	struct timeval tv;
+	fd_set rfds;
+	char c;
+
+	if (remote_bitbang_putc('V') != ERROR_OK ||
+			EOF == fflush(remote_bitbang_file)) {
+		LOG_ERROR("remote_bitbang: failed to send version request");
+		return ERROR_FAIL;
+	}
+
+	FD_ZERO(&rfds);
+	FD_SET(remote_bitbang_fd, &rfds);
+	tv.tv_sec = REMOTE_BITBANG_VERSION_TIMEOUT_MS / 1000;
+	tv.tv_usec = (REMOTE_BITBANG_VERSION_TIMEOUT_MS % 1000) * 1000;
+	if (select(remote_bitbang_fd + 1, &rfds, NULL, NULL, &tv) <= 0 ||
+			remote_bitbang_read_bytes((uint8_t *)&c, 1) != ERROR_OK ||
+			c < '1' || c > '9') {
+		LOG_WARNING("remote_bitbang: server does not support batched scans");
+		return ERROR_OK;
+	}
+
+	LOG_INFO("remote_bitbang: using batched scans (protocol version %c)", c);
+	remote_bitbang_bitbang.scan = &remote_bitbang_scan;
+	remote_bitbang_bitbang.flush = &remote_bitbang_flush;
+	return ERROR_OK;
+}
+
+static void remote_bitbang_set_buffers(int fd, bool tcp)
+{
+	int buf_size = REMOTE_BITBANG_SOCKET_BUF;
+
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, (char *)&buf_size, sizeof(buf_size));
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (char *)&buf_size, sizeof(buf_size));
+
+	if (tcp) {
+		int flag = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *)&flag, sizeof(flag));
+	}
+}
+
 static int remote_bitbang_init_tcp(void)
 {
 	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
@@ -242,6 +402,7 @@ static int remote_bitbang_init_tcp(void)
 		return ERROR_FAIL;
 	}
 
+	remote_bitbang_set_buffers(fd, true);
 	return fd;
 }
 
@@ -269,6 +430,7 @@ static int remote_bitbang_init_unix(void)
 		return ERROR_FAIL;
 	}
 
+	remote_bitbang_set_buffers(fd, false);
 	return fd;
 }
 
@@ -278,6 +440,8 @@ static int remote_bitbang_init(void)
 
 	remote_bitbang_start = 0;
 	remote_bitbang_end = 0;
+	remote_bitbang_bitbang.scan = NULL;
+	remote_bitbang_bitbang.flush = NULL;
 
 	LOG_INFO("Initializing remote_bitbang driver");
 	if (remote_bitbang_port == NULL)
@@ -295,6 +459,14 @@ static int remote_bitbang_init(void)
 		return ERROR_FAIL;
 	}
 
+	/* send the requests in large chunks, flushed when the answers are needed */
+	setvbuf(remote_bitbang_file, NULL, _IOFBF, REMOTE_BITBANG_FILE_BUF);
+
+	if (remote_bitbang_use_batch && remote_bitbang_negotiate() != ERROR_OK) {
+		fclose(remote_bitbang_file);
+		return ERROR_FAIL;
+	}
+
 	LOG_INFO("remote_bitbang driver initialized");
 	return ERROR_OK;
 }
@@ -311,6 +483,15 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_port_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_batch_command)
+{
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], remote_bitbang_use_batch);
+		return ERROR_OK;
+	}
+	return ERROR_COMMAND_SYNTAX_ERROR;
+}
+
 COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_host_command)
 {
 	if (CMD_ARGC == 1) {
@@ -338,6 +519,14 @@ static const struct command_registration remote_bitbang_command_handlers[] = {
 			"  if port is 0 or unset, this is the name of the unix socket to use.",
 		.usage = "host_name",
 	},
+	{
+		.name = "remote_bitbang_batch",
+		.handler = remote_bitbang_handle_remote_bitbang_batch_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Negotiate with the remote jtag the use of batched scans.\n"
+			"  Servers not supporting it are driven bit by bit.",
+		.usage = "(on|off)",
+	},
 	COMMAND_REGISTRATION_DONE,
 };
 
@@ -3113,8 +3113,64 @@ static struct hl_interface_param_s stlink_dap_param;
 static DECLARE_BITMAP(opened_ap, DP_APSEL_MAX + 1);
 static int stlink_dap_error = ERROR_OK;
 
-static int stlink_dap_op_queue_dp_read(struct adiv5_dap *dap, unsigned reg,
-		uint32_t *data);
+/*
+ * DAP operations are not sent to the ST-Link as soon as they are queued.
+ * They are collected here and executed by stlink_dap_op_run(). While
+ * queueing, the CSW, TAR and DRW accesses to the MEM-AP 0 issued by
+ * mem_ap_read()/mem_ap_write() are collapsed in the native ST-Link memory
+ * read/write commands, which move up to a whole USB packet of data at
+ * once instead of one word per USB round trip.
+ */
+#define STLINK_DAP_QUEUE_SIZE	512
+#define STLINK_DAP_WBUF_SIZE	(4 * STLINK_DATA_SIZE)
+
+enum stlink_dap_cmd {
+	STLINK_DAP_DP_READ,
+	STLINK_DAP_DP_WRITE,
+	STLINK_DAP_AP_READ,
+	STLINK_DAP_AP_WRITE,
+	STLINK_DAP_MEM_READ,
+	STLINK_DAP_MEM_WRITE,
+};
+
+struct stlink_dap_queue_entry {
+	enum stlink_dap_cmd cmd;
+	/* STLINK_DEBUG_PORT_ACCESS or the AP number */
+	unsigned short port;
+	unsigned reg;
+	/* data to write, for register writes */
+	uint32_t data;
+	/* DRW-like destination of register and memory reads; memory reads
+	 * fill one word per transfer, the data in the proper byte lane */
+	uint32_t *dst;
+	/* memory transfers only */
+	uint32_t addr;
+	uint32_t size;
+	uint32_t len;
+	/* offset of the data in stlink_dap_wbuf, for memory writes */
+	size_t wbuf_offset;
+};
+
+static struct stlink_dap_queue_entry stlink_dap_queue[STLINK_DAP_QUEUE_SIZE];
+static unsigned int stlink_dap_queue_len;
+static uint8_t stlink_dap_wbuf[STLINK_DAP_WBUF_SIZE];
+static size_t stlink_dap_wbuf_len;
+
+/*
+ * Shadow of CSW and TAR of the MEM-AP 0, as written by the target code.
+ * A write to them is only forwarded to the ST-Link if the following access
+ * cannot be collapsed in a memory command (pending). The native memory
+ * commands program CSW and TAR on their own, so after them the values in
+ * the AP are restored before the next DRW or banked data access (stale).
+ */
+struct stlink_dap_shadow_reg {
+	uint32_t value;
+	bool valid;
+	bool pending;
+	bool stale;
+};
+
+static struct stlink_dap_shadow_reg stlink_dap_csw, stlink_dap_tar;
 
 /** */
 static int stlink_dap_record_error(int error)
@@ -3132,6 +3188,305 @@ static int stlink_dap_get_and_clear_error(void)
 	return retval;
 }
 
+/** */
+static void stlink_dap_invalidate_shadow(void)
+{
+	memset(&stlink_dap_csw, 0, sizeof(stlink_dap_csw));
+	memset(&stlink_dap_tar, 0, sizeof(stlink_dap_tar));
+}
+
+/** */
+static int stlink_dap_dp_read(unsigned reg, uint32_t *data)
+{
+	uint32_t dummy;
+	int retval;
+
+	data = data ? : &dummy;
+	if (stlink_dap_handle->version.flags & STLINK_F_QUIRK_JTAG_DP_READ
+		&& stlink_dap_handle->transport == HL_TRANSPORT_JTAG) {
+		/* Quirk required in JTAG. Read RDBUFF to get the data */
+		retval = stlink_read_dap_register(stlink_dap_handle,
+					STLINK_DEBUG_PORT_ACCESS, reg, &dummy);
+		if (retval == ERROR_OK)
+			retval = stlink_read_dap_register(stlink_dap_handle,
+						STLINK_DEBUG_PORT_ACCESS, DP_RDBUFF, data);
+	} else {
+		retval = stlink_read_dap_register(stlink_dap_handle,
+					STLINK_DEBUG_PORT_ACCESS, reg, data);
+	}
+
+	return retval;
+}
+
+/** */
+static int stlink_dap_dp_write(unsigned reg, uint32_t data)
+{
+	/* ST-Link does not like that we set CORUNDETECT */
+	if (reg == DP_CTRL_STAT)
+		data &= ~CORUNDETECT;
+
+	return stlink_write_dap_register(stlink_dap_handle,
+				STLINK_DEBUG_PORT_ACCESS, reg, data);
+}
+
+/** */
+static int stlink_dap_mem_read(struct stlink_dap_queue_entry *q)
+{
+	uint8_t buffer[STLINK_DATA_SIZE];
+	int retries = 0;
+	int retval;
+
+	do {
+		if (q->size == 4)
+			retval = stlink_usb_read_mem32(stlink_dap_handle, q->addr, q->len, buffer);
+		else if (q->size == 2)
+			retval = stlink_usb_read_mem16(stlink_dap_handle, q->addr, q->len, buffer);
+		else
+			retval = stlink_usb_read_mem8(stlink_dap_handle, q->addr, q->len, buffer);
+		if (retval == ERROR_WAIT && retries < MAX_WAIT_RETRIES)
+			usleep((1 << retries++) * 1000);
+		else
+			break;
+	} while (true);
+
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* return the data as the DRW reads would have done, in the byte lane
+	 * selected by the address */
+	for (uint32_t i = 0; i < q->len; i += q->size) {
+		uint32_t addr = q->addr + i;
+		uint32_t *dst = q->dst + i / q->size;
+
+		if (q->size == 4)
+			*dst = le_to_h_u32(&buffer[i]);
+		else if (q->size == 2)
+			*dst = le_to_h_u16(&buffer[i]) << (8 * (addr & 2));
+		else
+			*dst = buffer[i] << (8 * (addr & 3));
+	}
+
+	return ERROR_OK;
+}
+
+/** */
+static int stlink_dap_mem_write(struct stlink_dap_queue_entry *q)
+{
+	const uint8_t *buffer = &stlink_dap_wbuf[q->wbuf_offset];
+	int retries = 0;
+	int retval;
+
+	do {
+		if (q->size == 4)
+			retval = stlink_usb_write_mem32(stlink_dap_handle, q->addr, q->len, buffer);
+		else if (q->size == 2)
+			retval = stlink_usb_write_mem16(stlink_dap_handle, q->addr, q->len, buffer);
+		else
+			retval = stlink_usb_write_mem8(stlink_dap_handle, q->addr, q->len, buffer);
+		if (retval == ERROR_WAIT && retries < MAX_WAIT_RETRIES)
+			usleep((1 << retries++) * 1000);
+		else
+			break;
+	} while (true);
+
+	return retval;
+}
+
+/** */
+static int stlink_dap_execute_entry(struct stlink_dap_queue_entry *q)
+{
+	uint32_t dummy;
+
+	switch (q->cmd) {
+	case STLINK_DAP_DP_READ:
+		return stlink_dap_dp_read(q->reg, q->dst);
+	case STLINK_DAP_DP_WRITE:
+		return stlink_dap_dp_write(q->reg, q->data);
+	case STLINK_DAP_AP_READ:
+		return stlink_read_dap_register(stlink_dap_handle, q->port, q->reg,
+				q->dst ? : &dummy);
+	case STLINK_DAP_AP_WRITE:
+		return stlink_write_dap_register(stlink_dap_handle, q->port, q->reg,
+				q->data);
+	case STLINK_DAP_MEM_READ:
+		return stlink_dap_mem_read(q);
+	case STLINK_DAP_MEM_WRITE:
+		return stlink_dap_mem_write(q);
+	}
+
+	return ERROR_FAIL;
+}
+
+/**
+ * Execute all the queued DAP operations, in order. Once an operation fails,
+ * the following ones are dropped and the error is recorded for the next
+ * stlink_dap_op_run().
+ */
+static void stlink_dap_run_queue(void)
+{
+	for (unsigned int i = 0; i < stlink_dap_queue_len; i++) {
+		if (stlink_dap_error != ERROR_OK)
+			break;
+		stlink_dap_record_error(stlink_dap_execute_entry(&stlink_dap_queue[i]));
+	}
+
+	/* the dropped operations may include CSW and TAR writes */
+	if (stlink_dap_error != ERROR_OK)
+		stlink_dap_invalidate_shadow();
+
+	stlink_dap_queue_len = 0;
+	stlink_dap_wbuf_len = 0;
+}
+
+/** */
+static struct stlink_dap_queue_entry *stlink_dap_queue_add(enum stlink_dap_cmd cmd,
+		unsigned short port, unsigned reg)
+{
+	if (stlink_dap_queue_len == STLINK_DAP_QUEUE_SIZE)
+		stlink_dap_run_queue();
+
+	struct stlink_dap_queue_entry *q = &stlink_dap_queue[stlink_dap_queue_len++];
+	q->cmd = cmd;
+	q->port = port;
+	q->reg = reg;
+	q->data = 0;
+	q->dst = NULL;
+	return q;
+}
+
+/** */
+static void stlink_dap_queue_shadow_write(struct stlink_dap_shadow_reg *shadow,
+		unsigned reg, bool force)
+{
+	if (!shadow->pending && !(force && shadow->stale && shadow->valid))
+		return;
+
+	struct stlink_dap_queue_entry *q = stlink_dap_queue_add(STLINK_DAP_AP_WRITE, 0, reg);
+	q->data = shadow->value;
+	shadow->pending = false;
+	shadow->stale = false;
+}
+
+/**
+ * Forward to the ST-Link the CSW and TAR values held back in the shadow.
+ * @param data_access true if the next access depends on the values (DRW or
+ * banked data), so they have to be rewritten after a memory command too.
+ */
+static void stlink_dap_flush_shadow(bool data_access)
+{
+	stlink_dap_queue_shadow_write(&stlink_dap_csw, MEM_AP_REG_CSW, data_access);
+	stlink_dap_queue_shadow_write(&stlink_dap_tar, MEM_AP_REG_TAR, data_access);
+}
+
+/**
+ * Check if a DRW access on the MEM-AP 0 can be executed by the ST-Link
+ * native memory commands. Only single auto-increment transfers of the
+ * access sizes supported by the firmware are candidates.
+ * @return the transfer size in bytes, or zero if not possible.
+ */
+static uint32_t stlink_dap_mem_size(void)
+{
+	if (!stlink_dap_csw.valid || !stlink_dap_tar.valid)
+		return 0;
+
+	if ((stlink_dap_csw.value & CSW_ADDRINC_MASK) != CSW_ADDRINC_SINGLE)
+		return 0;
+
+	uint32_t size;
+	switch (stlink_dap_csw.value & CSW_SIZE_MASK) {
+	case CSW_32BIT:
+		size = 4;
+		break;
+	case CSW_16BIT:
+		if (!(stlink_dap_handle->version.flags & STLINK_F_HAS_MEM_16BIT))
+			return 0;
+		size = 2;
+		break;
+	case CSW_8BIT:
+		size = 1;
+		break;
+	default:
+		return 0;
+	}
+
+	if (stlink_dap_tar.value & (size - 1))
+		return 0;
+
+	return size;
+}
+
+/** */
+static uint32_t stlink_dap_mem_max_len(uint32_t addr, uint32_t size)
+{
+	if (size == 1)
+		return stlink_usb_block(stlink_dap_handle);
+
+	return stlink_max_block_size(stlink_dap_handle->max_mem_packet, addr);
+}
+
+/**
+ * Queue a DRW access on the MEM-AP 0 as part of a native memory command,
+ * extending the previous one if the access is contiguous.
+ * @return true if queued, false if the access has to go as register access.
+ */
+static bool stlink_dap_queue_mem(enum stlink_dap_cmd cmd, uint32_t *dst, uint32_t data)
+{
+	uint32_t size = stlink_dap_mem_size();
+	if (!size)
+		return false;
+
+	uint32_t addr = stlink_dap_tar.value;
+
+	if (cmd == STLINK_DAP_MEM_WRITE && stlink_dap_wbuf_len + size > STLINK_DAP_WBUF_SIZE)
+		stlink_dap_run_queue();
+
+	struct stlink_dap_queue_entry *q = NULL;
+	if (stlink_dap_queue_len) {
+		q = &stlink_dap_queue[stlink_dap_queue_len - 1];
+		if (q->cmd != cmd || q->size != size || q->addr + q->len != addr
+				|| q->len + size > stlink_dap_mem_max_len(q->addr, size)
+				|| (cmd == STLINK_DAP_MEM_READ && q->dst + q->len / size != dst)
+				|| (cmd == STLINK_DAP_MEM_WRITE && q->wbuf_offset + q->len != stlink_dap_wbuf_len))
+			q = NULL;
+	}
+
+	if (!q) {
+		q = stlink_dap_queue_add(cmd, 0, MEM_AP_REG_DRW);
+		q->addr = addr;
+		q->size = size;
+		q->len = 0;
+		q->dst = dst;
+		q->wbuf_offset = stlink_dap_wbuf_len;
+	}
+
+	if (cmd == STLINK_DAP_MEM_WRITE) {
+		uint8_t *p = &stlink_dap_wbuf[stlink_dap_wbuf_len];
+		if (size == 4)
+			h_u32_to_le(p, data);
+		else if (size == 2)
+			h_u16_to_le(p, data >> (8 * (addr & 2)));
+		else
+			*p = data >> (8 * (addr & 3));
+		stlink_dap_wbuf_len += size;
+	}
+	q->len += size;
+
+	/* the memory command leaves CSW and TAR as it likes */
+	stlink_dap_csw.pending = false;
+	stlink_dap_csw.stale = true;
+	stlink_dap_tar.pending = false;
+	stlink_dap_tar.stale = true;
+	stlink_dap_tar.value += size;
+
+	return true;
+}
+
+/** */
+static bool stlink_dap_is_data_reg(unsigned reg)
+{
+	return reg == MEM_AP_REG_DRW || (reg >= MEM_AP_REG_BD0 && reg <= MEM_AP_REG_BD3);
+}
+
 /** */
 static int stlink_dap_open_ap(unsigned short apsel)
 {
@@ -3233,6 +3588,7 @@ static int stlink_dap_op_connect(struct adiv5_dap *dap)
 
 	dap->do_reconnect = false;
 	dap_invalidate_cache(dap);
+	stlink_dap_invalidate_shadow();
 
 	retval = dap_dp_init(dap);
 	if (retval != ERROR_OK) {
@@ -3277,7 +3633,6 @@ static int stlink_dap_op_send_sequence(struct adiv5_dap *dap, enum swd_special_s
 static int stlink_dap_op_queue_dp_read(struct adiv5_dap *dap, unsigned reg,
 		uint32_t *data)
 {
-	uint32_t dummy;
 	int retval;
 
 	if (!(stlink_dap_handle->version.flags & STLINK_F_HAS_DPBANKSEL))
@@ -3290,21 +3645,10 @@ static int stlink_dap_op_queue_dp_read(struct adiv5_dap *dap, unsigned reg,
 	if (retval != ERROR_OK)
 		return retval;
 
-	data = data ? : &dummy;
-	if (stlink_dap_handle->version.flags & STLINK_F_QUIRK_JTAG_DP_READ
-		&& stlink_dap_handle->transport == HL_TRANSPORT_JTAG) {
-		/* Quirk required in JTAG. Read RDBUFF to get the data */
-		retval = stlink_read_dap_register(stlink_dap_handle,
-					STLINK_DEBUG_PORT_ACCESS, reg, &dummy);
-		if (retval == ERROR_OK)
-			retval = stlink_read_dap_register(stlink_dap_handle,
-						STLINK_DEBUG_PORT_ACCESS, DP_RDBUFF, data);
-	} else {
-		retval = stlink_read_dap_register(stlink_dap_handle,
-					STLINK_DEBUG_PORT_ACCESS, reg, data);
-	}
-
-	return stlink_dap_record_error(retval);
+	struct stlink_dap_queue_entry *q = stlink_dap_queue_add(STLINK_DAP_DP_READ,
+			STLINK_DEBUG_PORT_ACCESS, reg);
+	q->dst = data;
+	return ERROR_OK;
 }
 
 /** */
@@ -3329,13 +3673,10 @@ static int stlink_dap_op_queue_dp_write(struct adiv5_dap *dap, unsigned reg,
 	if (retval != ERROR_OK)
 		return retval;
 
-	/* ST-Link does not like that we set CORUNDETECT */
-	if (reg == DP_CTRL_STAT)
-		data &= ~CORUNDETECT;
-
-	retval = stlink_write_dap_register(stlink_dap_handle,
-				STLINK_DEBUG_PORT_ACCESS, reg, data);
-	return stlink_dap_record_error(retval);
+	struct stlink_dap_queue_entry *q = stlink_dap_queue_add(STLINK_DAP_DP_WRITE,
+			STLINK_DEBUG_PORT_ACCESS, reg);
+	q->data = data;
+	return ERROR_OK;
 }
 
 /** */
@@ -3343,7 +3684,6 @@ static int stlink_dap_op_queue_ap_read(struct adiv5_ap *ap, unsigned reg,
 		uint32_t *data)
 {
 	struct adiv5_dap *dap = ap->dap;
-	uint32_t dummy;
 	int retval;
 
 	retval = stlink_dap_check_reconnect(dap);
@@ -3355,11 +3695,22 @@ static int stlink_dap_op_queue_ap_read(struct adiv5_ap *ap, unsigned reg,
 		if (retval != ERROR_OK)
 			return retval;
 	}
-	data = data ? : &dummy;
-	retval = stlink_read_dap_register(stlink_dap_handle, ap->ap_num, reg,
-				 data);
+
 	dap->stlink_flush_ap_write = false;
-	return stlink_dap_record_error(retval);
+
+	if (ap->ap_num == 0) {
+		if (reg == MEM_AP_REG_DRW && data && stlink_dap_queue_mem(STLINK_DAP_MEM_READ, data, 0))
+			return ERROR_OK;
+		stlink_dap_flush_shadow(stlink_dap_is_data_reg(reg));
+		/* a DRW access that bypasses the shadow moves TAR */
+		if (reg == MEM_AP_REG_DRW)
+			stlink_dap_tar.valid = false;
+	}
+
+	struct stlink_dap_queue_entry *q = stlink_dap_queue_add(STLINK_DAP_AP_READ,
+			ap->ap_num, reg);
+	q->dst = data;
+	return ERROR_OK;
 }
 
 /** */
@@ -3377,10 +3728,31 @@ static int stlink_dap_op_queue_ap_write(struct adiv5_ap *ap, unsigned reg,
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = stlink_write_dap_register(stlink_dap_handle, ap->ap_num, reg,
-				data);
 	dap->stlink_flush_ap_write = true;
-	return stlink_dap_record_error(retval);
+
+	if (ap->ap_num == 0) {
+		/* hold back CSW and TAR, they could be absorbed by a memory command */
+		if (reg == MEM_AP_REG_CSW || reg == MEM_AP_REG_TAR) {
+			struct stlink_dap_shadow_reg *shadow =
+				(reg == MEM_AP_REG_CSW) ? &stlink_dap_csw : &stlink_dap_tar;
+			shadow->value = data;
+			shadow->valid = true;
+			shadow->pending = true;
+			shadow->stale = false;
+			return ERROR_OK;
+		}
+		if (reg == MEM_AP_REG_DRW && stlink_dap_queue_mem(STLINK_DAP_MEM_WRITE, NULL, data))
+			return ERROR_OK;
+		stlink_dap_flush_shadow(stlink_dap_is_data_reg(reg));
+		/* a DRW access that bypasses the shadow moves TAR */
+		if (reg == MEM_AP_REG_DRW)
+			stlink_dap_tar.valid = false;
+	}
+
+	struct stlink_dap_queue_entry *q = stlink_dap_queue_add(STLINK_DAP_AP_WRITE,
+			ap->ap_num, reg);
+	q->data = data;
+	return ERROR_OK;
 }
 
 /** */
@@ -3398,6 +3770,15 @@ static int stlink_dap_op_run(struct adiv5_dap *dap)
 
 	/* Here no LOG_DEBUG. This is called continuously! */
 
+	retval = stlink_dap_check_reconnect(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* CSW and TAR writes not followed by any access still have to reach the AP */
+	stlink_dap_flush_shadow(false);
+
+	stlink_dap_run_queue();
+
 	/*
 	 * ST-Link returns immediately after a DAP write, without waiting for it
 	 * to complete.
@@ -3406,21 +3787,12 @@ static int stlink_dap_op_run(struct adiv5_dap *dap)
 	 */
 	if (dap->stlink_flush_ap_write) {
 		dap->stlink_flush_ap_write = false;
-		retval = stlink_dap_op_queue_dp_read(dap, DP_RDBUFF, NULL);
-		if (retval != ERROR_OK) {
-			dap->do_reconnect = true;
-			return retval;
-		}
+		stlink_dap_record_error(stlink_dap_dp_read(DP_RDBUFF, NULL));
 	}
 
 	saved_retval = stlink_dap_get_and_clear_error();
 
-	retval = stlink_dap_op_queue_dp_read(dap, DP_CTRL_STAT, &ctrlstat);
-	if (retval != ERROR_OK) {
-		dap->do_reconnect = true;
-		return retval;
-	}
-	retval = stlink_dap_get_and_clear_error();
+	retval = stlink_dap_dp_read(DP_CTRL_STAT, &ctrlstat);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Fail reading CTRL/STAT register. Force reconnect");
 		dap->do_reconnect = true;
@@ -3429,15 +3801,10 @@ static int stlink_dap_op_run(struct adiv5_dap *dap)
 
 	if (ctrlstat & SSTICKYERR) {
 		if (stlink_dap_param.transport == HL_TRANSPORT_JTAG)
-			retval = stlink_dap_op_queue_dp_write(dap, DP_CTRL_STAT,
+			retval = stlink_dap_dp_write(DP_CTRL_STAT,
 					ctrlstat & (dap->dp_ctrl_stat | SSTICKYERR));
 		else
-			retval = stlink_dap_op_queue_dp_write(dap, DP_ABORT, STKERRCLR);
-		if (retval != ERROR_OK) {
-			dap->do_reconnect = true;
-			return retval;
-		}
-		retval = stlink_dap_get_and_clear_error();
+			retval = stlink_dap_dp_write(DP_ABORT, STKERRCLR);
 		if (retval != ERROR_OK) {
 			dap->do_reconnect = true;
 			return retval;
@@ -3460,6 +3827,8 @@ static void stlink_dap_op_quit(struct adiv5_dap *dap)
 	retval = stlink_dap_closeall_ap();
 	if (retval != ERROR_OK)
 		LOG_ERROR("Error closing APs");
+
+	stlink_dap_invalidate_shadow();
 }
 
 static int stlink_dap_config_trace(bool enabled,
@@ -677,7 +677,7 @@ static int vsllink_jtag_execute(void)
 				}
 
 				if (pending_scan_result->buffer != NULL)
-					free(pending_scan_result->buffer);
+					jtag_free_buffer(pending_scan_result->buffer);
 			}
 		}
 	} else {
@@ -36,6 +36,7 @@
 #include "interface.h"
 #include "interfaces.h"
 #include "tcl.h"
+#include "commands.h"
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -854,6 +855,22 @@ COMMAND_HANDLER(handle_jtag_init_command)
 	return jtag_init(CMD_CTX);
 }
 
+COMMAND_HANDLER(handle_jtag_queue_stats_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct jtag_queue_stats stats;
+	jtag_command_queue_stats(&stats);
+
+	command_print(CMD, "queue pages: %lu allocated, %zu bytes retained, "
+			"%zu bytes high-water", stats.page_allocs, stats.page_bytes,
+			stats.high_water);
+	command_print(CMD, "scan buffers: %lu allocated (%lu oversize), %lu reused",
+			stats.buffer_allocs, stats.buffer_oversize, stats.buffer_reuses);
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_subcommand_handlers[] = {
 	{
 		.name = "init",
@@ -936,6 +953,13 @@ static const struct command_registration jtag_subcommand_handlers[] = {
 		.jim_handler = jim_jtag_names,
 		.help = "Returns list of all JTAG tap names.",
 	},
+	{
+		.name = "queue_stats",
+		.mode = COMMAND_ANY,
+		.handler = handle_jtag_queue_stats_command,
+		.help = "Report allocations done by the JTAG command queue.",
+		.usage = "",
+	},
 	{
 		.chain = jtag_command_handlers_to_move,
 	},
@@ -38,9 +38,12 @@
 #include <pld/pld.h>
 #include <target/arm_cti.h>
 #include <target/arm_adi_v5.h>
+#include <target/rtt.h>
+#include <rtos/rtos.h>
 
 #include <server/server.h>
 #include <server/gdb_server.h>
+#include <server/rtt_server.h>
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -255,6 +258,8 @@ struct command_context *setup_command_handler(Jim_Interp *interp)
 		&pld_register_commands,
 		&cti_register_commands,
 		&dap_register_commands,
+		&rtt_register_commands,
+		&rtt_server_register_commands,
 		NULL
 	};
 	for (unsigned i = 0; NULL != command_registrants[i]; i++) {
@@ -349,8 +354,11 @@ int openocd_main(int argc, char *argv[])
 	ret = openocd_thread(argc, argv, cmd_ctx);
 
 	flash_free_all_banks();
+	rtt_server_free();
+	rtt_exit();
 	gdb_service_free();
 	server_free();
+	rtos_elf_cache_free();
 
 	unregister_all_commands(cmd_ctx, NULL);
 
@@ -34,8 +34,16 @@
 
 #define LINUX_USER_KERNEL_BORDER 0xc0000000
 #include "linux_header.h"
-#define PHYS
 #define MAX_THREADS 200
+/*  the task_struct fields used here all lie below the end of comm, so a
+ *  task is fetched with a single read of this size */
+#define TASK_WINDOW_SIZE (COMM + 16)
+#define THREAD_HASH_SIZE 256
+#ifdef PID_CHECK
+#define THREAD_KEY(t) ((t)->pid)
+#else
+#define THREAD_KEY(t) ((t)->base_addr)
+#endif
 /*  specific task  */
 struct linux_os {
 	const char *name;
@@ -48,6 +56,11 @@ struct linux_os {
 	int threads_needs_update;
 	struct current_thread *current_threads;
 	struct threads *thread_list;
+	/*  thread_list entries by THREAD_KEY() */
+	struct threads *thread_hash[THREAD_HASH_SIZE];
+	/*  bumped whenever the target runs, cached thread contexts from an
+	 *  older generation are stale */
+	uint32_t generation;
 	/*  virt2phys parameter */
 	uint32_t phys_mask;
 	uint32_t phys_base;
@@ -74,9 +87,12 @@ struct threads {
 	int status;		/* dead = 1 alive = 2 current = 3 alive and current */
 	/*  value that should not change during the live of a thread ? */
 	uint32_t thread_info_addr;	/*  contain latest thread_info_addr computed */
-	/*  retrieve from thread_info */
+	uint32_t next_addr;	/*  next task, as of the last full read */
+	/*  retrieve from thread_info, read when gdb asks for the registers */
 	struct cpu_context *context;
+	uint32_t context_generation;
 	struct threads *next;
+	struct threads *hash_next;
 };
 
 struct cpu_context {
@@ -128,22 +144,46 @@ static int linux_read_memory(struct target *target,
 	uint32_t address, uint32_t size, uint32_t count,
 	uint8_t *buffer)
 {
-#ifdef PHYS
-	struct linux_os *linux_os = (struct linux_os *)
-		target->rtos->rtos_specific_params;
-	uint32_t pa = (address & linux_os->phys_mask) + linux_os->phys_base;
-#endif
 	if (address < 0xc000000) {
 		LOG_ERROR("linux awareness : address in user space");
 		return ERROR_FAIL;
 	}
-#ifdef PHYS
-	target_read_phys_memory(target, pa, size, count, buffer);
-#endif
 	target_read_memory(target, address, size, count, buffer);
 	return ERROR_OK;
 }
 
+static unsigned int thread_hash(uint32_t key)
+{
+	/*  task_structs are at least cache line aligned */
+	return ((key >> 6) ^ (key >> 14)) & (THREAD_HASH_SIZE - 1);
+}
+
+static void thread_hash_add(struct linux_os *linux_os, struct threads *t)
+{
+	unsigned int h = thread_hash(THREAD_KEY(t));
+	t->hash_next = linux_os->thread_hash[h];
+	linux_os->thread_hash[h] = t;
+}
+
+static void thread_hash_del(struct linux_os *linux_os, struct threads *t)
+{
+	struct threads **p = &linux_os->thread_hash[thread_hash(THREAD_KEY(t))];
+
+	while (*p && *p != t)
+		p = &(*p)->hash_next;
+	if (*p)
+		*p = t->hash_next;
+}
+
+static struct threads *thread_lookup(struct linux_os *linux_os, uint32_t key)
+{
+	struct threads *t = linux_os->thread_hash[thread_hash(key)];
+
+	while (t && THREAD_KEY(t) != key)
+		t = t->hash_next;
+	return t;
+}
+
 int fill_buffer(struct target *target, uint32_t addr, uint8_t *buffer)
 {
 
@@ -163,6 +203,49 @@ uint32_t get_buffer(struct target *target, const uint8_t *buffer)
 	return value;
 }
 
+/*  registers of a thread that is not running, from the cpu_context saved
+ *  at its last switch; the context is only read when gdb asks for it and is
+ *  kept until the target runs again */
+static int linux_thread_context_reg_list(struct target *target,
+	struct threads *t, struct rtos_reg **reg_list, int *num_regs)
+{
+	struct linux_os *linux_os = (struct linux_os *)
+		target->rtos->rtos_specific_params;
+
+	if (!t->context || t->context_generation != linux_os->generation) {
+		free(t->context);
+		t->context = cpu_context_read(target, t->base_addr,
+				&t->thread_info_addr);
+		t->context_generation = linux_os->generation;
+	}
+
+	/*  r0-r3, r12 and lr are not saved by __switch_to */
+	uint32_t values[16] = { 0 };
+	values[4] = t->context->R4;
+	values[5] = t->context->R5;
+	values[6] = t->context->R6;
+	values[7] = t->context->R7;
+	values[8] = t->context->R8;
+	values[9] = t->context->R9;
+	values[10] = t->context->IP;
+	values[11] = t->context->FP;
+	values[13] = t->context->SP;
+	values[15] = t->context->PC;
+
+	*num_regs = ARRAY_SIZE(values);
+	*reg_list = calloc(*num_regs, sizeof(struct rtos_reg));
+	if (!*reg_list)
+		return ERROR_FAIL;
+
+	for (int i = 0; i < *num_regs; ++i) {
+		(*reg_list)[i].number = i;
+		(*reg_list)[i].size = 32;
+		buf_set_u32((*reg_list)[i].value, 0, 32, values[i]);
+	}
+
+	return ERROR_OK;
+}
+
 static int linux_os_thread_reg_list(struct rtos *rtos,
 	int64_t thread_id, struct rtos_reg **reg_list, int *num_regs)
 {
@@ -184,6 +267,15 @@ static int linux_os_thread_reg_list(struct rtos *rtos,
 	} while ((found == 0) && (next != tmp) && (next != NULL));
 
 	if (found == 0) {
+		struct threads *t = linux_os->thread_list;
+
+		while (t != NULL && t->threadid != thread_id)
+			t = t->next;
+
+		if (t != NULL)
+			return linux_thread_context_reg_list(target, t, reg_list,
+				num_regs);
+
 		LOG_ERROR("could not find thread: %" PRIx64, thread_id);
 		return ERROR_FAIL;
 	}
@@ -293,58 +385,49 @@ int fill_task_pid(struct target *target, struct threads *t)
 }
 #endif
 
+/*  comm is a byte array, copy it as is */
+static void task_name(struct threads *t, const uint8_t *comm)
+{
+	memcpy(t->name, comm, 16);
+	t->name[16] = 0;
+}
+
 int fill_task(struct target *target, struct threads *t)
 {
 	int retval;
-	uint32_t pid_addr = t->base_addr + PID;
-	uint32_t mem_addr = t->base_addr + MEM;
-	uint32_t on_cpu = t->base_addr + ONCPU;
-	uint8_t *buffer = calloc(1, 4);
-	retval = fill_buffer(target, t->base_addr, buffer);
-
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->state = val;
-	} else
-		LOG_ERROR("fill_task: unable to read memory");
-
-	retval = fill_buffer(target, pid_addr, buffer);
-
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->pid = val;
-	} else
-		LOG_ERROR("fill task: unable to read memory");
+	uint8_t *buffer = malloc(TASK_WINDOW_SIZE);
+	uint8_t asid[4];
 
-	retval = fill_buffer(target, on_cpu, buffer);
+	if (!buffer)
+		return ERROR_FAIL;
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->oncpu = val;
-	} else
-		LOG_ERROR("fill task: unable to read memory");
+	/*  state, pid, on_cpu, mm, the tasks list and comm in one go */
+	retval = linux_read_memory(target, t->base_addr, 4, TASK_WINDOW_SIZE / 4,
+			buffer);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("fill_task: unable to read memory");
+		free(buffer);
+		return retval;
+	}
 
-	retval = fill_buffer(target, mem_addr, buffer);
+	t->state = get_buffer(target, buffer);
+	t->pid = get_buffer(target, buffer + PID);
+	t->oncpu = get_buffer(target, buffer + ONCPU);
+	t->next_addr = get_buffer(target, buffer + NEXT) - NEXT;
+	task_name(t, buffer + COMM);
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
+	uint32_t mm = get_buffer(target, buffer + MEM);
+	free(buffer);
 
-		if (val != 0) {
-			uint32_t asid_addr = val + MM_CTX;
-			retval = fill_buffer(target, asid_addr, buffer);
+	if (mm != 0) {
+		retval = fill_buffer(target, mm + MM_CTX, asid);
 
-			if (retval == ERROR_OK) {
-				val = get_buffer(target, buffer);
-				t->asid = val;
-			} else
-				LOG_ERROR
-					("fill task: unable to read memory -- ASID");
-		} else
-			t->asid = 0;
+		if (retval == ERROR_OK)
+			t->asid = get_buffer(target, asid);
+		else
+			LOG_ERROR("fill task: unable to read memory -- ASID");
 	} else
-		LOG_ERROR("fill task: unable to read memory");
-
-	free(buffer);
+		t->asid = 0;
 
 	return retval;
 }
@@ -352,47 +435,17 @@ int fill_task(struct target *target, struct threads *t)
 int get_name(struct target *target, struct threads *t)
 {
 	int retval;
-	uint32_t full_name[4];
-	uint32_t comm = t->base_addr + COMM;
-	int i;
-
-	for (i = 0; i < 17; i++)
-		t->name[i] = 0;
+	uint8_t comm[16];
 
-	retval = linux_read_memory(target, comm, 4, 4, (uint8_t *) full_name);
+	retval = linux_read_memory(target, t->base_addr + COMM, 4, 4, comm);
 
 	if (retval != ERROR_OK) {
 		LOG_ERROR("get_name: unable to read memory\n");
 		return ERROR_FAIL;
 	}
 
-	uint32_t raw_name = target_buffer_get_u32(target,
-			(const uint8_t *)
-			&full_name[0]);
-	t->name[3] = raw_name >> 24;
-	t->name[2] = raw_name >> 16;
-	t->name[1] = raw_name >> 8;
-	t->name[0] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[1]);
-	t->name[7] = raw_name >> 24;
-	t->name[6] = raw_name >> 16;
-	t->name[5] = raw_name >> 8;
-	t->name[4] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[2]);
-	t->name[11] = raw_name >> 24;
-	t->name[10] = raw_name >> 16;
-	t->name[9] = raw_name >> 8;
-	t->name[8] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[3]);
-	t->name[15] = raw_name >> 24;
-	t->name[14] = raw_name >> 16;
-	t->name[13] = raw_name >> 8;
-	t->name[12] = raw_name;
+	task_name(t, comm);
 	return ERROR_OK;
-
 }
 
 int get_current(struct target *target, int create)
@@ -459,7 +512,6 @@ int get_current(struct target *target, int create)
 					t = calloc(1, sizeof(struct threads));
 					t->base_addr = ct->TS;
 					fill_task(target, t);
-					get_name(target, t);
 					t->oncpu = cpu;
 					insert_into_threadlist(target, t);
 					t->status = 3;
@@ -684,14 +736,18 @@ static int current_base_addr(struct linux_os *linux_os, uint32_t base_addr)
 	return 0;
 }
 
-int linux_get_tasks(struct target *target, int context)
+static int clean_threadlist(struct target *target);
+
+int linux_get_tasks(struct target *target)
 {
 	int loop = 0;
 	int retval = 0;
 	struct linux_os *linux_os = (struct linux_os *)
 		target->rtos->rtos_specific_params;
+	clean_threadlist(target);
 	linux_os->thread_list = NULL;
 	linux_os->thread_count = 0;
+	linux_os->generation++;
 
 	if (linux_os->init_task_addr == 0xdeadbeef) {
 		LOG_INFO("no init symbol\n");
@@ -709,8 +765,7 @@ int linux_get_tasks(struct target *target, int context)
 	while (((t->base_addr != linux_os->init_task_addr) &&
 		(t->base_addr != 0)) || (loop == 0)) {
 		loop++;
-		fill_task(target, t);
-		retval = get_name(target, t);
+		retval = fill_task(target, t);
 
 		if (loop > MAX_THREADS) {
 			free(t);
@@ -723,6 +778,8 @@ int linux_get_tasks(struct target *target, int context)
 			return ERROR_FAIL;
 		}
 
+		uint32_t base_addr = t->next_addr;
+
 		/*  check that this thread is not one the current threads already
 		 *  created */
 #ifdef PID_CHECK
@@ -737,20 +794,14 @@ int linux_get_tasks(struct target *target, int context)
 
 			linux_os->thread_list =
 				liste_add_task(linux_os->thread_list, t, &last);
-			/* no interest to fill the context if it is a current thread. */
+			thread_hash_add(linux_os, t);
 			linux_os->thread_count++;
 			t->thread_info_addr = 0xdeadbeef;
-
-			if (context)
-				t->context =
-					cpu_context_read(target, t->base_addr,
-						&t->thread_info_addr);
 		} else {
 			/*LOG_INFO("thread %s is a current thread already created",t->name); */
 			free(t);
 		}
 
-		uint32_t base_addr = next_task(target, t);
 		t = calloc(1, sizeof(struct threads));
 		t->base_addr = base_addr;
 	}
@@ -786,6 +837,7 @@ static int clean_threadlist(struct target *target)
 		free(old);
 	}
 
+	memset(linux_os->thread_hash, 0, sizeof(linux_os->thread_hash));
 	return ERROR_OK;
 }
 
@@ -814,6 +866,7 @@ static int insert_into_threadlist(struct target *target, struct threads *t)
 	linux_os->threadid_count++;
 	t->status = 1;
 	t->next = NULL;
+	thread_hash_add(linux_os, t);
 
 	if (temp == NULL)
 		linux_os->thread_list = t;
@@ -832,7 +885,7 @@ static void linux_identify_current_threads(struct target *target)
 {
 	struct linux_os *linux_os = (struct linux_os *)
 		target->rtos->rtos_specific_params;
-	struct threads *thread_list = linux_os->thread_list;
+	struct threads *thread_list;
 	struct current_thread *ct = linux_os->current_threads;
 	struct threads *t = NULL;
 
@@ -856,17 +909,11 @@ error_handling:
 
 			/* search in the list of threads if pid
 			   already present */
-			while ((thread_list != NULL) && (found == 0)) {
-#ifdef PID_CHECK
-				if (thread_list->pid == t->pid) {
-#else
-				if (thread_list->base_addr == t->base_addr) {
-#endif
-					free(t);
-					t = thread_list;
-					found = 1;
-				}
-				thread_list = thread_list->next;
+			thread_list = thread_lookup(linux_os, THREAD_KEY(t));
+			if (thread_list) {
+				free(t);
+				t = thread_list;
+				found = 1;
 			}
 
 			if (!found) {
@@ -874,7 +921,6 @@ error_handling:
 				if (fill_task(target, t) != ERROR_OK)
 					goto error_handling;
 
-				get_name(target, t);
 				insert_into_threadlist(target, t);
 				t->thread_info_addr = 0xdeadbeef;
 			}
@@ -916,7 +962,7 @@ error_handling:
 #endif
 }
 
-static int linux_task_update(struct target *target, int context)
+static int linux_task_update(struct target *target)
 {
 	struct linux_os *linux_os = (struct linux_os *)
 		target->rtos->rtos_specific_params;
@@ -925,20 +971,13 @@ static int linux_task_update(struct target *target, int context)
 	int loop = 0;
 	linux_os->thread_count = 0;
 
-	/*thread_list = thread_list->next; skip init_task*/
+	/*  the contexts are dropped by the generation change, they are read
+	 *  again when gdb asks for them */
 	while (thread_list != NULL) {
 		thread_list->status = 0;	/*setting all tasks to dead state*/
-
-		if (thread_list->context) {
-			free(thread_list->context);
-			thread_list->context = NULL;
-		}
-
 		thread_list = thread_list->next;
 	}
 
-	int found = 0;
-
 	if (linux_os->init_task_addr == 0xdeadbeef) {
 		LOG_INFO("no init symbol\n");
 		return ERROR_FAIL;
@@ -967,67 +1006,41 @@ static int linux_task_update(struct target *target, int context)
 			return ERROR_FAIL;
 		}
 
-		thread_list = linux_os->thread_list;
+		thread_list = thread_lookup(linux_os, THREAD_KEY(t));
 
-		while (thread_list != NULL) {
-#ifdef PID_CHECK
-			if (t->pid == thread_list->pid) {
-#else
-			if (t->base_addr == thread_list->base_addr) {
-#endif
-				if (!thread_list->status) {
+		if (thread_list) {
+			if (!thread_list->status) {
 #ifdef PID_CHECK
-					if (t->base_addr != thread_list->base_addr)
-						LOG_INFO("thread base_addr has changed !!");
+				if (t->base_addr != thread_list->base_addr)
+					LOG_INFO("thread base_addr has changed !!");
 #endif
-					/*  this is not a current thread  */
-					thread_list->base_addr = t->base_addr;
-					thread_list->status = 1;
-
-					/*  we don 't update this field any more */
-
-					/*thread_list->state = t->state;
-					thread_list->oncpu = t->oncpu;
-					thread_list->asid = t->asid;
-					*/
-					if (context)
-						thread_list->context =
-							cpu_context_read(target,
-								thread_list->
-								base_addr,
-								&thread_list->
-								thread_info_addr);
-				} else {
-					/*  it is a current thread no need to read context */
-				}
+				/*  this is not a current thread  */
+				thread_list->base_addr = t->base_addr;
+				thread_list->status = 1;
 
-				linux_os->thread_count++;
-				found = 1;
-				break;
+				/*  we don 't update this field any more */
+
+				/*thread_list->state = t->state;
+				thread_list->oncpu = t->oncpu;
+				thread_list->asid = t->asid;
+				*/
 			} else {
-				found = 0;
-				thread_list = thread_list->next;
+				/*  it is a current thread no need to read context */
 			}
-		}
 
-		if (found == 0) {
+			linux_os->thread_count++;
+			t->base_addr = next_task(target, t);
+		} else {
 			uint32_t base_addr;
 			fill_task(target, t);
-			get_name(target, t);
 			retval = insert_into_threadlist(target, t);
 			t->thread_info_addr = 0xdeadbeef;
 
-			if (context)
-				t->context =
-					cpu_context_read(target, t->base_addr,
-						&t->thread_info_addr);
-
-			base_addr = next_task(target, t);
+			base_addr = t->next_addr;
 			t = calloc(1, sizeof(struct threads));
 			t->base_addr = base_addr;
 			linux_os->thread_count++;
-		} else
-			t->base_addr = next_task(target, t);
+		}
 	}
 
 	LOG_INFO("update thread done %" PRId64 ", mean%" PRId64 "\n",
@@ -1052,7 +1065,7 @@ int linux_gdb_thread_packet(struct target *target,
 		return ERROR_OK;
 	}
 
-	retval = linux_get_tasks(target, 1);
+	retval = linux_get_tasks(target);
 
 	if (retval != ERROR_OK)
 		return ERROR_TARGET_FAILURE;
@@ -1187,6 +1200,7 @@ int linux_gdb_T_packet(struct connection *connection,
 					return ERROR_OK;
 				} else {
 					/* delete item in the list   */
+					thread_hash_del(linux_os, temp);
 					linux_os->thread_list =
 						liste_del_task(linux_os->
 							thread_list, &temp,
@@ -1207,7 +1221,7 @@ int linux_gdb_T_packet(struct connection *connection,
 		return ERROR_OK;
 
 	} else {
-		retval = linux_task_update(target, 1);
+		retval = linux_task_update(target);
 		struct threads *temp = linux_os->thread_list;
 
 		while (temp != NULL) {
@@ -1384,6 +1398,7 @@ static int linux_thread_packet(struct connection *connection, char const *packet
 
 				LOG_INFO("threads_needs_update = 1");
 				linux_os->threads_needs_update = 1;
+				linux_os->generation++;
 			}
 		}
 
@@ -1467,10 +1482,10 @@ static char *linux_ps_command(struct target *target)
 	char *display;
 
 	if (linux_os->threads_lookup == 0)
-		retval = linux_get_tasks(target, 1);
+		retval = linux_get_tasks(target);
 	else {
 		if (linux_os->threads_needs_update != 0)
-			retval = linux_task_update(target, 0);
+			retval = linux_task_update(target);
 	}
 
 	if (retval == ERROR_OK) {
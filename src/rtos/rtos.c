@@ -25,6 +25,7 @@
 #include "helper/log.h"
 #include "helper/binarybuffer.h"
 #include "server/gdb_server.h"
+#include "target/image.h"
 
 /* RTOSs */
 extern struct rtos_type FreeRTOS_rtos;
@@ -92,6 +93,8 @@ static int os_alloc(struct target *target, struct rtos_type *ostype)
 	return JIM_OK;
 }
 
+static void rtos_free_stack_frames(struct rtos *rtos);
+
 static void os_free(struct target *target)
 {
 	if (!target->rtos)
@@ -100,6 +103,9 @@ static void os_free(struct target *target)
 	if (target->rtos->symbols)
 		free(target->rtos->symbols);
 
+	rtos_free_stack_frames(target->rtos);
+	free(target->rtos->stack_frames);
+
 	free(target->rtos);
 	target->rtos = NULL;
 }
@@ -168,6 +174,8 @@ int gdb_thread_packet(struct connection *connection, char const *packet, int pac
 	return target->rtos->gdb_thread_packet(connection, packet, packet_size);
 }
 
+static void rtos_prefetch_stack_frames(struct rtos *rtos);
+
 static symbol_table_elem_t *next_symbol(struct rtos *os, char *cur_symbol, uint64_t cur_addr)
 {
 	symbol_table_elem_t *s;
@@ -188,6 +196,251 @@ static symbol_table_elem_t *next_symbol(struct rtos *os, char *cur_symbol, uint6
 	return NULL;
 }
 
+#define RTOS_TYPE_COUNT (ARRAY_SIZE(rtos_types) - 1)
+
+/* The symbols of every RTOS type, as found in one ELF file. Kept by
+ * build-id, so reconnecting GDB to the same firmware only costs reading
+ * the ELF headers. */
+struct rtos_elf_symbols {
+	uint8_t build_id[IMAGE_BUILD_ID_MAX_SIZE];
+	size_t build_id_size;
+	symbol_table_elem_t *symbols[RTOS_TYPE_COUNT];
+	/* index of the auto-detected RTOS, -1 if none, -2 if not tried yet */
+	int detected;
+	struct rtos_elf_symbols *next;
+};
+
+static struct rtos_elf_symbols *rtos_elf_cache;
+
+struct rtos_elf_wanted {
+	const char *name;
+	symbol_address_t *address;
+};
+
+static int rtos_elf_wanted_compare(const void *a, const void *b)
+{
+	const struct rtos_elf_wanted *wa = a;
+	const struct rtos_elf_wanted *wb = b;
+
+	return strcmp(wa->name, wb->name);
+}
+
+struct rtos_elf_lookup {
+	struct rtos_elf_wanted *wanted;
+	size_t count;
+};
+
+static int rtos_elf_symbol_found(const char *name, uint32_t value, void *priv)
+{
+	struct rtos_elf_lookup *lookup = priv;
+	struct rtos_elf_wanted key = { .name = name };
+	struct rtos_elf_wanted *w = bsearch(&key, lookup->wanted, lookup->count,
+			sizeof(key), rtos_elf_wanted_compare);
+
+	if (!w)
+		return ERROR_OK;
+
+	/* several RTOS types may want the same symbol */
+	while (w > lookup->wanted && !strcmp(w[-1].name, name))
+		w--;
+	for (; w < lookup->wanted + lookup->count && !strcmp(w->name, name); w++)
+		*w->address = value;
+
+	return ERROR_OK;
+}
+
+static void rtos_elf_symbols_free(struct rtos_elf_symbols *elf_symbols)
+{
+	for (size_t t = 0; t < RTOS_TYPE_COUNT; t++)
+		free(elf_symbols->symbols[t]);
+	free(elf_symbols);
+}
+
+/* Release the symbols cached for the files given with -rtos-elf. */
+void rtos_elf_cache_free(void)
+{
+	while (rtos_elf_cache) {
+		struct rtos_elf_symbols *next = rtos_elf_cache->next;
+		rtos_elf_symbols_free(rtos_elf_cache);
+		rtos_elf_cache = next;
+	}
+}
+
+/* Resolve the symbols of all RTOS types in a single pass over the symbol
+ * table of the ELF file. */
+static struct rtos_elf_symbols *rtos_elf_read_symbols(struct image *image)
+{
+	struct rtos_elf_symbols *elf_symbols = calloc(1, sizeof(*elf_symbols));
+	struct rtos_elf_lookup lookup = { NULL, 0 };
+	size_t size = 0;
+
+	if (!elf_symbols)
+		goto error;
+	elf_symbols->detected = -2;
+
+	for (size_t t = 0; t < RTOS_TYPE_COUNT; t++) {
+		rtos_types[t]->get_symbol_list_to_lookup(&elf_symbols->symbols[t]);
+		if (!elf_symbols->symbols[t])
+			goto error;
+
+		for (symbol_table_elem_t *s = elf_symbols->symbols[t]; s->symbol_name; s++) {
+			if (lookup.count == size) {
+				size = size ? 2 * size : 64;
+				struct rtos_elf_wanted *wanted = realloc(lookup.wanted,
+						size * sizeof(*wanted));
+				if (!wanted)
+					goto error;
+				lookup.wanted = wanted;
+			}
+			lookup.wanted[lookup.count].name = s->symbol_name;
+			lookup.wanted[lookup.count].address = &s->address;
+			lookup.count++;
+		}
+	}
+
+	qsort(lookup.wanted, lookup.count, sizeof(*lookup.wanted),
+			rtos_elf_wanted_compare);
+
+	if (image_elf_for_each_symbol(image, rtos_elf_symbol_found, &lookup) != ERROR_OK)
+		goto error;
+
+	free(lookup.wanted);
+	return elf_symbols;
+
+error:
+	free(lookup.wanted);
+	if (elf_symbols)
+		rtos_elf_symbols_free(elf_symbols);
+	return NULL;
+}
+
+static symbol_table_elem_t *rtos_elf_copy_symbols(const symbol_table_elem_t *symbols)
+{
+	size_t count = 1;
+	for (const symbol_table_elem_t *s = symbols; s->symbol_name; s++)
+		count++;
+
+	symbol_table_elem_t *copy = malloc(count * sizeof(*copy));
+	if (copy)
+		memcpy(copy, symbols, count * sizeof(*copy));
+	return copy;
+}
+
+static const char *rtos_elf_missing_symbol(const symbol_table_elem_t *symbols)
+{
+	for (const symbol_table_elem_t *s = symbols; s->symbol_name; s++)
+		if (!s->optional && !s->address)
+			return s->symbol_name;
+	return NULL;
+}
+
+/* Hand the symbols of RTOS type 't' to the target's RTOS. */
+static int rtos_elf_use_symbols(struct rtos *os, struct rtos_elf_symbols *elf_symbols, size_t t)
+{
+	symbol_table_elem_t *symbols = rtos_elf_copy_symbols(elf_symbols->symbols[t]);
+	if (!symbols)
+		return ERROR_FAIL;
+
+	free(os->symbols);
+	os->type = rtos_types[t];
+	os->symbols = symbols;
+	return ERROR_OK;
+}
+
+/* Look up the RTOS symbols in the ELF file configured with -rtos-elf.
+ * Returns ERROR_OK if the file could be used, with 'detected' telling
+ * whether the RTOS was found; otherwise GDB has to be asked. */
+static int rtos_elf_lookup(struct target *target, int *detected)
+{
+	struct rtos *os = target->rtos;
+	struct rtos_elf_symbols *elf_symbols = NULL;
+	uint8_t build_id[IMAGE_BUILD_ID_MAX_SIZE];
+	size_t build_id_size = 0;
+	struct image image;
+
+	*detected = 0;
+
+	int retval = image_open(&image, target->rtos_elf, "elf");
+	if (retval != ERROR_OK) {
+		LOG_WARNING("RTOS: cannot open %s, asking GDB for the symbols", target->rtos_elf);
+		return retval;
+	}
+
+	if (image_elf_build_id(&image, build_id, &build_id_size) == ERROR_OK) {
+		for (elf_symbols = rtos_elf_cache; elf_symbols; elf_symbols = elf_symbols->next)
+			if (elf_symbols->build_id_size == build_id_size &&
+					!memcmp(elf_symbols->build_id, build_id, build_id_size))
+				break;
+	}
+
+	if (!elf_symbols) {
+		elf_symbols = rtos_elf_read_symbols(&image);
+		if (elf_symbols && build_id_size) {
+			memcpy(elf_symbols->build_id, build_id, build_id_size);
+			elf_symbols->build_id_size = build_id_size;
+			elf_symbols->next = rtos_elf_cache;
+			rtos_elf_cache = elf_symbols;
+		}
+	} else {
+		LOG_DEBUG("RTOS: using cached symbols of %s", target->rtos_elf);
+	}
+	image_close(&image);
+
+	if (!elf_symbols) {
+		LOG_WARNING("RTOS: no symbols in %s, asking GDB for them", target->rtos_elf);
+		return ERROR_FAIL;
+	}
+
+	if (!target->rtos_auto_detect) {
+		size_t t = 0;
+		while (t < RTOS_TYPE_COUNT && rtos_types[t] != os->type)
+			t++;
+
+		const char *missing = rtos_elf_missing_symbol(elf_symbols->symbols[t]);
+		if (missing)
+			LOG_WARNING("RTOS %s not detected. (symbol \'%s\' not found in %s)",
+					os->type->name, missing, target->rtos_elf);
+		else if (rtos_elf_use_symbols(os, elf_symbols, t) == ERROR_OK)
+			*detected = 1;
+		goto done;
+	}
+
+	if (elf_symbols->detected == -2) {
+		/* only cache a negative result once every type has been tried */
+		int found = -1;
+		size_t t;
+		for (t = 0; t < RTOS_TYPE_COUNT; t++) {
+			if (rtos_elf_missing_symbol(elf_symbols->symbols[t]))
+				continue;
+			if (rtos_elf_use_symbols(os, elf_symbols, t) != ERROR_OK)
+				break;
+			if (os->type->detect_rtos(target)) {
+				found = t;
+				break;
+			}
+		}
+		if (found >= 0 || t == RTOS_TYPE_COUNT)
+			elf_symbols->detected = found;
+	}
+
+	if (elf_symbols->detected >= 0 &&
+			rtos_elf_use_symbols(os, elf_symbols, elf_symbols->detected) == ERROR_OK) {
+		LOG_INFO("Auto-detected RTOS: %s", os->type->name);
+		*detected = 1;
+	} else {
+		LOG_WARNING("No RTOS could be auto-detected!");
+		/* leave auto-detection where rtos_create() started it */
+		free(os->symbols);
+		os->symbols = NULL;
+		os->type = rtos_types[0];
+	}
+
+done:
+	if (!build_id_size)
+		rtos_elf_symbols_free(elf_symbols);
+	return ERROR_OK;
+}
+
 /* searches for 'symbol' in the lookup table for 'os' and returns TRUE,
  * if 'symbol' is not declared optional */
 static bool is_symbol_mandatory(const struct rtos *os, const char *symbol)
@@ -216,6 +469,10 @@ static bool is_symbol_mandatory(const struct rtos *os, const char *symbol)
  * specified explicitly, then no further symbol lookup is done. When
  * auto-detecting, the RTOS driver _detect() function must return success.
  *
+ * If the target has an ELF file configured with -rtos-elf, all symbols are
+ * looked up there instead when GDB first offers symbol lookup, and GDB is
+ * not asked at all.
+ *
  * rtos_qsymbol() returns 1 if an RTOS has been detected, or 0 otherwise.
  */
 int rtos_qsymbol(struct connection *connection, char const *packet, int packet_size)
@@ -233,8 +490,14 @@ int rtos_qsymbol(struct connection *connection, char const *packet, int packet_s
 	if (!os)
 		goto done;
 
-	/* Decode any symbol name in the packet*/
-	size_t len = unhexify((uint8_t *)cur_sym, strchr(packet + 8, ':') + 1, strlen(strchr(packet + 8, ':') + 1));
+	if (target->rtos_elf && !strcmp(packet, "qSymbol::") &&
+			rtos_elf_lookup(target, &rtos_detected) == ERROR_OK)
+		goto done;
+
+	/* Decode any symbol name in the packet, packets may be larger than cur_sym */
+	const char *hex_sym = strchr(packet + 8, ':') + 1;
+	size_t len = MIN(strlen(hex_sym), (sizeof(cur_sym) - 1) * 2);
+	len = unhexify((uint8_t *)cur_sym, hex_sym, len);
 	cur_sym[len] = 0;
 
 	if ((strcmp(packet, "qSymbol::") != 0) &&               /* GDB is not offering symbol lookup for the first time */
@@ -365,6 +628,9 @@ int rtos_thread_packet(struct connection *connection, char const *packet, int pa
 			if (target->rtos->thread_count == 0) {
 				gdb_put_packet(connection, "l", 1);
 			} else {
+				/* gdb asks for every thread's registers next */
+				rtos_prefetch_stack_frames(target->rtos);
+
 				/*thread id are 16 char +1 for ',' */
 				char *out_str = malloc(17 * target->rtos->thread_count + 1);
 				char *tmp_str = out_str;
@@ -557,11 +823,152 @@ int rtos_set_reg(struct connection *connection, int reg_num,
 			(target->rtos->type->set_reg != NULL) &&
 			(current_threadid != -1) &&
 			(current_threadid != 0)) {
+		rtos_free_stack_frames(target->rtos);
 		return target->rtos->type->set_reg(target->rtos, reg_num, reg_value);
 	}
 	return ERROR_FAIL;
 }
 
+/* gaps up to this size are read along with the frames around them */
+#define RTOS_STACK_PREFETCH_GAP		256
+/* upper bound for a single prefetch read */
+#define RTOS_STACK_PREFETCH_MAX		4096
+
+static void rtos_free_stack_frames(struct rtos *rtos)
+{
+	for (int i = 0; i < rtos->stack_frame_count; i++)
+		free(rtos->stack_frames[i].data);
+	rtos->stack_frame_count = 0;
+}
+
+static struct rtos_stack_frame *rtos_find_stack_frame(struct rtos *rtos,
+	const struct rtos_register_stacking *stacking, int64_t stack_ptr)
+{
+	for (int i = 0; i < rtos->stack_frame_count; i++) {
+		struct rtos_stack_frame *frame = &rtos->stack_frames[i];
+		if (frame->stacking == stacking && frame->stack_ptr == stack_ptr)
+			return frame;
+	}
+	return NULL;
+}
+
+static struct rtos_stack_frame *rtos_add_stack_frame(struct rtos *rtos,
+	const struct rtos_register_stacking *stacking, int64_t stack_ptr,
+	uint32_t address)
+{
+	if (rtos->stack_frame_count == rtos->stack_frame_size) {
+		int size = rtos->stack_frame_size ? 2 * rtos->stack_frame_size : 16;
+		struct rtos_stack_frame *frames = realloc(rtos->stack_frames,
+				size * sizeof(*frames));
+		if (!frames)
+			return NULL;
+		rtos->stack_frames = frames;
+		rtos->stack_frame_size = size;
+	}
+
+	struct rtos_stack_frame *frame = &rtos->stack_frames[rtos->stack_frame_count++];
+	frame->stacking = stacking;
+	frame->stack_ptr = stack_ptr;
+	frame->address = address;
+	frame->data = NULL;
+	return frame;
+}
+
+static int rtos_stack_frame_compare(const void *a, const void *b)
+{
+	const struct rtos_stack_frame *fa = a;
+	const struct rtos_stack_frame *fb = b;
+
+	if (fa->address != fb->address)
+		return fa->address < fb->address ? -1 : 1;
+	return 0;
+}
+
+/* Read all frames recorded but not read yet, merging neighbouring frames
+ * into one read. Frames that cannot be read are dropped and read again on
+ * demand, which reports the error. */
+static void rtos_read_stack_frames(struct rtos *rtos)
+{
+	struct target *target = rtos->target;
+	int count = rtos->stack_frame_count;
+
+	qsort(rtos->stack_frames, count, sizeof(*rtos->stack_frames),
+			rtos_stack_frame_compare);
+
+	int first = 0;
+	while (first < count) {
+		struct rtos_stack_frame *frames = rtos->stack_frames;
+		if (frames[first].data) {
+			first++;
+			continue;
+		}
+
+		uint32_t start = frames[first].address;
+		uint32_t end = start + frames[first].stacking->stack_registers_size;
+		int last = first + 1;
+		for (; last < count; last++) {
+			uint32_t address = frames[last].address;
+			uint32_t frame_end = address + frames[last].stacking->stack_registers_size;
+			if (frames[last].data || address > end + RTOS_STACK_PREFETCH_GAP ||
+					frame_end - start > RTOS_STACK_PREFETCH_MAX)
+				break;
+			if (frame_end > end)
+				end = frame_end;
+		}
+
+		uint8_t *buffer = malloc(end - start);
+		if (buffer && target_read_buffer(target, start, end - start, buffer) == ERROR_OK) {
+			LOG_DEBUG("RTOS: Read %d stack frames at 0x%" PRIx32 "-0x%" PRIx32,
+					last - first, start, end - 1);
+			for (int i = first; i < last; i++) {
+				uint32_t size = frames[i].stacking->stack_registers_size;
+				frames[i].data = malloc(size);
+				if (frames[i].data)
+					memcpy(frames[i].data, buffer + frames[i].address - start, size);
+			}
+		}
+		free(buffer);
+		first = last;
+	}
+
+	/* keep only the frames that were read */
+	int n = 0;
+	for (int i = 0; i < count; i++) {
+		if (rtos->stack_frames[i].data)
+			rtos->stack_frames[n++] = rtos->stack_frames[i];
+	}
+	rtos->stack_frame_count = n;
+}
+
+/* Fetch the stacked registers of all threads that are not running, with
+ * as few reads as possible. Only backends that get their registers from
+ * rtos_generic_stack_read() take part. */
+static void rtos_prefetch_stack_frames(struct rtos *rtos)
+{
+	if (!rtos->type->get_thread_reg_list)
+		return;
+
+	rtos->stack_prefetch = true;
+	for (int i = 0; i < rtos->thread_count; i++) {
+		int64_t threadid = rtos->thread_details[i].threadid;
+		if (threadid == rtos->current_thread)
+			continue;
+
+		struct rtos_reg *reg_list = NULL;
+		int num_regs = 0;
+		int retval = rtos->type->get_thread_reg_list(rtos, threadid,
+				&reg_list, &num_regs);
+		if (retval == ERROR_OK && reg_list) {
+			/* got registers from elsewhere, nothing to prefetch */
+			free(reg_list);
+			break;
+		}
+	}
+	rtos->stack_prefetch = false;
+
+	rtos_read_stack_frames(rtos);
+}
+
 int rtos_generic_stack_read(struct target *target,
 	const struct rtos_register_stacking *stacking,
 	int64_t stack_ptr,
@@ -574,19 +981,46 @@ int rtos_generic_stack_read(struct target *target,
 		LOG_ERROR("Error: null stack pointer in thread");
 		return -5;
 	}
-	/* Read the stack */
-	uint8_t *stack_data = malloc(stacking->stack_registers_size);
 	uint32_t address = stack_ptr;
 
 	if (stacking->stack_growth_direction == 1)
 		address -= stacking->stack_registers_size;
-	retval = target_read_buffer(target, address, stacking->stack_registers_size, stack_data);
-	if (retval != ERROR_OK) {
-		free(stack_data);
-		LOG_ERROR("Error reading stack frame from thread");
-		return retval;
+
+	struct rtos *rtos = target->rtos;
+	struct rtos_stack_frame *frame = rtos_find_stack_frame(rtos, stacking, stack_ptr);
+
+	if (rtos->stack_prefetch) {
+		/* only note the frame, rtos_read_stack_frames() reads it */
+		if (!frame)
+			rtos_add_stack_frame(rtos, stacking, stack_ptr, address);
+		*reg_list = NULL;
+		*num_regs = 0;
+		return ERROR_OK;
+	}
+
+	/* Read the stack */
+	uint8_t *stack_data;
+	if (frame) {
+		stack_data = frame->data;
+	} else {
+		stack_data = malloc(stacking->stack_registers_size);
+		if (!stack_data) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		retval = target_read_buffer(target, address, stacking->stack_registers_size, stack_data);
+		if (retval != ERROR_OK) {
+			free(stack_data);
+			LOG_ERROR("Error reading stack frame from thread");
+			return retval;
+		}
+		LOG_DEBUG("RTOS: Read stack frame at 0x%" PRIx32, address);
+
+		/* keep it until the threads change */
+		frame = rtos_add_stack_frame(rtos, stacking, stack_ptr, address);
+		if (frame)
+			frame->data = stack_data;
 	}
-	LOG_DEBUG("RTOS: Read stack frame at 0x%" PRIx32, address);
 
 #if 0
 		LOG_OUTPUT("Stack Data :");
@@ -618,7 +1052,8 @@ int rtos_generic_stack_read(struct target *target,
 			buf_cpy(stack_data + offset, (*reg_list)[i].value, (*reg_list)[i].size);
 	}
 
-	free(stack_data);
+	if (!frame)
+		free(stack_data);
 /*	LOG_OUTPUT("Output register string: %s\r\n", *hex_reg_list); */
 	return ERROR_OK;
 }
@@ -669,4 +1104,7 @@ void rtos_free_threadlist(struct rtos *rtos)
 		rtos->current_threadid = -1;
 		rtos->current_thread = 0;
 	}
+
+	/* the stacks may have changed as well */
+	rtos_free_stack_frames(rtos);
 }
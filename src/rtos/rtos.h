@@ -44,6 +44,15 @@ struct thread_detail {
 	char *extra_info_str;
 };
 
+/* a thread's stacked registers, see rtos_generic_stack_read() */
+struct rtos_stack_frame {
+	const struct rtos_register_stacking *stacking;
+	int64_t stack_ptr;
+	uint32_t address;
+	/* NULL while only recorded by a prefetch */
+	uint8_t *data;
+};
+
 struct rtos {
 	const struct rtos_type *type;
 
@@ -59,6 +68,12 @@ struct rtos {
 	int (*gdb_thread_packet)(struct connection *connection, char const *packet, int packet_size);
 	int (*gdb_target_for_threadid)(struct connection *connection, int64_t thread_id, struct target **p_target);
 	void *rtos_specific_params;
+	/* stack frames read since the threads were last updated */
+	struct rtos_stack_frame *stack_frames;
+	int stack_frame_count;
+	int stack_frame_size;
+	/* set while rtos_generic_stack_read() only records frames */
+	bool stack_prefetch;
 };
 
 struct rtos_reg {
@@ -127,5 +142,6 @@ void rtos_free_threadlist(struct rtos *rtos);
 int rtos_smp_init(struct target *target);
 /*  function for handling symbol access */
 int rtos_qsymbol(struct connection *connection, char const *packet, int packet_size);
+void rtos_elf_cache_free(void);
 
 #endif /* OPENOCD_RTOS_RTOS_H */
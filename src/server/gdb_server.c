@@ -61,9 +61,34 @@
  * found in most modern embedded processors.
  */
 
+/* Target description XML, generated once per target and shared by all the
+ * GDB connections to it. */
+struct gdb_tdesc {
+	struct target *target;
+	/* of the register list the XML was generated from */
+	uint32_t signature;
+	/* one for the cache, one per connection in the middle of a transfer */
+	int refcount;
+	/* buffer[0] is reserved for the 'm'/'l' prefix of the qXfer replies,
+	 * the nul terminated XML follows */
+	char *buffer;
+	uint32_t length;
+	struct gdb_tdesc *next;
+};
+
+static struct gdb_tdesc *gdb_tdesc_cache;
+
+static void gdb_tdesc_release(struct gdb_tdesc *tdesc)
+{
+	if (--tdesc->refcount > 0)
+		return;
+
+	free(tdesc->buffer);
+	free(tdesc);
+}
+
 struct target_desc_format {
-	char *tdesc;
-	uint32_t tdesc_length;
+	struct gdb_tdesc *tdesc;
 };
 
 /* private connection data for GDB */
@@ -71,6 +96,10 @@ struct gdb_connection {
 	char buffer[GDB_BUFFER_SIZE + 1]; /* Extra byte for nul-termination */
 	char *buf_p;
 	int buf_cnt;
+	/* decoded packet, grown on demand up to packet_max bytes */
+	char *packet_buffer;
+	int packet_buffer_size;
+	int packet_max;
 	int ctrl_c;
 	enum target_state frontend_state;
 	struct image *vflash_image;
@@ -86,6 +115,24 @@ struct gdb_connection {
 	 * can be replied immediately and a new GDB packet will be ready without delay
 	 * (ca. 10% or so...). */
 	bool mem_write_error;
+	/* Large binary writes are queued here and written to the target in one
+	 * go when a non-contiguous write or another packet arrives, or when gdb
+	 * has nothing more to send. Errors are latched in mem_write_error. */
+	uint8_t *write_buffer;
+	uint32_t write_len;
+	target_addr_t write_addr;
+	/* gdb removes all breakpoints when the target stops and inserts them
+	 * again before resuming, one packet each. Software breakpoint packets
+	 * are acknowledged at once and queued here, then applied together
+	 * before any other packet or resume. Insertions into flash are not
+	 * queued, as they are likely to fail. Other insertion errors are
+	 * latched in bp_batch_error and fail the next step/continue. */
+	target_addr_t *bp_batch_addr;
+	uint32_t *bp_batch_len;
+	unsigned int bp_batch_count;
+	unsigned int bp_batch_size;
+	bool bp_batch_insert;
+	bool bp_batch_error;
 	/* with extended-remote it seems we need to better emulate attach/detach.
 	 * what this means is we reply with a W stop reply after a kill packet,
 	 * normally we reply with a S reply via gdb_last_signal_packet.
@@ -109,6 +156,8 @@ static int gdb_breakpoint_override;
 static enum breakpoint_type gdb_breakpoint_override_type;
 
 static int gdb_error(struct connection *connection, int retval);
+static int gdb_flush_memory_writes(struct connection *connection);
+static int gdb_flush_breakpoints(struct connection *connection);
 static char *gdb_port;
 static char *gdb_port_next;
 
@@ -142,6 +191,9 @@ static int gdb_report_register_access_error;
 /* enabled by default */
 static int gdb_use_target_description = 1;
 
+/* maximum packet size advertised to gdb, see gdb_max_packet_size */
+static int gdb_max_packet_size = GDB_BUFFER_SIZE;
+
 /* current processing free-run type, used by file-I/O */
 static char gdb_running_type;
 
@@ -493,8 +545,34 @@ int gdb_put_packet(struct connection *connection, char *buffer, int len)
 	return retval;
 }
 
+/* Make room for at least 'size' decoded bytes plus the nul terminator. */
+static int gdb_packet_buffer_reserve(struct gdb_connection *gdb_con, int size)
+{
+	if (size <= gdb_con->packet_buffer_size)
+		return ERROR_OK;
+
+	if (size > gdb_con->packet_max)
+		return ERROR_GDB_BUFFER_TOO_SMALL;
+
+	int new_size = gdb_con->packet_buffer_size;
+	while (new_size < size)
+		new_size *= 2;
+	if (new_size > gdb_con->packet_max)
+		new_size = gdb_con->packet_max;
+
+	char *new_buffer = realloc(gdb_con->packet_buffer, new_size + 1);
+	if (!new_buffer) {
+		LOG_ERROR("unable to grow packet buffer to %d bytes", new_size);
+		return ERROR_FAIL;
+	}
+
+	gdb_con->packet_buffer = new_buffer;
+	gdb_con->packet_buffer_size = new_size;
+	return ERROR_OK;
+}
+
 static inline int fetch_packet(struct connection *connection,
-		int *checksum_ok, int noack, int *len, char *buffer)
+		int *checksum_ok, int noack, int *len)
 {
 	unsigned char my_checksum = 0;
 	char checksum[3];
@@ -510,13 +588,19 @@ static inline int fetch_packet(struct connection *connection,
 	 * more freedom to optimize */
 	char *buf_p = gdb_con->buf_p;
 	int buf_cnt = gdb_con->buf_cnt;
+	char *buffer = gdb_con->packet_buffer;
 
 	for (;; ) {
 		/* The common case is that we have an entire packet with no escape chars.
 		 * We need to leave at least 2 bytes in the buffer to have
 		 * gdb_get_char() update various bits and bobs correctly.
+		 *
+		 * The packet may span several socket reads; the decoded data is
+		 * appended to the packet buffer, which grows as needed. Escapes
+		 * only shrink the data, so buf_cnt bounds what a run can add.
 		 */
-		if ((buf_cnt > 2) && ((buf_cnt + count) < *len)) {
+		if ((buf_cnt > 2) && gdb_packet_buffer_reserve(gdb_con, count + buf_cnt) == ERROR_OK) {
+			buffer = gdb_con->packet_buffer;
 			/* The compiler will struggle a bit with constant propagation and
 			 * aliasing, so we help it by showing that these values do not
 			 * change inside the loop
@@ -554,12 +638,6 @@ static inline int fetch_packet(struct connection *connection,
 			if (done)
 				break;
 		}
-		if (count > *len) {
-			LOG_ERROR("packet buffer too small");
-			retval = ERROR_GDB_BUFFER_TOO_SMALL;
-			break;
-		}
-
 		retval = gdb_get_char_fast(connection, &character, &buf_p, &buf_cnt);
 		if (retval != ERROR_OK)
 			break;
@@ -567,6 +645,14 @@ static inline int fetch_packet(struct connection *connection,
 		if (character == '#')
 			break;
 
+		retval = gdb_packet_buffer_reserve(gdb_con, count + 1);
+		if (retval != ERROR_OK) {
+			if (retval == ERROR_GDB_BUFFER_TOO_SMALL)
+				LOG_ERROR("packet buffer too small");
+			break;
+		}
+		buffer = gdb_con->packet_buffer;
+
 		if (character == '}') {
 			/* data transmitted in binary mode (X packet)
 			 * uses 0x7d as escape character */
@@ -608,8 +694,7 @@ static inline int fetch_packet(struct connection *connection,
 	return ERROR_OK;
 }
 
-static int gdb_get_packet_inner(struct connection *connection,
-		char *buffer, int *len)
+static int gdb_get_packet_inner(struct connection *connection, int *len)
 {
 	int character;
 	int retval;
@@ -662,11 +747,11 @@ static int gdb_get_packet_inner(struct connection *connection,
 		/* explicit code expansion here to get faster inlined code in -O3 by not
 		 * calculating checksum */
 		if (gdb_con->noack_mode) {
-			retval = fetch_packet(connection, &checksum_ok, 1, len, buffer);
+			retval = fetch_packet(connection, &checksum_ok, 1, len);
 			if (retval != ERROR_OK)
 				return retval;
 		} else {
-			retval = fetch_packet(connection, &checksum_ok, 0, len, buffer);
+			retval = fetch_packet(connection, &checksum_ok, 0, len);
 			if (retval != ERROR_OK)
 				return retval;
 		}
@@ -688,11 +773,11 @@ static int gdb_get_packet_inner(struct connection *connection,
 	return ERROR_OK;
 }
 
-static int gdb_get_packet(struct connection *connection, char *buffer, int *len)
+static int gdb_get_packet(struct connection *connection, int *len)
 {
 	struct gdb_connection *gdb_con = connection->priv;
 	gdb_con->busy = true;
-	int retval = gdb_get_packet_inner(connection, buffer, len);
+	int retval = gdb_get_packet_inner(connection, len);
 	gdb_con->busy = false;
 	return retval;
 }
@@ -921,6 +1006,10 @@ static int gdb_target_callback_event_handler(struct target *target,
 		case TARGET_EVENT_HALTED:
 			target_call_event_callbacks(target, TARGET_EVENT_GDB_END);
 			break;
+		case TARGET_EVENT_RESUME_START:
+			/* also when resumed from elsewhere than this connection */
+			gdb_flush_breakpoints(connection);
+			break;
 		default:
 			break;
 	}
@@ -935,6 +1024,20 @@ static int gdb_new_connection(struct connection *connection)
 	int retval;
 	int initial_ack;
 
+	if (!gdb_connection) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	gdb_connection->packet_buffer = malloc(GDB_BUFFER_SIZE + 1);
+	if (!gdb_connection->packet_buffer) {
+		LOG_ERROR("Out of memory");
+		free(gdb_connection);
+		return ERROR_FAIL;
+	}
+	gdb_connection->packet_buffer_size = GDB_BUFFER_SIZE;
+	gdb_connection->packet_max = gdb_max_packet_size;
+
 	target = get_target_from_connection(connection);
 	connection->priv = gdb_connection;
 	connection->cmd_ctx->current_target = target;
@@ -950,10 +1053,18 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->noack_mode = 0;
 	gdb_connection->sync = false;
 	gdb_connection->mem_write_error = false;
+	gdb_connection->write_buffer = NULL;
+	gdb_connection->write_len = 0;
+	gdb_connection->write_addr = 0;
+	gdb_connection->bp_batch_addr = NULL;
+	gdb_connection->bp_batch_len = NULL;
+	gdb_connection->bp_batch_count = 0;
+	gdb_connection->bp_batch_size = 0;
+	gdb_connection->bp_batch_insert = false;
+	gdb_connection->bp_batch_error = false;
 	gdb_connection->attached = true;
 	gdb_connection->extended_protocol = false;
 	gdb_connection->target_desc.tdesc = NULL;
-	gdb_connection->target_desc.tdesc_length = 0;
 	gdb_connection->thread_list = NULL;
 
 	/* send ACK to GDB for debug request */
@@ -1047,6 +1158,16 @@ static int gdb_connection_closed(struct connection *connection)
 		target_state_name(target),
 		gdb_actual_connections);
 
+	/* complete the writes gdb has already been told about */
+	gdb_flush_memory_writes(connection);
+	free(gdb_connection->write_buffer);
+
+	/* apply the breakpoint packets gdb has already been told about */
+	gdb_flush_breakpoints(connection);
+	free(gdb_connection->bp_batch_addr);
+	free(gdb_connection->bp_batch_len);
+	gdb_connection->bp_batch_count = 0;
+
 	/* see if an image built with vFlash commands is left */
 	if (gdb_connection->vflash_image) {
 		image_close(gdb_connection->vflash_image);
@@ -1057,7 +1178,13 @@ static int gdb_connection_closed(struct connection *connection)
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, target);
 
+	if (gdb_connection->target_desc.tdesc) {
+		gdb_tdesc_release(gdb_connection->target_desc.tdesc);
+		gdb_connection->target_desc.tdesc = NULL;
+	}
+
 	if (connection->priv) {
+		free(gdb_connection->packet_buffer);
 		free(connection->priv);
 		connection->priv = NULL;
 	} else
@@ -1157,6 +1284,42 @@ static void gdb_target_to_reg(struct target *target,
 	}
 }
 
+/**
+ * Fetch the invalid registers of the list whose type can read several
+ * registers at once, one call per register type. Whatever is still invalid
+ * afterwards is read one by one by the caller.
+ */
+static void gdb_get_multiple_registers(struct reg **reg_list, int reg_list_size)
+{
+	struct reg **batch = malloc(reg_list_size * sizeof(*batch));
+	bool *done = calloc(reg_list_size, sizeof(*done));
+	if (batch == NULL || done == NULL)
+		goto out;
+
+	for (int i = 0; i < reg_list_size; i++) {
+		struct reg *reg = reg_list[i];
+		if (done[i] || reg == NULL || !reg->exist || reg->valid ||
+				!reg->type->get_multiple)
+			continue;
+
+		unsigned num_regs = 0;
+		for (int j = i; j < reg_list_size; j++) {
+			struct reg *r = reg_list[j];
+			if (done[j] || r == NULL || !r->exist || r->valid || r->type != reg->type)
+				continue;
+			done[j] = true;
+			batch[num_regs++] = r;
+		}
+
+		if (reg->type->get_multiple(batch, num_regs) != ERROR_OK)
+			LOG_DEBUG("Couldn't get registers at once, reading them one by one.");
+	}
+
+out:
+	free(batch);
+	free(done);
+}
+
 static int gdb_get_registers_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -1195,6 +1358,8 @@ static int gdb_get_registers_packet(struct connection *connection,
 
 	reg_packet_p = reg_packet;
 
+	gdb_get_multiple_registers(reg_list, reg_list_size);
+
 	for (i = 0; i < reg_list_size; i++) {
 		if (reg_list[i] == NULL || reg_list[i]->exist == false)
 			continue;
@@ -1538,6 +1703,68 @@ static int gdb_write_memory_packet(struct connection *connection,
 	return retval;
 }
 
+/* Write out the queued binary memory writes, if any. */
+static int gdb_flush_memory_writes(struct connection *connection)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+
+	if (!gdb_connection->write_len)
+		return ERROR_OK;
+
+	LOG_DEBUG("flushing queued writes, addr: 0x%" TARGET_PRIxADDR ", len: 0x%8.8" PRIx32 "",
+			gdb_connection->write_addr, gdb_connection->write_len);
+
+	int retval = target_write_buffer(target, gdb_connection->write_addr,
+			gdb_connection->write_len, gdb_connection->write_buffer);
+	gdb_connection->write_len = 0;
+	if (retval != ERROR_OK)
+		gdb_connection->mem_write_error = true;
+
+	return retval;
+}
+
+/* Queue a write that has already been acknowledged to gdb. Contiguous writes
+ * are merged, so the adapter sees a few large transfers instead of one per
+ * packet. */
+static int gdb_queue_memory_write(struct connection *connection,
+		target_addr_t addr, uint32_t len, const uint8_t *data)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	int retval = ERROR_OK;
+
+	if (gdb_connection->write_len &&
+			(addr != gdb_connection->write_addr + gdb_connection->write_len ||
+			 gdb_connection->write_len + len > GDB_WRITE_BEHIND_SIZE))
+		retval = gdb_flush_memory_writes(connection);
+
+	if (len > GDB_WRITE_BEHIND_SIZE) {
+		struct target *target = get_target_from_connection(connection);
+		int retval2 = target_write_buffer(target, addr, len, data);
+		if (retval2 != ERROR_OK) {
+			gdb_connection->mem_write_error = true;
+			retval = retval2;
+		}
+		return retval;
+	}
+
+	if (!gdb_connection->write_buffer) {
+		gdb_connection->write_buffer = malloc(GDB_WRITE_BEHIND_SIZE);
+		if (!gdb_connection->write_buffer) {
+			LOG_ERROR("Out of memory");
+			gdb_connection->mem_write_error = true;
+			return ERROR_FAIL;
+		}
+	}
+
+	if (!gdb_connection->write_len)
+		gdb_connection->write_addr = addr;
+	memcpy(gdb_connection->write_buffer + gdb_connection->write_len, data, len);
+	gdb_connection->write_len += len;
+
+	return retval;
+}
+
 static int gdb_write_memory_binary_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -1571,6 +1798,11 @@ static int gdb_write_memory_binary_packet(struct connection *connection,
 
 	struct gdb_connection *gdb_connection = connection->priv;
 
+	/* small writes are done synchronously, so complete the queued ones
+	 * first; any error they hit is then reported right here */
+	if (len < fast_limit)
+		gdb_flush_memory_writes(connection);
+
 	if (gdb_connection->mem_write_error)
 		retval = ERROR_FAIL;
 
@@ -1595,9 +1827,14 @@ static int gdb_write_memory_binary_packet(struct connection *connection,
 	if (len) {
 		LOG_DEBUG("addr: 0x%" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
-		retval = target_write_buffer(target, addr, len, (uint8_t *)separator);
-		if (retval != ERROR_OK)
-			gdb_connection->mem_write_error = true;
+		if (len >= fast_limit) {
+			/* already acknowledged, written behind while gdb sends more */
+			retval = gdb_queue_memory_write(connection, addr, len, (uint8_t *)separator);
+		} else {
+			retval = target_write_buffer(target, addr, len, (uint8_t *)separator);
+			if (retval != ERROR_OK)
+				gdb_connection->mem_write_error = true;
+		}
 	}
 
 	if (len < fast_limit) {
@@ -1640,6 +1877,78 @@ static int gdb_step_continue_packet(struct connection *connection,
 	return retval;
 }
 
+static int gdb_flush_breakpoints(struct connection *connection)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+	unsigned int count = gdb_connection->bp_batch_count;
+	int retval = ERROR_OK;
+
+	if (!count)
+		return ERROR_OK;
+
+	/* empty the queue first, nothing must be applied twice */
+	gdb_connection->bp_batch_count = 0;
+
+	LOG_DEBUG("flushing %u queued breakpoint %s", count,
+			gdb_connection->bp_batch_insert ? "insertions" : "removals");
+
+	if (gdb_connection->bp_batch_insert) {
+		retval = breakpoint_add_batch(target, gdb_connection->bp_batch_addr,
+				gdb_connection->bp_batch_len, count, BKPT_SOFT);
+		if (retval != ERROR_OK)
+			gdb_connection->bp_batch_error = true;
+	} else
+		breakpoint_remove_batch(target, gdb_connection->bp_batch_addr, count);
+
+	return retval;
+}
+
+/* Queue a software breakpoint packet that has not been acknowledged yet.
+ * Returns false if it has to be handled right away instead. */
+static bool gdb_queue_breakpoint(struct connection *connection, bool insert,
+		target_addr_t address, uint32_t size)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+
+	/* only worth it if the target can apply the batch in one go */
+	if (insert ? !target->type->add_breakpoints : !target->type->remove_breakpoints)
+		return false;
+
+	/* gdb has to see the error of a software breakpoint in flash */
+	if (insert) {
+		struct flash_bank *bank;
+		if (get_flash_bank_by_addr(target, address, false, &bank) != ERROR_OK || bank)
+			return false;
+	}
+
+	if (gdb_connection->bp_batch_count && gdb_connection->bp_batch_insert != insert)
+		gdb_flush_breakpoints(connection);
+
+	if (gdb_connection->bp_batch_count == gdb_connection->bp_batch_size) {
+		unsigned int new_size = gdb_connection->bp_batch_size ?
+				gdb_connection->bp_batch_size * 2 : 32;
+		target_addr_t *addr = realloc(gdb_connection->bp_batch_addr,
+				new_size * sizeof(*addr));
+		if (addr)
+			gdb_connection->bp_batch_addr = addr;
+		uint32_t *len = realloc(gdb_connection->bp_batch_len,
+				new_size * sizeof(*len));
+		if (len)
+			gdb_connection->bp_batch_len = len;
+		if (!addr || !len)
+			return false;
+		gdb_connection->bp_batch_size = new_size;
+	}
+
+	gdb_connection->bp_batch_addr[gdb_connection->bp_batch_count] = address;
+	gdb_connection->bp_batch_len[gdb_connection->bp_batch_count] = size;
+	gdb_connection->bp_batch_count++;
+	gdb_connection->bp_batch_insert = insert;
+	return true;
+}
+
 static int gdb_breakpoint_watchpoint_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -1691,6 +2000,12 @@ static int gdb_breakpoint_watchpoint_packet(struct connection *connection,
 	switch (type) {
 		case 0:
 		case 1:
+			if (bp_type == BKPT_SOFT && gdb_queue_breakpoint(connection,
+						packet[0] == 'Z', address, size)) {
+				gdb_put_packet(connection, "OK", 2);
+				break;
+			}
+			gdb_flush_breakpoints(connection);
 			if (packet[0] == 'Z') {
 				retval = breakpoint_add(target, address, size, bp_type);
 				if (retval != ERROR_OK) {
@@ -1738,6 +2053,7 @@ static __attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 5, 6))) void xml_printf(
 	if (*retval != ERROR_OK)
 		return;
 	int first = 1;
+	int needed = 0;
 
 	for (;; ) {
 		if ((*xml == NULL) || (!first)) {
@@ -1745,6 +2061,9 @@ static __attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 5, 6))) void xml_printf(
 			 * Need minimum 2 bytes to fit 1 char and 0 terminator. */
 
 			*size = *size * 2 + 2;
+			/* grow in one step to what vsnprintf() asked for */
+			if (*size < needed)
+				*size = needed;
 			char *t = *xml;
 			*xml = realloc(*xml, *size);
 			if (*xml == NULL) {
@@ -1765,6 +2084,8 @@ static __attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 5, 6))) void xml_printf(
 			return;
 		}
 		/* there was just enough or not enough space, allocate more. */
+		if (ret > 0)
+			needed = *pos + ret + 2;
 		first = 0;
 	}
 }
@@ -2202,7 +2523,17 @@ static int get_reg_features_list(struct target *target, char const **feature_lis
 	return ERROR_OK;
 }
 
-static int gdb_generate_target_description(struct target *target, char **tdesc_out)
+/* Rough size of the XML describing one register, to allocate the output
+ * buffer once in most cases. */
+#define TDESC_BYTES_PER_REG	128
+#define TDESC_BYTES_HEADER	1024
+
+/**
+ * Generate the target description XML into a buffer whose first byte is
+ * reserved, see struct gdb_tdesc. The XML starts at (*tdesc_out + 1).
+ */
+static int gdb_generate_target_description(struct target *target, char **tdesc_out,
+		uint32_t *length_out)
 {
 	int retval = ERROR_OK;
 	struct reg **reg_list = NULL;
@@ -2211,7 +2542,7 @@ static int gdb_generate_target_description(struct target *target, char **tdesc_o
 	char const **features = NULL;
 	int feature_list_size = 0;
 	char *tdesc = NULL;
-	int pos = 0;
+	int pos = 1;
 	int size = 0;
 
 
@@ -2241,6 +2572,13 @@ static int gdb_generate_target_description(struct target *target, char **tdesc_o
 	/* If we found some features associated with registers, create sections */
 	int current_feature = 0;
 
+	size = TDESC_BYTES_HEADER + reg_list_size * TDESC_BYTES_PER_REG;
+	tdesc = malloc(size);
+	if (tdesc == NULL) {
+		retval = ERROR_FAIL;
+		goto error;
+	}
+
 	xml_printf(&retval, &tdesc, &pos, &size,
 			"<?xml version=\"1.0\"?>\n"
 			"<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
@@ -2334,66 +2672,171 @@ error:
 	free(features);
 	free(reg_list);
 
-	if (retval == ERROR_OK)
+	if (retval == ERROR_OK) {
 		*tdesc_out = tdesc;
-	else
+		*length_out = pos - 1;
+	} else
 		free(tdesc);
 
 	return retval;
 }
 
-static int gdb_get_target_description_chunk(struct target *target, struct target_desc_format *target_desc,
-		char **chunk, int32_t offset, uint32_t length)
+static uint32_t gdb_tdesc_hash(uint32_t hash, const void *data, size_t len)
+{
+	/* FNV-1a */
+	const uint8_t *p = data;
+	while (len--) {
+		hash ^= *p++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static uint32_t gdb_tdesc_hash_str(uint32_t hash, const char *str)
+{
+	return str ? gdb_tdesc_hash(hash, str, strlen(str) + 1) : gdb_tdesc_hash(hash, "", 1);
+}
+
+/**
+ * Compute a signature of everything the target description is generated
+ * from, so that a cached description can be checked without regenerating it.
+ */
+static int gdb_target_description_signature(struct target *target, uint32_t *signature)
+{
+	struct reg **reg_list;
+	int reg_list_size;
+	uint32_t hash = 2166136261u;
+
+	int retval = target_get_gdb_reg_list_noread(target, &reg_list,
+			&reg_list_size, REG_CLASS_ALL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	hash = gdb_tdesc_hash_str(hash, target_get_gdb_arch(target));
+	hash = gdb_tdesc_hash(hash, &reg_list_size, sizeof(reg_list_size));
+	for (int i = 0; i < reg_list_size; i++) {
+		struct reg *reg = reg_list[i];
+
+		hash = gdb_tdesc_hash(hash, &reg->exist, sizeof(reg->exist));
+		if (!reg->exist)
+			continue;
+		hash = gdb_tdesc_hash_str(hash, reg->name);
+		hash = gdb_tdesc_hash(hash, &reg->number, sizeof(reg->number));
+		hash = gdb_tdesc_hash(hash, &reg->size, sizeof(reg->size));
+		hash = gdb_tdesc_hash(hash, &reg->caller_save, sizeof(reg->caller_save));
+		hash = gdb_tdesc_hash(hash, &reg->reg_data_type, sizeof(reg->reg_data_type));
+		hash = gdb_tdesc_hash_str(hash, reg->feature ? reg->feature->name : NULL);
+		hash = gdb_tdesc_hash_str(hash, reg->group);
+	}
+
+	free(reg_list);
+	*signature = hash;
+	return ERROR_OK;
+}
+
+/**
+ * Get the target description of a target, from the cache if the register
+ * set did not change since it was generated. The caller owns a reference
+ * and must drop it with gdb_tdesc_release().
+ */
+static int gdb_get_target_description(struct target *target, struct gdb_tdesc **tdesc_out)
+{
+	uint32_t signature;
+	int retval = gdb_target_description_signature(target, &signature);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct gdb_tdesc **p = &gdb_tdesc_cache;
+	while (*p && (*p)->target != target)
+		p = &(*p)->next;
+
+	struct gdb_tdesc *tdesc = *p;
+	if (tdesc) {
+		if (tdesc->signature == signature) {
+			tdesc->refcount++;
+			*tdesc_out = tdesc;
+			return ERROR_OK;
+		}
+
+		/* the register set changed, drop the stale description */
+		*p = tdesc->next;
+		gdb_tdesc_release(tdesc);
+	}
+
+	tdesc = calloc(1, sizeof(*tdesc));
+	if (tdesc == NULL)
+		return ERROR_FAIL;
+
+	retval = gdb_generate_target_description(target, &tdesc->buffer, &tdesc->length);
+	if (retval != ERROR_OK) {
+		free(tdesc);
+		return retval;
+	}
+
+	tdesc->target = target;
+	tdesc->signature = signature;
+	tdesc->refcount = 2;
+	tdesc->next = gdb_tdesc_cache;
+	gdb_tdesc_cache = tdesc;
+
+	*tdesc_out = tdesc;
+	return ERROR_OK;
+}
+
+/**
+ * Send a chunk of the target description in reply to qXfer:features:read.
+ * The reply is sent straight from the shared XML buffer: the byte in front
+ * of the chunk is temporarily replaced with the 'm' (more chunks to
+ * transfer) or 'l' (last chunk) prefix.
+ */
+static int gdb_send_target_description_chunk(struct connection *connection,
+		struct target *target, struct target_desc_format *target_desc,
+		uint32_t offset, uint32_t length)
 {
 	if (target_desc == NULL) {
 		LOG_ERROR("Unable to Generate Target Description");
 		return ERROR_FAIL;
 	}
 
-	char *tdesc = target_desc->tdesc;
-	uint32_t tdesc_length = target_desc->tdesc_length;
+	/* A transfer restarting from 0 picks up any change of the register set */
+	if (target_desc->tdesc && offset == 0) {
+		gdb_tdesc_release(target_desc->tdesc);
+		target_desc->tdesc = NULL;
+	}
 
-	if (tdesc == NULL) {
-		int retval = gdb_generate_target_description(target, &tdesc);
+	if (target_desc->tdesc == NULL) {
+		int retval = gdb_get_target_description(target, &target_desc->tdesc);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Unable to Generate Target Description");
 			return ERROR_FAIL;
 		}
-
-		tdesc_length = strlen(tdesc);
 	}
 
-	char transfer_type;
+	struct gdb_tdesc *tdesc = target_desc->tdesc;
+	if (offset > tdesc->length)
+		offset = tdesc->length;
 
-	if (length < (tdesc_length - offset))
+	char transfer_type;
+	if (length < (tdesc->length - offset))
 		transfer_type = 'm';
-	else
+	else {
 		transfer_type = 'l';
-
-	*chunk = malloc(length + 2);
-	if (*chunk == NULL) {
-		LOG_ERROR("Unable to allocate memory");
-		return ERROR_FAIL;
+		length = tdesc->length - offset;
 	}
 
-	(*chunk)[0] = transfer_type;
-	if (transfer_type == 'm') {
-		strncpy((*chunk) + 1, tdesc + offset, length);
-		(*chunk)[1 + length] = '\0';
-	} else {
-		strncpy((*chunk) + 1, tdesc + offset, tdesc_length - offset);
-		(*chunk)[1 + (tdesc_length - offset)] = '\0';
+	char *chunk = tdesc->buffer + offset;
+	char saved = *chunk;
+	*chunk = transfer_type;
+	int retval = gdb_put_packet(connection, chunk, length + 1);
+	*chunk = saved;
 
-		/* After gdb-server sends out last chunk, invalidate tdesc. */
-		free(tdesc);
-		tdesc = NULL;
-		tdesc_length = 0;
+	if (transfer_type == 'l') {
+		/* After gdb-server sends out last chunk, drop the reference. */
+		gdb_tdesc_release(tdesc);
+		target_desc->tdesc = NULL;
 	}
 
-	target_desc->tdesc = tdesc;
-	target_desc->tdesc_length = tdesc_length;
-
-	return ERROR_OK;
+	return retval;
 }
 
 static int gdb_target_description_supported(struct target *target, int *supported)
@@ -2624,7 +3067,7 @@ static int gdb_query_packet(struct connection *connection,
 			&pos,
 			&size,
 			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+",
-			GDB_BUFFER_SIZE,
+			gdb_connection->packet_max,
 			((gdb_use_memory_map == 1) && (flash_get_bank_count() > 0)) ? '+' : '-',
 			(gdb_target_desc_supported == 1) ? '+' : '-');
 
@@ -2641,7 +3084,6 @@ static int gdb_query_packet(struct connection *connection,
 		   && (flash_get_bank_count() > 0))
 		return gdb_memory_map(connection, packet, packet_size);
 	else if (strncmp(packet, "qXfer:features:read:", 20) == 0) {
-		char *xml = NULL;
 		int retval = ERROR_OK;
 
 		int offset;
@@ -2656,20 +3098,17 @@ static int gdb_query_packet(struct connection *connection,
 		}
 
 		/* Target should prepare correct target description for annex.
-		 * The first character of returned xml is 'm' or 'l'. 'm' for
+		 * The first character of the reply is 'm' or 'l'. 'm' for
 		 * there are *more* chunks to transfer. 'l' for it is the *last*
 		 * chunk of target description.
 		 */
-		retval = gdb_get_target_description_chunk(target, &gdb_connection->target_desc,
-				&xml, offset, length);
+		retval = gdb_send_target_description_chunk(connection, target,
+				&gdb_connection->target_desc, offset, length);
 		if (retval != ERROR_OK) {
 			gdb_error(connection, retval);
 			return retval;
 		}
 
-		gdb_put_packet(connection, xml, strlen(xml));
-
-		free(xml);
 		return ERROR_OK;
 	} else if (strncmp(packet, "qXfer:threads:read:", 19) == 0) {
 		char *xml = NULL;
@@ -3223,11 +3662,8 @@ static void gdb_sig_halted(struct connection *connection)
 
 static int gdb_input_inner(struct connection *connection)
 {
-	/* Do not allocate this on the stack */
-	static char gdb_packet_buffer[GDB_BUFFER_SIZE + 1]; /* Extra byte for nul-termination */
-
 	struct target *target;
-	char const *packet = gdb_packet_buffer;
+	char const *packet;
 	int packet_size;
 	int retval;
 	struct gdb_connection *gdb_con = connection->priv;
@@ -3246,13 +3682,13 @@ static int gdb_input_inner(struct connection *connection)
 	 * drain the rest of the buffer.
 	 */
 	do {
-		packet_size = GDB_BUFFER_SIZE;
-		retval = gdb_get_packet(connection, gdb_packet_buffer, &packet_size);
+		retval = gdb_get_packet(connection, &packet_size);
 		if (retval != ERROR_OK)
 			return retval;
 
-		/* terminate with zero */
-		gdb_packet_buffer[packet_size] = '\0';
+		/* terminate with zero, the packet buffer always has room for it */
+		gdb_con->packet_buffer[packet_size] = '\0';
+		packet = gdb_con->packet_buffer;
 
 		if (LOG_LEVEL_IS(LOG_LVL_DEBUG)) {
 			if (packet[0] == 'X') {
@@ -3267,6 +3703,15 @@ static int gdb_input_inner(struct connection *connection)
 				LOG_DEBUG("received packet: '%s'", packet);
 		}
 
+		/* everything but another binary write must see the queued
+		 * writes on the target */
+		if (packet_size == 0 || packet[0] != 'X')
+			gdb_flush_memory_writes(connection);
+
+		/* likewise for breakpoints, except for more of them */
+		if (packet_size < 2 || (packet[0] != 'Z' && packet[0] != 'z') || packet[1] != '0')
+			gdb_flush_breakpoints(connection);
+
 		if (packet_size > 0) {
 			retval = ERROR_OK;
 			switch (packet[0]) {
@@ -3311,6 +3756,15 @@ static int gdb_input_inner(struct connection *connection)
 				case 'c':
 				case 's':
 				{
+					if (gdb_con->bp_batch_error) {
+						/* gdb was told the breakpoints are set, it must not
+						 * run past one that is missing */
+						LOG_ERROR("Breakpoint insertion failure, not resuming!");
+						gdb_con->bp_batch_error = false;
+						retval = gdb_error(connection, ERROR_FAIL);
+						break;
+					}
+
 					gdb_thread_packet(connection, packet, packet_size);
 					log_add_callback(gdb_log_callback, connection);
 
@@ -3321,7 +3775,6 @@ static int gdb_input_inner(struct connection *connection)
 						 * we can clear the condition */
 						gdb_con->mem_write_error = false;
 					}
-
 					bool nostep = false;
 					bool already_running = false;
 					if (target->state == TARGET_RUNNING) {
@@ -3462,6 +3915,15 @@ static int gdb_input_inner(struct connection *connection)
 
 	} while (gdb_con->buf_cnt > 0);
 
+	/* Keep queued writes only while gdb is still streaming packets; once
+	 * it goes quiet, e.g. after the last block of a load, write them out. */
+	if (gdb_con->write_len) {
+		int got_data = 0;
+		check_pending(connection, 0, &got_data);
+		if (!got_data)
+			gdb_flush_memory_writes(connection);
+	}
+
 	return ERROR_OK;
 }
 
@@ -3631,6 +4093,23 @@ COMMAND_HANDLER(handle_gdb_flash_program_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_max_packet_size_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int size;
+	COMMAND_PARSE_NUMBER(int, CMD_ARGV[0], size);
+	if (size < GDB_BUFFER_SIZE || size > GDB_MAX_PACKET_SIZE) {
+		command_print(CMD, "packet size must be between %d and %d",
+				GDB_BUFFER_SIZE, GDB_MAX_PACKET_SIZE);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	gdb_max_packet_size = size;
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_report_data_abort_command)
 {
 	if (CMD_ARGC != 1)
@@ -3684,18 +4163,15 @@ COMMAND_HANDLER(handle_gdb_target_description_command)
 
 COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 {
-	char *tdesc;
-	uint32_t tdesc_length;
+	struct gdb_tdesc *tdesc;
 	struct target *target = get_current_target(CMD_CTX);
 
-	int retval = gdb_generate_target_description(target, &tdesc);
+	int retval = gdb_get_target_description(target, &tdesc);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Unable to Generate Target Description");
 		return ERROR_FAIL;
 	}
 
-	tdesc_length = strlen(tdesc);
-
 	struct fileio *fileio;
 	size_t size_written;
 
@@ -3712,7 +4188,7 @@ COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 		goto out;
 	}
 
-	retval = fileio_write(fileio, tdesc_length, tdesc, &size_written);
+	retval = fileio_write(fileio, tdesc->length, tdesc->buffer + 1, &size_written);
 
 	fileio_close(fileio);
 
@@ -3721,7 +4197,7 @@ COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 
 out:
 	free(tdesc_filename);
-	free(tdesc);
+	gdb_tdesc_release(tdesc);
 
 	return retval;
 }
@@ -3763,6 +4239,13 @@ static const struct command_registration gdb_command_handlers[] = {
 		.help = "enable or disable flash program",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "gdb_max_packet_size",
+		.handler = handle_gdb_max_packet_size_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the maximum packet size advertised to gdb",
+		.usage = "size"
+	},
 	{
 		.name = "gdb_report_data_abort",
 		.handler = handle_gdb_report_data_abort_command,
@@ -3813,4 +4296,10 @@ void gdb_service_free(void)
 {
 	free(gdb_port);
 	free(gdb_port_next);
+
+	while (gdb_tdesc_cache) {
+		struct gdb_tdesc *tdesc = gdb_tdesc_cache;
+		gdb_tdesc_cache = tdesc->next;
+		gdb_tdesc_release(tdesc);
+	}
 }
@@ -33,6 +33,10 @@ struct reg;
 #include <target/target.h>
 
 #define GDB_BUFFER_SIZE 16384
+/* upper bound for the packet size configured with gdb_max_packet_size */
+#define GDB_MAX_PACKET_SIZE (256 * 1024)
+/* size of the per connection queue for binary memory writes */
+#define GDB_WRITE_BEHIND_SIZE (64 * 1024)
 
 int gdb_target_add_all(struct target *target);
 int gdb_register_commands(struct command_context *command_context);
@@ -0,0 +1,221 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "rtt_server.h"
+#include <target/rtt.h>
+
+#define RTT_SERVER_BUFFER_SIZE 1024
+
+/* one per "rtt server start", freed by remove_service(), see
+ * rtt_server_remove() */
+struct rtt_service {
+	unsigned int channel;
+	char *port;
+	struct service *service;
+	unsigned int num_connections;
+	struct rtt_service *next;
+};
+
+static struct rtt_service *rtt_services;
+
+/* up channel data is copied to every client of the service */
+static int rtt_server_sink(unsigned int channel, const uint8_t *data,
+		size_t length, void *priv)
+{
+	struct rtt_service *rtt_service = priv;
+
+	if (!rtt_service->service)
+		return ERROR_OK;
+
+	for (struct connection *c = rtt_service->service->connections; c; c = c->next)
+		connection_write(c, data, length);
+
+	return ERROR_OK;
+}
+
+static int rtt_new_connection(struct connection *connection)
+{
+	struct rtt_service *rtt_service = connection->service->priv;
+
+	connection->priv = NULL;
+	rtt_service->service = connection->service;
+
+	/* the channel is only drained while somebody is listening */
+	if (!rtt_service->num_connections) {
+		int retval = rtt_register_sink(rtt_service->channel, rtt_server_sink,
+				rtt_service);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	rtt_service->num_connections++;
+
+	LOG_INFO("accepting 'rtt' connection for channel %u on tcp/%s",
+			rtt_service->channel, rtt_service->port);
+	return ERROR_OK;
+}
+
+static int rtt_connection_closed(struct connection *connection)
+{
+	struct rtt_service *rtt_service = connection->service->priv;
+
+	if (rtt_service->num_connections && !--rtt_service->num_connections)
+		rtt_unregister_sink(rtt_service->channel, rtt_server_sink, rtt_service);
+
+	return ERROR_OK;
+}
+
+static int rtt_input(struct connection *connection)
+{
+	struct rtt_service *rtt_service = connection->service->priv;
+	uint8_t buffer[RTT_SERVER_BUFFER_SIZE];
+
+	int bytes_read = connection_read(connection, buffer, sizeof(buffer));
+	if (bytes_read == 0)
+		return ERROR_SERVER_REMOTE_CLOSED;
+	else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	size_t length = bytes_read;
+	int retval = rtt_write_channel(rtt_service->channel, buffer, &length);
+	if (retval != ERROR_OK || length < (size_t)bytes_read)
+		LOG_WARNING("rtt: dropped %zu bytes for down channel %u",
+				bytes_read - length, rtt_service->channel);
+
+	return ERROR_OK;
+}
+
+/* unlink the entry and stop its service */
+static void rtt_server_remove(struct rtt_service **p)
+{
+	struct rtt_service *rtt_service = *p;
+	char *port = rtt_service->port;
+
+	*p = rtt_service->next;
+
+	/* closes the connections, which unregisters the sink, and frees
+	 * rtt_service */
+	remove_service("rtt", port);
+	free(port);
+}
+
+COMMAND_HANDLER(handle_rtt_server_start_command)
+{
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int channel;
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], channel);
+
+	for (struct rtt_service *s = rtt_services; s; s = s->next) {
+		if (!strcmp(s->port, CMD_ARGV[0])) {
+			command_print(CMD, "rtt server already running on port %s", CMD_ARGV[0]);
+			return ERROR_FAIL;
+		}
+	}
+
+	struct rtt_service *rtt_service = calloc(1, sizeof(*rtt_service));
+	if (!rtt_service) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	rtt_service->channel = channel;
+	rtt_service->port = strdup(CMD_ARGV[0]);
+
+	int retval = add_service("rtt", CMD_ARGV[0], CONNECTION_LIMIT_UNLIMITED,
+			rtt_new_connection, rtt_input, rtt_connection_closed, rtt_service);
+	if (retval != ERROR_OK) {
+		free(rtt_service->port);
+		free(rtt_service);
+		return retval;
+	}
+
+	rtt_service->next = rtt_services;
+	rtt_services = rtt_service;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtt_server_stop_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	for (struct rtt_service **p = &rtt_services; *p; p = &(*p)->next) {
+		if (strcmp((*p)->port, CMD_ARGV[0]))
+			continue;
+
+		rtt_server_remove(p);
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "no rtt server on port %s", CMD_ARGV[0]);
+	return ERROR_FAIL;
+}
+
+static const struct command_registration rtt_server_subcommand_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_rtt_server_start_command,
+		.mode = COMMAND_EXEC,
+		.help = "serve an RTT channel on a TCP port",
+		.usage = "port channel",
+	},
+	{
+		.name = "stop",
+		.handler = handle_rtt_server_stop_command,
+		.mode = COMMAND_EXEC,
+		.help = "stop serving an RTT channel",
+		.usage = "port",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration rtt_server_command_handlers[] = {
+	{
+		.name = "server",
+		.mode = COMMAND_ANY,
+		.help = "RTT channel TCP servers",
+		.usage = "",
+		.chain = rtt_server_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration rtt_command_handlers[] = {
+	{
+		.name = "rtt",
+		.mode = COMMAND_ANY,
+		.help = "target RAM ring buffer console",
+		.usage = "",
+		.chain = rtt_server_command_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int rtt_server_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, rtt_command_handlers);
+}
+
+void rtt_server_free(void)
+{
+	while (rtt_services)
+		rtt_server_remove(&rtt_services);
+}
@@ -27,6 +27,16 @@
 #define TCL_SERVER_VERSION		"TCL Server 0.1"
 #define TCL_LINE_INITIAL		(4*1024)
 #define TCL_LINE_MAX			(4*1024*1024)
+/* notifications are dropped rather than queued beyond this */
+#define TCL_NOTIFY_QUEUE_MAX	(256*1024)
+/* how long a client may stall while we send it a command result */
+#define TCL_WRITE_TIMEOUT_MS	5000
+#define TCL_DRAIN_PERIOD_MS		10
+
+/* binary framing: one type byte, a big endian 32-bit length, the payload */
+#define TCL_FRAME_RESULT		'R'
+#define TCL_FRAME_NOTIFY		'N'
+#define TCL_FRAME_HEADER_SIZE	5
 
 struct tcl_connection {
 	int tc_linedrop;
@@ -37,6 +47,13 @@ struct tcl_connection {
 	enum target_state tc_laststate;
 	bool tc_notify;
 	bool tc_trace;
+	bool tc_binary;
+	/* output queue, sent without blocking from the event loop */
+	uint8_t *tc_out;
+	size_t tc_out_head;
+	size_t tc_out_len;
+	size_t tc_out_size;
+	unsigned int tc_dropped;
 };
 
 static char *tcl_port;
@@ -44,7 +61,7 @@ static char *tcl_port;
 /* handlers */
 static int tcl_new_connection(struct connection *connection);
 static int tcl_input(struct connection *connection);
-static int tcl_output(struct connection *connection, const void *buf, ssize_t len);
+static int tcl_notify(struct connection *connection, const char *buf, size_t len);
 static int tcl_closed(struct connection *connection);
 
 static int tcl_target_callback_event_handler(struct target *target,
@@ -57,15 +74,15 @@ static int tcl_target_callback_event_handler(struct target *target,
 	tclc = connection->priv;
 
 	if (tclc->tc_notify) {
-		snprintf(buf, sizeof(buf), "type target_event event %s\r\n\x1a", target_event_name(event));
-		tcl_output(connection, buf, strlen(buf));
+		snprintf(buf, sizeof(buf), "type target_event event %s\r\n", target_event_name(event));
+		tcl_notify(connection, buf, strlen(buf));
 	}
 
 	if (tclc->tc_laststate != target->state) {
 		tclc->tc_laststate = target->state;
 		if (tclc->tc_notify) {
-			snprintf(buf, sizeof(buf), "type target_state state %s\r\n\x1a", target_state_name(target));
-			tcl_output(connection, buf, strlen(buf));
+			snprintf(buf, sizeof(buf), "type target_state state %s\r\n", target_state_name(target));
+			tcl_notify(connection, buf, strlen(buf));
 		}
 	}
 
@@ -82,8 +99,8 @@ static int tcl_target_callback_reset_handler(struct target *target,
 	tclc = connection->priv;
 
 	if (tclc->tc_notify) {
-		snprintf(buf, sizeof(buf), "type target_reset mode %s\r\n\x1a", target_reset_mode_name(reset_mode));
-		tcl_output(connection, buf, strlen(buf));
+		snprintf(buf, sizeof(buf), "type target_reset mode %s\r\n", target_reset_mode_name(reset_mode));
+		tcl_notify(connection, buf, strlen(buf));
 	}
 
 	return ERROR_OK;
@@ -95,7 +112,7 @@ static int tcl_target_callback_trace_handler(struct target *target,
 	struct connection *connection = priv;
 	struct tcl_connection *tclc;
 	char *header = "type target_trace data ";
-	char *trailer = "\r\n\x1a";
+	char *trailer = "\r\n";
 	size_t hex_len = len * 2 + 1;
 	size_t max_len = hex_len + strlen(header) + strlen(trailer);
 	char *buf, *hex;
@@ -107,7 +124,7 @@ static int tcl_target_callback_trace_handler(struct target *target,
 		buf = malloc(max_len);
 		hexify(hex, data, len, hex_len);
 		snprintf(buf, max_len, "%s%s%s", header, hex, trailer);
-		tcl_output(connection, buf, strlen(buf));
+		tcl_notify(connection, buf, strlen(buf));
 		free(hex);
 		free(buf);
 	}
@@ -115,28 +132,174 @@ static int tcl_target_callback_trace_handler(struct target *target,
 	return ERROR_OK;
 }
 
-/* write data out to a socket.
- *
- * this is a blocking write, so the return value must equal the length, if
- * that is not the case then flag the connection with an output error.
+static bool tcl_write_would_block(void)
+{
+#ifdef _WIN32
+	int error = WSAGetLastError();
+	return error == WSAEWOULDBLOCK || error == WSAEINTR;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+/* wait until the socket can take more data */
+static bool tcl_wait_writable(struct connection *connection)
+{
+	fd_set write_fds;
+	struct timeval tv;
+
+	FD_ZERO(&write_fds);
+	FD_SET(connection->fd_out, &write_fds);
+	tv.tv_sec = TCL_WRITE_TIMEOUT_MS / 1000;
+	tv.tv_usec = (TCL_WRITE_TIMEOUT_MS % 1000) * 1000;
+
+	return socket_select(connection->fd_out + 1, NULL, &write_fds, NULL, &tv) > 0;
+}
+
+/* Write out as much of the output queue as the socket takes. Notifications
+ * only go out without blocking; with @a wait set, e.g. for the result of a
+ * command the client is waiting for, the queue is drained completely unless
+ * the client stalls for TCL_WRITE_TIMEOUT_MS.
  */
-int tcl_output(struct connection *connection, const void *data, ssize_t len)
+static int tcl_flush(struct connection *connection, bool wait)
 {
-	ssize_t wlen;
-	struct tcl_connection *tclc;
+	struct tcl_connection *tclc = connection->priv;
+
+	if (tclc->tc_outerror)
+		return ERROR_SERVER_REMOTE_CLOSED;
+
+	while (tclc->tc_out_head < tclc->tc_out_len) {
+		int len = MIN(tclc->tc_out_len - tclc->tc_out_head, INT_MAX);
+		int wlen = connection_write(connection, tclc->tc_out + tclc->tc_out_head, len);
+
+		if (wlen > 0) {
+			tclc->tc_out_head += wlen;
+			continue;
+		}
+
+		if (wlen < 0 && tcl_write_would_block()) {
+			if (!wait)
+				return ERROR_OK;
+			if (tcl_wait_writable(connection))
+				continue;
+			LOG_ERROR("tcl client stopped reading, closing connection");
+		} else {
+			LOG_ERROR("error during write: %d != %d", wlen, len);
+		}
+
+		tclc->tc_outerror = 1;
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	tclc->tc_out_head = 0;
+	tclc->tc_out_len = 0;
+	return ERROR_OK;
+}
+
+static int tcl_queue(struct connection *connection, const void *data, size_t len)
+{
+	struct tcl_connection *tclc = connection->priv;
+
+	if (tclc->tc_out_len + len > tclc->tc_out_size && tclc->tc_out_head) {
+		memmove(tclc->tc_out, tclc->tc_out + tclc->tc_out_head,
+				tclc->tc_out_len - tclc->tc_out_head);
+		tclc->tc_out_len -= tclc->tc_out_head;
+		tclc->tc_out_head = 0;
+	}
+
+	if (tclc->tc_out_len + len > tclc->tc_out_size) {
+		size_t size = MAX(tclc->tc_out_size * 2, tclc->tc_out_len + len);
+		uint8_t *out = realloc(tclc->tc_out, size);
+		if (!out) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		tclc->tc_out = out;
+		tclc->tc_out_size = size;
+	}
+
+	memcpy(tclc->tc_out + tclc->tc_out_len, data, len);
+	tclc->tc_out_len += len;
+	return ERROR_OK;
+}
+
+/* queue a message, framed as set with tcl_binary */
+static int tcl_queue_message(struct connection *connection, char type,
+		const void *data, size_t len)
+{
+	struct tcl_connection *tclc = connection->priv;
+	int retval;
+
+	if (tclc->tc_binary) {
+		uint8_t header[TCL_FRAME_HEADER_SIZE];
+		header[0] = type;
+		h_u32_to_be(header + 1, len);
+		retval = tcl_queue(connection, header, sizeof(header));
+		if (retval == ERROR_OK)
+			retval = tcl_queue(connection, data, len);
+	} else {
+		retval = tcl_queue(connection, data, len);
+		if (retval == ERROR_OK)
+			retval = tcl_queue(connection, "\x1a", 1);
+	}
+
+	return retval;
+}
+
+/* send the result of a command, the client is waiting for it */
+static int tcl_output(struct connection *connection, const void *data, size_t len)
+{
+	struct tcl_connection *tclc = connection->priv;
 
-	tclc = connection->priv;
 	if (tclc->tc_outerror)
 		return ERROR_SERVER_REMOTE_CLOSED;
 
-	wlen = connection_write(connection, data, len);
+	int retval = tcl_queue_message(connection, TCL_FRAME_RESULT, data, len);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return tcl_flush(connection, true);
+}
+
+/* Queue a notification. A client which does not keep up loses notifications
+ * instead of stalling the server; it is told how many when there is room
+ * again. */
+static int tcl_notify(struct connection *connection, const char *buf, size_t len)
+{
+	struct tcl_connection *tclc = connection->priv;
 
-	if (wlen == len)
+	if (tclc->tc_outerror)
+		return ERROR_SERVER_REMOTE_CLOSED;
+
+	size_t queued = tclc->tc_out_len - tclc->tc_out_head;
+	if (queued + len + TCL_FRAME_HEADER_SIZE > TCL_NOTIFY_QUEUE_MAX) {
+		tclc->tc_dropped++;
 		return ERROR_OK;
+	}
+
+	if (tclc->tc_dropped) {
+		char msg[64];
+		snprintf(msg, sizeof(msg), "type overflow dropped %u\r\n", tclc->tc_dropped);
+		tclc->tc_dropped = 0;
+		tcl_queue_message(connection, TCL_FRAME_NOTIFY, msg, strlen(msg));
+	}
+
+	int retval = tcl_queue_message(connection, TCL_FRAME_NOTIFY, buf, len);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return tcl_flush(connection, false);
+}
+
+static int tcl_drain_callback(void *priv)
+{
+	struct connection *connection = priv;
+	struct tcl_connection *tclc = connection->priv;
+
+	if (tclc && tclc->tc_out_head < tclc->tc_out_len)
+		tcl_flush(connection, false);
 
-	LOG_ERROR("error during write: %d != %d", (int)wlen, (int)len);
-	tclc->tc_outerror = 1;
-	return ERROR_SERVER_REMOTE_CLOSED;
+	return ERROR_OK;
 }
 
 /* connections */
@@ -157,6 +320,10 @@ static int tcl_new_connection(struct connection *connection)
 
 	connection->priv = tclc;
 
+	/* the output queue is drained without blocking the event loop */
+	if (connection->service->type == CONNECTION_TCP)
+		socket_nonblock(connection->fd);
+
 	struct target *target = get_current_target_or_null(connection->cmd_ctx);
 	if (target != NULL)
 		tclc->tc_laststate = target->state;
@@ -167,6 +334,8 @@ static int tcl_new_connection(struct connection *connection)
 	target_register_event_callback(tcl_target_callback_event_handler, connection);
 	target_register_reset_callback(tcl_target_callback_reset_handler, connection);
 	target_register_trace_callback(tcl_target_callback_trace_handler, connection);
+	target_register_timer_callback(tcl_drain_callback, TCL_DRAIN_PERIOD_MS,
+			TARGET_TIMER_TYPE_PERIODIC, connection);
 
 	return ERROR_OK;
 }
@@ -186,6 +355,8 @@ static int tcl_input(struct connection *connection)
 
 	rlen = connection_read(connection, &in, sizeof(in));
 	if (rlen <= 0) {
+		if (rlen < 0 && tcl_write_would_block())
+			return ERROR_OK;
 		if (rlen < 0)
 			LOG_ERROR("error during read: %s", strerror(errno));
 		return ERROR_SERVER_REMOTE_CLOSED;
@@ -195,6 +366,11 @@ static int tcl_input(struct connection *connection)
 	if (tclc == NULL)
 		return ERROR_CONNECTION_REJECTED;
 
+	/* opportunistically send what is still queued */
+	retval = tcl_flush(connection, false);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* push as much data into the line as possible */
 	for (i = 0; i < rlen; i++) {
 		/* buffer the data */
@@ -235,7 +411,7 @@ static int tcl_input(struct connection *connection)
 		/* process the line */
 		if (tclc->tc_linedrop) {
 #define ESTR "line too long\n"
-			retval = tcl_output(connection, ESTR, sizeof(ESTR));
+			retval = tcl_output(connection, ESTR, sizeof(ESTR) - 1);
 			if (retval != ERROR_OK)
 				return retval;
 #undef ESTR
@@ -243,11 +419,11 @@ static int tcl_input(struct connection *connection)
 			tclc->tc_line[tclc->tc_lineoffset-1] = '\0';
 			command_run_line(connection->cmd_ctx, tclc->tc_line);
 			result = Jim_GetString(Jim_GetResult(interp), &reslen);
+			/* Always terminated with ctrl-z, or framed in binary mode,
+			 * to allow multiline results */
 			retval = tcl_output(connection, result, reslen);
 			if (retval != ERROR_OK)
 				return retval;
-			/* Always output ctrl-z as end of line to allow multiline results */
-			tcl_output(connection, "\x1a", 1);
 		}
 
 		tclc->tc_lineoffset = 0;
@@ -262,9 +438,12 @@ static int tcl_closed(struct connection *connection)
 	struct tcl_connection *tclc;
 	tclc = connection->priv;
 
+	target_unregister_timer_callback(tcl_drain_callback, connection);
+
 	/* cleanup connection context */
 	if (tclc) {
 		free(tclc->tc_line);
+		free(tclc->tc_out);
 		free(tclc);
 		connection->priv = NULL;
 	}
@@ -327,6 +506,69 @@ COMMAND_HANDLER(handle_tcl_trace_command)
 	}
 }
 
+static struct tcl_connection *tcl_current_connection(struct command_invocation *cmd)
+{
+	struct connection *connection = cmd->ctx->output_handler_priv;
+
+	if (connection && !strcmp(connection->service->name, "tcl"))
+		return connection->priv;
+	return NULL;
+}
+
+COMMAND_HANDLER(handle_tcl_binary_command)
+{
+	struct tcl_connection *tclc = tcl_current_connection(CMD);
+
+	if (!tclc) {
+		LOG_ERROR("%s: can only be called from the tcl server", CMD_NAME);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	/* the result of this command already uses the new framing */
+	return CALL_COMMAND_HANDLER(handle_command_parse_bool, &tclc->tc_binary, "Binary framing ");
+}
+
+/* Return target memory as a raw byte string, for clients using binary
+ * framing; the text framing could not carry a 0x1a byte. */
+COMMAND_HANDLER(handle_tcl_read_memory_command)
+{
+	struct tcl_connection *tclc = tcl_current_connection(CMD);
+
+	if (!tclc || !tclc->tc_binary) {
+		LOG_ERROR("%s: needs binary framing on the tcl server", CMD_NAME);
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_addr_t address;
+	uint32_t count;
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], count);
+
+	if (count > TCL_LINE_MAX) {
+		LOG_ERROR("%s: at most %d bytes can be read at once", CMD_NAME, TCL_LINE_MAX);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	uint8_t *buffer = malloc(count);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	struct target *target = get_current_target(CMD_CTX);
+	int retval = target_read_buffer(target, address, count, buffer);
+	if (retval == ERROR_OK) {
+		Jim_Interp *interp = CMD_CTX->interp;
+		Jim_SetResult(interp, Jim_NewStringObj(interp, (char *)buffer, count));
+	}
+
+	free(buffer);
+	return retval;
+}
+
 static const struct command_registration tcl_command_handlers[] = {
 	{
 		.name = "tcl_port",
@@ -351,6 +593,20 @@ static const struct command_registration tcl_command_handlers[] = {
 		.help = "Target trace output",
 		.usage = "[on|off]",
 	},
+	{
+		.name = "tcl_binary",
+		.handler = handle_tcl_binary_command,
+		.mode = COMMAND_EXEC,
+		.help = "Length prefixed framing of results and notifications",
+		.usage = "[on|off]",
+	},
+	{
+		.name = "tcl_read_memory",
+		.handler = handle_tcl_read_memory_command,
+		.mode = COMMAND_EXEC,
+		.help = "Read target memory as raw bytes (binary framing only)",
+		.usage = "address count",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
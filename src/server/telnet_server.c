@@ -32,6 +32,9 @@
 
 static char *telnet_port;
 
+/* all open connections, log messages are forwarded to each of them */
+static struct telnet_connection *telnet_connections;
+
 static char *negotiate =
 	"\xFF\xFB\x03"			/* IAC WILL Suppress Go Ahead */
 	"\xFF\xFB\x01"			/* IAC WILL Echo */
@@ -45,19 +48,50 @@ static char *negotiate =
  * we write to it, we will fail. Subsequent write operations will
  * succeed. Shudder!
  */
-static int telnet_write(struct connection *connection, const void *data,
-	int len)
+static int telnet_flush(struct connection *connection)
 {
 	struct telnet_connection *t_con = connection->priv;
+	size_t size = t_con->out_size;
+
+	t_con->out_size = 0;
 	if (t_con->closed)
 		return ERROR_SERVER_REMOTE_CLOSED;
+	if (!size)
+		return ERROR_OK;
 
-	if (connection_write(connection, data, len) == len)
+	if (connection_write(connection, t_con->out, size) == (int)size)
 		return ERROR_OK;
 	t_con->closed = true;
 	return ERROR_SERVER_REMOTE_CLOSED;
 }
 
+/* Output is buffered, echoes and prompts go out together with the next
+ * flush instead of as one tiny socket write each. */
+static int telnet_write(struct connection *connection, const void *data,
+	int len)
+{
+	struct telnet_connection *t_con = connection->priv;
+	if (t_con->closed)
+		return ERROR_SERVER_REMOTE_CLOSED;
+
+	if (t_con->out_size + len > sizeof(t_con->out)) {
+		int retval = telnet_flush(connection);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if ((size_t)len > sizeof(t_con->out)) {
+		if (connection_write(connection, data, len) == len)
+			return ERROR_OK;
+		t_con->closed = true;
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	memcpy(t_con->out + t_con->out_size, data, len);
+	t_con->out_size += len;
+	return ERROR_OK;
+}
+
 static int telnet_prompt(struct connection *connection)
 {
 	struct telnet_connection *t_con = connection->priv;
@@ -67,6 +101,7 @@ static int telnet_prompt(struct connection *connection)
 
 static int telnet_outputline(struct connection *connection, const char *line)
 {
+	struct telnet_connection *t_con = connection->priv;
 	int len;
 
 	/* process lines in buffer */
@@ -86,6 +121,10 @@ static int telnet_outputline(struct connection *connection, const char *line)
 			line += len;
 	}
 
+	/* while a command runs its output goes out as it comes, like the log */
+	if (!t_con->prompt_visible)
+		return telnet_flush(connection);
+
 	return ERROR_OK;
 }
 
@@ -96,17 +135,41 @@ static int telnet_output(struct command_context *cmd_ctx, const char *line)
 	return telnet_outputline(connection, line);
 }
 
-static void telnet_log_callback(void *priv, const char *file, unsigned line,
-	const char *function, const char *string)
+/* Translate the line endings of a message for the telnet clients. */
+static char *telnet_translate_message(const char *string, size_t *len)
+{
+	size_t lines = 0;
+	for (const char *p = string; *p; p++)
+		if (*p == '\n')
+			lines++;
+
+	char *text = malloc(strlen(string) + lines + 1);
+	if (!text)
+		return NULL;
+
+	char *q = text;
+	for (const char *p = string; *p; p++) {
+		if (*p == '\n')
+			*q++ = '\r';
+		*q++ = *p;
+	}
+	*q = '\0';
+
+	*len = q - text;
+	return text;
+}
+
+static void telnet_log_message(struct connection *connection,
+	const char *text, size_t len)
 {
-	struct connection *connection = priv;
 	struct telnet_connection *t_con = connection->priv;
 	size_t i;
 	size_t tmp;
 
 	/* If the prompt is not visible, simply output the message. */
 	if (!t_con->prompt_visible) {
-		telnet_outputline(connection, string);
+		telnet_write(connection, text, len);
+		telnet_flush(connection);
 		return;
 	}
 
@@ -124,7 +187,7 @@ static void telnet_log_callback(void *priv, const char *file, unsigned line,
 		telnet_write(connection, "\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b\b",
 			MIN(tmp - i, 16));
 
-	telnet_outputline(connection, string);
+	telnet_write(connection, text, len);
 
 	/* Put the command line to its previous state. */
 	telnet_prompt(connection);
@@ -132,6 +195,24 @@ static void telnet_log_callback(void *priv, const char *file, unsigned line,
 
 	for (i = t_con->line_cursor; i < t_con->line_size; i++)
 		telnet_write(connection, "\b", 1);
+
+	telnet_flush(connection);
+}
+
+/* A single log callback serves all connections, so each message is only
+ * translated once however many clients are attached. */
+static void telnet_log_callback(void *priv, const char *file, unsigned line,
+	const char *function, const char *string)
+{
+	size_t len;
+	char *text = telnet_translate_message(string, &len);
+	if (!text)
+		return;
+
+	for (struct telnet_connection *t_con = telnet_connections; t_con; t_con = t_con->next)
+		telnet_log_message(t_con->connection, text, len);
+
+	free(text);
 }
 
 static void telnet_load_history(struct telnet_connection *t_con)
@@ -232,6 +313,8 @@ static int telnet_new_connection(struct connection *connection)
 	telnet_connection->prompt = strdup("> ");
 	telnet_connection->prompt_visible = true;
 	telnet_connection->state = TELNET_STATE_DATA;
+	telnet_connection->out_size = 0;
+	telnet_connection->connection = connection;
 
 	/* output goes through telnet connection */
 	command_set_output_handler(connection->cmd_ctx, telnet_output, connection);
@@ -256,9 +339,12 @@ static int telnet_new_connection(struct connection *connection)
 	telnet_connection->current_history = 0;
 	telnet_load_history(telnet_connection);
 
-	log_add_callback(telnet_log_callback, connection);
+	if (!telnet_connections)
+		log_add_callback(telnet_log_callback, NULL);
+	telnet_connection->next = telnet_connections;
+	telnet_connections = telnet_connection;
 
-	return ERROR_OK;
+	return telnet_flush(connection);
 }
 
 static void telnet_clear_line(struct connection *connection,
@@ -336,7 +422,7 @@ static void telnet_move_cursor(struct connection *connection, size_t pos)
 	tc->line_cursor = pos;
 }
 
-static int telnet_input(struct connection *connection)
+static int telnet_input_inner(struct connection *connection)
 {
 	int bytes_read;
 	unsigned char buffer[TELNET_BUFFER_SIZE];
@@ -458,6 +544,9 @@ static int telnet_input(struct connection *connection)
 							if (strcmp(t_con->line, "shutdown") == 0)
 								telnet_save_history(t_con);
 
+							/* show the echo before a long running command */
+							telnet_flush(connection);
+
 							retval = command_run_line(command_context, t_con->line);
 
 							t_con->line_cursor = 0;
@@ -620,12 +709,30 @@ static int telnet_input(struct connection *connection)
 	return ERROR_OK;
 }
 
+static int telnet_input(struct connection *connection)
+{
+	int retval = telnet_input_inner(connection);
+
+	/* everything produced while handling this input goes out at once */
+	int flush_retval = telnet_flush(connection);
+	if (retval != ERROR_OK)
+		return retval;
+	return flush_retval;
+}
+
 static int telnet_connection_closed(struct connection *connection)
 {
 	struct telnet_connection *t_con = connection->priv;
 	int i;
 
-	log_remove_callback(telnet_log_callback, connection);
+	for (struct telnet_connection **p = &telnet_connections; *p; p = &(*p)->next) {
+		if (*p == t_con) {
+			*p = t_con->next;
+			break;
+		}
+	}
+	if (!telnet_connections)
+		log_remove_callback(telnet_log_callback, NULL);
 
 	if (t_con->prompt) {
 		free(t_con->prompt);
@@ -28,6 +28,7 @@
 #include <server/server.h>
 
 #define TELNET_BUFFER_SIZE (10*1024)
+#define TELNET_OUTPUT_BUFFER_SIZE (16*1024)
 
 #define TELNET_LINE_HISTORY_SIZE (128)
 #define TELNET_LINE_MAX_SIZE (10*256)
@@ -56,6 +57,11 @@ struct telnet_connection {
 	size_t next_history;
 	size_t current_history;
 	bool closed;
+	/* output is collected here and written with one call per event */
+	char out[TELNET_OUTPUT_BUFFER_SIZE];
+	size_t out_size;
+	struct connection *connection;
+	struct telnet_connection *next;
 };
 
 struct telnet_service {
@@ -292,6 +292,67 @@ static int aarch64_check_state_one(struct target *target,
 	return ERROR_OK;
 }
 
+/*
+ * Runs the debug register accesses queued for the PEs of an SMP group,
+ * flushing each DAP once.
+ */
+static int aarch64_dap_run_smp(struct target *target)
+{
+	struct target_list *head, *prev;
+	int retval = ERROR_OK;
+
+	foreach_smp_target(head, target->head) {
+		struct target *curr = head->target;
+		if (!target_was_examined(curr))
+			continue;
+
+		struct adiv5_dap *dap = target_to_armv8(curr)->debug_ap->dap;
+		bool flushed = false;
+		foreach_smp_target(prev, target->head) {
+			if (prev == head)
+				break;
+			if (target_was_examined(prev->target)
+					&& target_to_armv8(prev->target)->debug_ap->dap == dap) {
+				flushed = true;
+				break;
+			}
+		}
+		if (flushed)
+			continue;
+
+		int r = dap_run(dap);
+		if (retval == ERROR_OK)
+			retval = r;
+	}
+
+	return retval;
+}
+
+/*
+ * Samples PRSR of every examined PE of the SMP group into its
+ * aarch64_common, with one queue flush rather than one round trip per PE.
+ */
+static int aarch64_sample_prsr_smp(struct target *target)
+{
+	struct target_list *head;
+	int retval;
+
+	foreach_smp_target(head, target->head) {
+		struct target *curr = head->target;
+		if (!target_was_examined(curr))
+			continue;
+
+		struct armv8_common *armv8 = target_to_armv8(curr);
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_PRSR,
+				&target_to_aarch64(curr)->prsr);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return aarch64_dap_run_smp(target);
+}
+
 static int aarch64_wait_halt_one(struct target *target)
 {
 	int retval = ERROR_OK;
@@ -414,16 +475,15 @@ static int aarch64_halt_smp(struct target *target, bool exc_target)
 		struct target_list *head;
 		struct target *curr;
 
-		foreach_smp_target(head, target->head) {
-			int halted;
+		retval = aarch64_sample_prsr_smp(target);
 
+		foreach_smp_target(head, target->head) {
 			curr = head->target;
 
 			if (!target_was_examined(curr))
 				continue;
 
-			retval = aarch64_check_state_one(curr, PRSR_HALT, PRSR_HALT, &halted, NULL);
-			if (retval != ERROR_OK || !halted) {
+			if (retval != ERROR_OK || !(target_to_aarch64(curr)->prsr & PRSR_HALT)) {
 				all_halted = false;
 				break;
 			}
@@ -784,9 +844,10 @@ static int aarch64_step_restart_smp(struct target *target)
 		struct target *curr = target;
 		bool all_resumed = true;
 
+		retval = aarch64_sample_prsr_smp(target);
+
 		foreach_smp_target(head, target->head) {
 			uint32_t prsr;
-			int resumed;
 
 			curr = head->target;
 
@@ -796,9 +857,12 @@ static int aarch64_step_restart_smp(struct target *target)
 			if (!target_was_examined(curr))
 				continue;
 
-			retval = aarch64_check_state_one(curr,
-					PRSR_SDR, PRSR_SDR, &resumed, &prsr);
-			if (retval != ERROR_OK || (!resumed && (prsr & PRSR_HALT))) {
+			/* PRSR.SDR clears on read, so don't look at PEs twice */
+			if (curr->state == TARGET_RUNNING)
+				continue;
+
+			prsr = target_to_aarch64(curr)->prsr;
+			if (retval != ERROR_OK || (!(prsr & PRSR_SDR) && (prsr & PRSR_HALT))) {
 				all_resumed = false;
 				break;
 			}
@@ -1787,11 +1851,28 @@ static int aarch64_write_cpu_memory_fast(struct target *target,
 		return retval;
 
 
-	/* Step 2.a   - Do the write */
-	retval = mem_ap_write_buf_noincr(armv8->debug_ap,
-					buffer, 4, count, armv8->debug_base + CPUV8_DBG_DTRRX);
-	if (retval != ERROR_OK)
-		return retval;
+	/* Step 2.a   - Do the write, in batches so that the sticky error
+	 * flag is checked once per batch rather than only at the end */
+	while (count > 0) {
+		uint32_t batch = MIN(count, AARCH64_DCC_BATCH_WORDS);
+
+		retval = mem_ap_write_buf_noincr(armv8->debug_ap,
+				buffer, 4, batch, armv8->debug_base + CPUV8_DBG_DTRRX);
+		if (retval != ERROR_OK)
+			return retval;
+
+		buffer += batch * 4;
+		count -= batch;
+		if (!count)
+			break;
+
+		retval = mem_ap_read_atomic_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DSCR, dscr);
+		if (retval != ERROR_OK)
+			return retval;
+		if (*dscr & (DSCR_ERR | DSCR_SYS_ERROR_PEND))
+			break;
+	}
 
 	/* Step 3.a   - Switch DTR mode back to Normal mode */
 	*dscr &= ~DSCR_MA;
@@ -1902,7 +1983,7 @@ static int aarch64_read_cpu_memory_slow(struct target *target,
 
 	/* change DCC to normal mode (if necessary) */
 	if (*dscr & DSCR_MA) {
-		*dscr &= DSCR_MA;
+		*dscr &= ~DSCR_MA;
 		retval =  mem_ap_write_atomic_u32(armv8->debug_ap,
 				armv8->debug_base + CPUV8_DBG_DSCR, *dscr);
 		if (retval != ERROR_OK)
@@ -1992,13 +2073,31 @@ static int aarch64_read_cpu_memory_fast(struct target *target,
 	 * This data is read in aligned to 32 bit boundary.
 	 */
 
-	if (count) {
-		/* Step 2.a - Loop n-1 times, each read of DBGDTRTX reads the data from [X0] and
-		 * increments X0 by 4. */
-		retval = mem_ap_read_buf_noincr(armv8->debug_ap, buffer, 4, count,
-									armv8->debug_base + CPUV8_DBG_DTRTX);
+	/* Step 2.a - Loop n-1 times, each read of DBGDTRTX reads the data from [X0] and
+	 * increments X0 by 4. The sticky error flag is checked once per batch. */
+	while (count) {
+		uint32_t batch = MIN(count, AARCH64_DCC_BATCH_WORDS);
+
+		retval = mem_ap_read_buf_noincr(armv8->debug_ap, buffer, 4, batch,
+				armv8->debug_base + CPUV8_DBG_DTRTX);
+		if (retval != ERROR_OK)
+			return retval;
+
+		buffer += batch * 4;
+		count -= batch;
+		if (!count)
+			break;
+
+		retval = mem_ap_read_atomic_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DSCR, dscr);
 		if (retval != ERROR_OK)
 			return retval;
+		if (*dscr & (DSCR_ERR | DSCR_SYS_ERROR_PEND)) {
+			/* leave memory mode, the caller reports the error */
+			*dscr &= ~DSCR_MA;
+			return mem_ap_write_atomic_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DSCR, *dscr);
+		}
 	}
 
 	/* Step 3.a - set DTR access mode back to Normal mode	*/
@@ -2014,7 +2113,7 @@ static int aarch64_read_cpu_memory_fast(struct target *target,
 	if (retval != ERROR_OK)
 		return retval;
 
-	target_buffer_set_u32(target, buffer + count * 4, value);
+	target_buffer_set_u32(target, buffer, value);
 	return retval;
 }
 
@@ -2109,12 +2208,41 @@ static int aarch64_read_cpu_memory(struct target *target,
 	return ERROR_OK;
 }
 
+/*
+ * Physical memory can be accessed directly through a system bus MEM-AP,
+ * which runs at full DAP speed, as long as the data cache is off so the
+ * bus sees the same data as the core. The MEM-AP only has a 32-bit
+ * address space.
+ */
+static bool aarch64_use_memory_ap(struct target *target, int phys_access,
+	target_addr_t address, uint32_t length)
+{
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+	struct armv8_common *armv8 = target_to_armv8(target);
+
+	if (aarch64->memory_ap_mode != AARCH64_MEMORY_AP_AUTO || !armv8->memory_ap)
+		return false;
+	if (target->state != TARGET_HALTED)
+		return false;
+	if (armv8->armv8_mmu.armv8_cache.d_u_cache_enabled)
+		return false;
+	if (address + length > 0x100000000ULL)
+		return false;
+
+	/* virtual addresses are only physical ones with the MMU off */
+	return phys_access || !armv8->armv8_mmu.mmu_enabled;
+}
+
 static int aarch64_read_phys_memory(struct target *target,
 	target_addr_t address, uint32_t size,
 	uint32_t count, uint8_t *buffer)
 {
 	int retval = ERROR_COMMAND_SYNTAX_ERROR;
 
+	if (count && buffer && aarch64_use_memory_ap(target, 1, address, size * count))
+		return mem_ap_read_buf(target_to_armv8(target)->memory_ap,
+				buffer, size, count, address);
+
 	if (count && buffer) {
 		/* read memory through APB-AP */
 		retval = aarch64_mmu_modify(target, 0);
@@ -2131,6 +2259,10 @@ static int aarch64_read_memory(struct target *target, target_addr_t address,
 	int mmu_enabled = 0;
 	int retval;
 
+	if (aarch64_use_memory_ap(target, 0, address, size * count))
+		return mem_ap_read_buf(target_to_armv8(target)->memory_ap,
+				buffer, size, count, address);
+
 	/* determine if MMU was enabled on target stop */
 	retval = aarch64_mmu(target, &mmu_enabled);
 	if (retval != ERROR_OK)
@@ -2151,6 +2283,10 @@ static int aarch64_write_phys_memory(struct target *target,
 {
 	int retval = ERROR_COMMAND_SYNTAX_ERROR;
 
+	if (count && buffer && aarch64_use_memory_ap(target, 1, address, size * count))
+		return mem_ap_write_buf(target_to_armv8(target)->memory_ap,
+				buffer, size, count, address);
+
 	if (count && buffer) {
 		/* write memory through APB-AP */
 		retval = aarch64_mmu_modify(target, 0);
@@ -2168,6 +2304,10 @@ static int aarch64_write_memory(struct target *target, target_addr_t address,
 	int mmu_enabled = 0;
 	int retval;
 
+	if (aarch64_use_memory_ap(target, 0, address, size * count))
+		return mem_ap_write_buf(target_to_armv8(target)->memory_ap,
+				buffer, size, count, address);
+
 	/* determine if MMU was enabled on target stop */
 	retval = aarch64_mmu(target, &mmu_enabled);
 	if (retval != ERROR_OK)
@@ -2242,6 +2382,20 @@ static int aarch64_examine_first(struct target *target)
 
 	armv8->debug_ap->memaccess_tck = 10;
 
+	/* A system bus MEM-AP is optional, it only speeds up memory access */
+	armv8->memory_ap = NULL;
+	if (dap_find_ap(swjdp, AP_TYPE_AXI_AP, &armv8->memory_ap) != ERROR_OK
+			&& dap_find_ap(swjdp, AP_TYPE_AHB3_AP, &armv8->memory_ap) != ERROR_OK
+			&& dap_find_ap(swjdp, AP_TYPE_AHB5_AP, &armv8->memory_ap) != ERROR_OK)
+		armv8->memory_ap = NULL;
+	if (armv8->memory_ap && mem_ap_init(armv8->memory_ap) != ERROR_OK) {
+		LOG_WARNING("Could not initialize the system bus MEM-AP");
+		armv8->memory_ap = NULL;
+	}
+	if (armv8->memory_ap)
+		LOG_DEBUG("%s: using AP #%" PRIu8 " for direct memory access",
+				target_name(target), armv8->memory_ap->ap_num);
+
 	if (!target->dbgbase_set) {
 		uint32_t dbgbase;
 		/* Get ROM Table base */
@@ -2386,6 +2540,8 @@ static int aarch64_init_arch_info(struct target *target,
 	armv8->pre_restore_context = NULL;
 	armv8->armv8_mmu.read_physical_memory = aarch64_read_phys_memory;
 
+	aarch64->memory_ap_mode = AARCH64_MEMORY_AP_OFF;
+
 	armv8_init_arch_info(target, armv8);
 	target_register_timer_callback(aarch64_handle_target_request, 1,
 		TARGET_TIMER_TYPE_PERIODIC, target);
@@ -2578,6 +2734,34 @@ COMMAND_HANDLER(aarch64_mask_interrupts_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(aarch64_memory_ap_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+
+	static const Jim_Nvp nvp_memory_ap_modes[] = {
+		{ .name = "off", .value = AARCH64_MEMORY_AP_OFF },
+		{ .name = "auto", .value = AARCH64_MEMORY_AP_AUTO },
+		{ .name = NULL, .value = -1 },
+	};
+	const Jim_Nvp *n;
+
+	if (CMD_ARGC > 0) {
+		n = Jim_Nvp_name2value_simple(nvp_memory_ap_modes, CMD_ARGV[0]);
+		if (n->name == NULL) {
+			LOG_ERROR("Unknown parameter: %s - should be auto or off", CMD_ARGV[0]);
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		}
+
+		aarch64->memory_ap_mode = n->value;
+	}
+
+	n = Jim_Nvp_value2name_simple(nvp_memory_ap_modes, aarch64->memory_ap_mode);
+	command_print(CMD, "aarch64 memory access through the system bus %s", n->name);
+
+	return ERROR_OK;
+}
+
 static int jim_mcrmrc(Jim_Interp *interp, int argc, Jim_Obj * const *argv)
 {
 	struct command_context *context;
@@ -2737,6 +2921,14 @@ static const struct command_registration aarch64_exec_command_handlers[] = {
 		.help = "mask aarch64 interrupts during single-step",
 		.usage = "['on'|'off']",
 	},
+	{
+		.name = "memory_ap",
+		.handler = aarch64_memory_ap_command,
+		.mode = COMMAND_ANY,
+		.help = "access memory through the system bus MEM-AP "
+			"while the data cache is off",
+		.usage = "['auto'|'off']",
+	},
 	{
 		.name = "mcr",
 		.mode = COMMAND_EXEC,
@@ -41,6 +41,14 @@ enum aarch64_isrmasking_mode {
 	AARCH64_ISRMASK_ON,
 };
 
+enum aarch64_memory_ap_mode {
+	AARCH64_MEMORY_AP_OFF,
+	AARCH64_MEMORY_AP_AUTO,
+};
+
+/* words moved through the DCC between two checks of the sticky errors */
+#define AARCH64_DCC_BATCH_WORDS 4096
+
 struct aarch64_brp {
 	int used;
 	int type;
@@ -65,6 +73,10 @@ struct aarch64_common {
 	struct armv8_common armv8_common;
 
 	enum aarch64_isrmasking_mode isrmasking_mode;
+	enum aarch64_memory_ap_mode memory_ap_mode;
+
+	/* PRSR as last sampled by aarch64_sample_prsr_smp() */
+	uint32_t prsr;
 };
 
 static inline struct aarch64_common *
@@ -205,6 +205,9 @@ struct arm {
 	/** Retrieve a single core register. */
 	int (*read_core_reg)(struct target *target, struct reg *reg,
 			int num, enum arm_mode mode);
+	/** Retrieve several registers of the core cache at once (optional). */
+	int (*read_core_regs)(struct target *target, struct reg **reg_list,
+			unsigned num_regs);
 	int (*write_core_reg)(struct target *target, struct reg *reg,
 			int num, enum arm_mode mode, uint8_t *value);
 
@@ -1817,6 +1817,11 @@ COMMAND_HANDLER(dap_apreg_command)
 	} else {
 		retval = dap_queue_ap_read(ap, reg, &value);
 	}
+
+	/* a raw DRW access moves TAR behind the cache's back */
+	if (reg == MEM_AP_REG_DRW)
+		ap->tar_valid = false;
+
 	if (retval == ERROR_OK)
 		retval = dap_run(dap);
 
@@ -652,10 +652,10 @@ static enum arm_mode dpm_mapmode(struct arm *arm,
  * of registers.
  */
 
-static int arm_dpm_read_core_reg(struct target *target, struct reg *r,
+/* Read one core register, the DPM being prepared already. */
+static int arm_dpm_read_core_reg_prepared(struct arm_dpm *dpm, struct reg *r,
 	int regnum, enum arm_mode mode)
 {
-	struct arm_dpm *dpm = target_to_arm(target)->dpm;
 	int retval;
 
 	if (regnum < 0 || (regnum > 16 && regnum < ARM_VFP_V3_D0) ||
@@ -672,25 +672,55 @@ static int arm_dpm_read_core_reg(struct target *target, struct reg *r,
 	 * which has no such register?
 	 */
 
-	retval = dpm->prepare(dpm);
-	if (retval != ERROR_OK)
-		return retval;
-
 	if (mode != ARM_MODE_ANY) {
 		retval = arm_dpm_modeswitch(dpm, mode);
 		if (retval != ERROR_OK)
-			goto fail;
+			return retval;
 	}
 
 	retval = arm_dpm_read_reg(dpm, r, regnum);
-	if (retval != ERROR_OK)
-		goto fail;
-	/* always clean up, regardless of error */
 
+	/* always clean up, regardless of error */
 	if (mode != ARM_MODE_ANY)
 		/* (void) */ arm_dpm_modeswitch(dpm, ARM_MODE_ANY);
 
-fail:
+	return retval;
+}
+
+static int arm_dpm_read_core_reg(struct target *target, struct reg *r,
+	int regnum, enum arm_mode mode)
+{
+	struct arm_dpm *dpm = target_to_arm(target)->dpm;
+	int retval;
+
+	retval = dpm->prepare(dpm);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = arm_dpm_read_core_reg_prepared(dpm, r, regnum, mode);
+
+	/* (void) */ dpm->finish(dpm);
+	return retval;
+}
+
+/* Read several core registers within a single prepare/finish sequence. */
+static int arm_dpm_read_core_regs(struct target *target, struct reg **reg_list,
+	unsigned num_regs)
+{
+	struct arm_dpm *dpm = target_to_arm(target)->dpm;
+	int retval;
+
+	retval = dpm->prepare(dpm);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned i = 0; i < num_regs && retval == ERROR_OK; i++) {
+		struct arm_reg *arm_reg = reg_list[i]->arch_info;
+
+		retval = arm_dpm_read_core_reg_prepared(dpm, reg_list[i],
+				arm_reg->num, arm_reg->mode);
+	}
+
 	/* (void) */ dpm->finish(dpm);
 	return retval;
 }
@@ -1070,6 +1100,7 @@ int arm_dpm_setup(struct arm_dpm *dpm)
 	/* register access setup */
 	arm->full_context = arm_dpm_full_context;
 	arm->read_core_reg = arm_dpm_read_core_reg;
+	arm->read_core_regs = arm_dpm_read_core_regs;
 	arm->write_core_reg = arm_dpm_write_core_reg;
 
 	if (arm->core_cache == NULL) {
@@ -87,6 +87,14 @@ struct arm_dpm {
 	int (*instr_write_data_r0_64)(struct arm_dpm *,
 			uint32_t opcode, uint64_t data);
 
+	/**
+	 * Optional. Runs one instruction @a count times, with R0 holding
+	 * @a data, then @a data + @a step and so on, queueing the whole
+	 * sequence instead of waiting for each instruction to complete.
+	 */
+	int (*instr_write_data_r0_range)(struct arm_dpm *,
+			uint32_t opcode, uint32_t data, uint32_t step, uint32_t count);
+
 	/** Optional core-specific operation invoked after CPSR writes. */
 	int (*instr_cpsr_sync)(struct arm_dpm *dpm);
 
@@ -580,6 +580,35 @@ static int armv4_5_get_core_reg(struct reg *reg)
 	return retval;
 }
 
+static int armv4_5_get_core_regs(struct reg **reg_list, unsigned num_regs)
+{
+	int retval = ERROR_OK;
+	struct arm_reg *reg_arch_info = reg_list[0]->arch_info;
+	struct target *target = reg_arch_info->target;
+	struct arm *arm = reg_arch_info->arm;
+
+	if (target->state != TARGET_HALTED) {
+		LOG_ERROR("Target not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	if (!arm->read_core_regs) {
+		for (unsigned i = 0; i < num_regs && retval == ERROR_OK; i++)
+			retval = armv4_5_get_core_reg(reg_list[i]);
+		return retval;
+	}
+
+	retval = arm->read_core_regs(target, reg_list, num_regs);
+	if (retval == ERROR_OK) {
+		for (unsigned i = 0; i < num_regs; i++) {
+			reg_list[i]->valid = true;
+			reg_list[i]->dirty = false;
+		}
+	}
+
+	return retval;
+}
+
 static int armv4_5_set_core_reg(struct reg *reg, uint8_t *buf)
 {
 	struct arm_reg *reg_arch_info = reg->arch_info;
@@ -629,6 +658,7 @@ static int armv4_5_set_core_reg(struct reg *reg, uint8_t *buf)
 static const struct reg_arch_type arm_reg_type = {
 	.get = armv4_5_get_core_reg,
 	.set = armv4_5_set_core_reg,
+	.get_multiple = armv4_5_get_core_regs,
 };
 
 struct reg_cache *arm_build_reg_cache(struct target *target, struct arm *arm)
@@ -638,7 +668,7 @@ struct reg_cache *arm_build_reg_cache(struct target *target, struct arm *arm)
 	if (arm->arm_vfp_version == ARM_VFP_V3)
 		num_regs += ARRAY_SIZE(arm_vfp_v3_regs);
 
-	struct reg_cache *cache = malloc(sizeof(struct reg_cache));
+	struct reg_cache *cache = calloc(1, sizeof(struct reg_cache));
 	struct reg *reg_list = calloc(num_regs, sizeof(struct reg));
 	struct arm_reg *reg_arch_info = calloc(num_regs, sizeof(struct arm_reg));
 	int i;
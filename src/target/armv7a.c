@@ -286,6 +286,11 @@ int armv7a_handle_cache_info_command(struct command_invocation *cmd,
 		command_print(cmd, "Outer unified cache Base Address 0x%" PRIx32 ", %" PRId32 " ways",
 			l2x_cache->base, l2x_cache->way);
 
+	command_print(cmd, "Maintenance: %lu line operations in %lu queue flushes"
+			", %lu ranges done on the whole cache",
+			armv7a_cache->maint_lines, armv7a_cache->maint_flushes,
+			armv7a_cache->maint_full);
+
 	return ERROR_OK;
 }
 
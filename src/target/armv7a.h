@@ -78,6 +78,10 @@ struct armv7a_cache_common {
 	int d_u_cache_enabled;
 	int auto_cache_enabled;			/* openocd automatic
 						 * cache handling */
+	/* cache maintenance counters */
+	unsigned long maint_lines;		/* line operations issued */
+	unsigned long maint_flushes;		/* debug queue flushes */
+	unsigned long maint_full;		/* ranges done as full clean */
 	/* outer unified cache if some */
 	void *outer_cache;
 	int (*flush_all_data_cache)(struct target *target);
@@ -106,6 +110,8 @@ struct armv7a_common {
 	struct arm_dpm dpm;
 	uint32_t debug_base;
 	struct adiv5_ap *debug_ap;
+	/* system bus MEM-AP, if any, for direct memory access */
+	struct adiv5_ap *memory_ap;
 	/* mdir */
 	uint8_t multi_processor_system;
 	uint8_t multi_threading_processor;
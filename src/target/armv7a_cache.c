@@ -63,33 +63,85 @@ static int armv7a_l1_i_cache_sanity_check(struct target *target)
 	return ERROR_OK;
 }
 
-static int armv7a_l1_d_cache_flush_level(struct arm_dpm *dpm, struct armv7a_cachesize *size, int cl)
+/*
+ * Runs a cache maintenance opcode on count lines, R0 holding data, then
+ * data + step and so on. Cores that can queue the whole sequence do it in
+ * a few debug queue flushes, the others one line at a time.
+ */
+static int armv7a_cache_op_range(struct target *target, uint32_t opcode,
+	uint32_t data, uint32_t step, uint32_t count)
 {
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	struct armv7a_cache_common *cache = &armv7a->armv7a_mmu.armv7a_cache;
+	struct arm_dpm *dpm = armv7a->arm.dpm;
 	int retval = ERROR_OK;
-	int32_t c_way, c_index = size->index;
+
+	cache->maint_lines += count;
+
+	if (dpm->instr_write_data_r0_range)
+		return dpm->instr_write_data_r0_range(dpm, opcode, data, step, count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		if ((i & 0x3f) == 0)
+			keep_alive();
+		retval = dpm->instr_write_data_r0(dpm, opcode, data);
+		if (retval != ERROR_OK)
+			break;
+		cache->maint_flushes++;
+		data += step;
+	}
+
+	return retval;
+}
+
+/*
+ * Number of set/way operations needed to clean the whole data cache. A
+ * range covering more lines than this is cheaper to handle as a full
+ * clean.
+ */
+static uint32_t armv7a_l1_d_cache_setway_ops(struct armv7a_cache_common *cache)
+{
+	uint32_t ops = 0;
+
+	for (int cl = 0; cl < cache->loc; cl++) {
+		if (cache->arch[cl].ctype < CACHE_LEVEL_HAS_D_CACHE)
+			continue;
+		ops += (cache->arch[cl].d_u_size.index + 1)
+			* (cache->arch[cl].d_u_size.way + 1);
+	}
+
+	return ops;
+}
+
+static uint32_t armv7a_cache_range_lines(uint32_t virt, uint32_t size,
+	uint32_t linelen)
+{
+	uint32_t va_line = virt & (-linelen);
+
+	return DIV_ROUND_UP(virt + size - va_line, linelen);
+}
+
+static int armv7a_l1_d_cache_flush_level(struct target *target, struct armv7a_cachesize *size, int cl)
+{
+	int retval = ERROR_OK;
+	int32_t c_way;
+	uint32_t c_index = size->index;
 
 	LOG_DEBUG("cl %" PRId32, cl);
-	do {
-		keep_alive();
-		c_way = size->way;
-		do {
-			uint32_t value = (c_index << size->index_shift)
-				| (c_way << size->way_shift) | (cl << 1);
-			/*
-			 * DCCISW - Clean and invalidate data cache
-			 * line by Set/Way.
-			 */
-			retval = dpm->instr_write_data_r0(dpm,
-					ARMV4_5_MCR(15, 0, 0, 7, 14, 2),
-					value);
-			if (retval != ERROR_OK)
-				goto done;
-			c_way -= 1;
-		} while (c_way >= 0);
-		c_index -= 1;
-	} while (c_index >= 0);
-
- done:
+	for (c_way = size->way; c_way >= 0; c_way--) {
+		uint32_t value = (c_index << size->index_shift)
+			| (c_way << size->way_shift) | (cl << 1);
+		/*
+		 * DCCISW - Clean and invalidate data cache
+		 * line by Set/Way, walking down all the sets of a way.
+		 */
+		retval = armv7a_cache_op_range(target,
+				ARMV4_5_MCR(15, 0, 0, 7, 14, 2),
+				value, -(1U << size->index_shift), c_index + 1);
+		if (retval != ERROR_OK)
+			break;
+	}
+
 	keep_alive();
 	return retval;
 }
@@ -115,7 +167,9 @@ static int armv7a_l1_d_cache_clean_inval_all(struct target *target)
 		if (cache->arch[cl].ctype < CACHE_LEVEL_HAS_D_CACHE)
 			continue;
 
-		armv7a_l1_d_cache_flush_level(dpm, &cache->arch[cl].d_u_size, cl);
+		retval = armv7a_l1_d_cache_flush_level(target, &cache->arch[cl].d_u_size, cl);
+		if (retval != ERROR_OK)
+			goto done;
 	}
 
 	retval = dpm->finish(dpm);
@@ -128,13 +182,10 @@ done:
 	return retval;
 }
 
-int armv7a_cache_auto_flush_all_data(struct target *target)
+/* set/way operations are local to a core, so do all the halted ones */
+static int armv7a_l1_d_cache_clean_inval_all_smp(struct target *target)
 {
 	int retval = ERROR_FAIL;
-	struct armv7a_common *armv7a = target_to_armv7a(target);
-
-	if (!armv7a->armv7a_mmu.armv7a_cache.auto_cache_enabled)
-		return ERROR_OK;
 
 	if (target->smp) {
 		struct target_list *head;
@@ -150,6 +201,17 @@ int armv7a_cache_auto_flush_all_data(struct target *target)
 	} else
 		retval = armv7a_l1_d_cache_clean_inval_all(target);
 
+	return retval;
+}
+
+int armv7a_cache_auto_flush_all_data(struct target *target)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+
+	if (!armv7a->armv7a_mmu.armv7a_cache.auto_cache_enabled)
+		return ERROR_OK;
+
+	int retval = armv7a_l1_d_cache_clean_inval_all_smp(target);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -166,7 +228,7 @@ int armv7a_l1_d_cache_inval_virt(struct target *target, uint32_t virt,
 	struct armv7a_cache_common *armv7a_cache = &armv7a->armv7a_mmu.armv7a_cache;
 	uint32_t linelen = armv7a_cache->dminline;
 	uint32_t va_line, va_end;
-	int retval, i = 0;
+	int retval;
 
 	retval = armv7a_l1_d_cache_sanity_check(target);
 	if (retval != ERROR_OK)
@@ -182,8 +244,8 @@ int armv7a_l1_d_cache_inval_virt(struct target *target, uint32_t virt,
 	/* handle unaligned start */
 	if (virt != va_line) {
 		/* DCCIMVAC */
-		retval = dpm->instr_write_data_r0(dpm,
-				ARMV4_5_MCR(15, 0, 0, 7, 14, 1), va_line);
+		retval = armv7a_cache_op_range(target,
+				ARMV4_5_MCR(15, 0, 0, 7, 14, 1), va_line, 0, 1);
 		if (retval != ERROR_OK)
 			goto done;
 		va_line += linelen;
@@ -193,21 +255,19 @@ int armv7a_l1_d_cache_inval_virt(struct target *target, uint32_t virt,
 	if ((va_end & (linelen-1)) != 0) {
 		va_end &= (-linelen);
 		/* DCCIMVAC */
-		retval = dpm->instr_write_data_r0(dpm,
-				ARMV4_5_MCR(15, 0, 0, 7, 14, 1), va_end);
+		retval = armv7a_cache_op_range(target,
+				ARMV4_5_MCR(15, 0, 0, 7, 14, 1), va_end, 0, 1);
 		if (retval != ERROR_OK)
 			goto done;
 	}
 
-	while (va_line < va_end) {
-		if ((i++ & 0x3f) == 0)
-			keep_alive();
+	if (va_line < va_end) {
 		/* DCIMVAC - Invalidate data cache line by VA to PoC. */
-		retval = dpm->instr_write_data_r0(dpm,
-				ARMV4_5_MCR(15, 0, 0, 7, 6, 1), va_line);
+		retval = armv7a_cache_op_range(target,
+				ARMV4_5_MCR(15, 0, 0, 7, 6, 1), va_line, linelen,
+				(va_end - va_line) / linelen);
 		if (retval != ERROR_OK)
 			goto done;
-		va_line += linelen;
 	}
 
 	keep_alive();
@@ -229,30 +289,28 @@ int armv7a_l1_d_cache_clean_virt(struct target *target, uint32_t virt,
 	struct arm_dpm *dpm = armv7a->arm.dpm;
 	struct armv7a_cache_common *armv7a_cache = &armv7a->armv7a_mmu.armv7a_cache;
 	uint32_t linelen = armv7a_cache->dminline;
-	uint32_t va_line, va_end;
-	int retval, i = 0;
+	uint32_t lines;
+	int retval;
 
 	retval = armv7a_l1_d_cache_sanity_check(target);
 	if (retval != ERROR_OK)
 		return retval;
 
+	lines = armv7a_cache_range_lines(virt, size, linelen);
+	if (lines > armv7a_l1_d_cache_setway_ops(armv7a_cache)) {
+		armv7a_cache->maint_full++;
+		return armv7a_l1_d_cache_clean_inval_all_smp(target);
+	}
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		goto done;
 
-	va_line = virt & (-linelen);
-	va_end = virt + size;
-
-	while (va_line < va_end) {
-		if ((i++ & 0x3f) == 0)
-			keep_alive();
-		/* DCCMVAC - Data Cache Clean by MVA to PoC */
-		retval = dpm->instr_write_data_r0(dpm,
-				ARMV4_5_MCR(15, 0, 0, 7, 10, 1), va_line);
-		if (retval != ERROR_OK)
-			goto done;
-		va_line += linelen;
-	}
+	/* DCCMVAC - Data Cache Clean by MVA to PoC */
+	retval = armv7a_cache_op_range(target, ARMV4_5_MCR(15, 0, 0, 7, 10, 1),
+			virt & (-linelen), linelen, lines);
+	if (retval != ERROR_OK)
+		goto done;
 
 	keep_alive();
 	dpm->finish(dpm);
@@ -273,30 +331,28 @@ int armv7a_l1_d_cache_flush_virt(struct target *target, uint32_t virt,
 	struct arm_dpm *dpm = armv7a->arm.dpm;
 	struct armv7a_cache_common *armv7a_cache = &armv7a->armv7a_mmu.armv7a_cache;
 	uint32_t linelen = armv7a_cache->dminline;
-	uint32_t va_line, va_end;
-	int retval, i = 0;
+	uint32_t lines;
+	int retval;
 
 	retval = armv7a_l1_d_cache_sanity_check(target);
 	if (retval != ERROR_OK)
 		return retval;
 
+	lines = armv7a_cache_range_lines(virt, size, linelen);
+	if (lines > armv7a_l1_d_cache_setway_ops(armv7a_cache)) {
+		armv7a_cache->maint_full++;
+		return armv7a_l1_d_cache_clean_inval_all_smp(target);
+	}
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		goto done;
 
-	va_line = virt & (-linelen);
-	va_end = virt + size;
-
-	while (va_line < va_end) {
-		if ((i++ & 0x3f) == 0)
-			keep_alive();
-		/* DCCIMVAC */
-		retval = dpm->instr_write_data_r0(dpm,
-				ARMV4_5_MCR(15, 0, 0, 7, 14, 1), va_line);
-		if (retval != ERROR_OK)
-			goto done;
-		va_line += linelen;
-	}
+	/* DCCIMVAC */
+	retval = armv7a_cache_op_range(target, ARMV4_5_MCR(15, 0, 0, 7, 14, 1),
+			virt & (-linelen), linelen, lines);
+	if (retval != ERROR_OK)
+		goto done;
 
 	keep_alive();
 	dpm->finish(dpm);
@@ -354,36 +410,39 @@ int armv7a_l1_i_cache_inval_virt(struct target *target, uint32_t virt,
 	struct arm_dpm *dpm = armv7a->arm.dpm;
 	struct armv7a_cache_common *armv7a_cache =
 				&armv7a->armv7a_mmu.armv7a_cache;
+	struct armv7a_cachesize *i_size = &armv7a_cache->arch[0].i_size;
 	uint32_t linelen = armv7a_cache->iminline;
-	uint32_t va_line, va_end;
-	int retval, i = 0;
+	uint32_t va_line, lines;
+	int retval;
 
 	retval = armv7a_l1_i_cache_sanity_check(target);
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* beyond the size of the cache a single ICIALLU does the job */
+	lines = armv7a_cache_range_lines(virt, size, linelen);
+	if (lines > (i_size->index + 1) * (i_size->way + 1)) {
+		armv7a_cache->maint_full++;
+		return armv7a_l1_i_cache_inval_all(target);
+	}
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		goto done;
 
 	va_line = virt & (-linelen);
-	va_end = virt + size;
 
-	while (va_line < va_end) {
-		if ((i++ & 0x3f) == 0)
-			keep_alive();
-		/* ICIMVAU - Invalidate instruction cache by VA to PoU. */
-		retval = dpm->instr_write_data_r0(dpm,
-				ARMV4_5_MCR(15, 0, 0, 7, 5, 1), va_line);
-		if (retval != ERROR_OK)
-			goto done;
-		/* BPIMVA */
-		retval = dpm->instr_write_data_r0(dpm,
-				ARMV4_5_MCR(15, 0, 0, 7, 5, 7), va_line);
-		if (retval != ERROR_OK)
-			goto done;
-		va_line += linelen;
-	}
+	/* ICIMVAU - Invalidate instruction cache by VA to PoU. */
+	retval = armv7a_cache_op_range(target, ARMV4_5_MCR(15, 0, 0, 7, 5, 1),
+			va_line, linelen, lines);
+	if (retval != ERROR_OK)
+		goto done;
+	/* BPIMVA */
+	retval = armv7a_cache_op_range(target, ARMV4_5_MCR(15, 0, 0, 7, 5, 7),
+			va_line, linelen, lines);
+	if (retval != ERROR_OK)
+		goto done;
+
 	keep_alive();
 	dpm->finish(dpm);
 	return retval;
@@ -196,6 +196,65 @@ static int armv7m_get_core_reg(struct reg *reg)
 	return retval;
 }
 
+static int armv7m_get_core_regs(struct reg **reg_list, unsigned num_regs)
+{
+	int retval = ERROR_OK;
+	struct arm_reg *armv7m_reg = reg_list[0]->arch_info;
+	struct target *target = armv7m_reg->target;
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	if (target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	if (!armv7m->load_core_regs_u32) {
+		for (unsigned i = 0; i < num_regs && retval == ERROR_OK; i++)
+			retval = armv7m_get_core_reg(reg_list[i]);
+		return retval;
+	}
+
+	if (num_regs == 0)
+		return ERROR_OK;
+
+	/* D0..D15 take two reads each */
+	uint32_t *num = malloc(2 * num_regs * sizeof(uint32_t));
+	uint32_t *value = malloc(2 * num_regs * sizeof(uint32_t));
+	if (!num || !value) {
+		free(num);
+		free(value);
+		return ERROR_FAIL;
+	}
+
+	unsigned count = 0;
+	for (unsigned i = 0; i < num_regs; i++) {
+		armv7m_reg = reg_list[i]->arch_info;
+		if ((armv7m_reg->num >= ARMV7M_D0) && (armv7m_reg->num <= ARMV7M_D15)) {
+			/* map D0..D15 to S0..S31 */
+			num[count++] = ARMV7M_S0 + 2 * (armv7m_reg->num - ARMV7M_D0);
+			num[count++] = ARMV7M_S0 + 2 * (armv7m_reg->num - ARMV7M_D0) + 1;
+		} else {
+			num[count++] = armv7m_reg->num;
+		}
+	}
+
+	retval = armv7m->load_core_regs_u32(target, num, value, count);
+	if (retval == ERROR_OK) {
+		count = 0;
+		for (unsigned i = 0; i < num_regs; i++) {
+			struct reg *reg = reg_list[i];
+			armv7m_reg = reg->arch_info;
+			buf_set_u32(reg->value, 0, 32, value[count++]);
+			if ((armv7m_reg->num >= ARMV7M_D0) && (armv7m_reg->num <= ARMV7M_D15))
+				buf_set_u32(reg->value + 4, 0, 32, value[count++]);
+			reg->valid = true;
+			reg->dirty = false;
+		}
+	}
+
+	free(num);
+	free(value);
+	return retval;
+}
+
 static int armv7m_set_core_reg(struct reg *reg, uint8_t *buf)
 {
 	struct arm_reg *armv7m_reg = reg->arch_info;
@@ -586,6 +645,7 @@ int armv7m_arch_state(struct target *target)
 static const struct reg_arch_type armv7m_reg_type = {
 	.get = armv7m_get_core_reg,
 	.set = armv7m_set_core_reg,
+	.get_multiple = armv7m_get_core_regs,
 };
 
 /** Builds cache of architecturally defined registers.  */
@@ -595,7 +655,7 @@ struct reg_cache *armv7m_build_reg_cache(struct target *target)
 	struct arm *arm = &armv7m->arm;
 	int num_regs = ARMV7M_NUM_REGS;
 	struct reg_cache **cache_p = register_get_last_cache_p(&target->reg_cache);
-	struct reg_cache *cache = malloc(sizeof(struct reg_cache));
+	struct reg_cache *cache = calloc(1, sizeof(struct reg_cache));
 	struct reg *reg_list = calloc(num_regs, sizeof(struct reg));
 	struct arm_reg *arch_info = calloc(num_regs, sizeof(struct arm_reg));
 	struct reg_feature *feature;
@@ -673,6 +733,7 @@ void armv7m_free_reg_cache(struct target *target)
 
 	free(cache->reg_list[0].arch_info);
 	free(cache->reg_list);
+	register_cache_index_free(cache);
 	free(cache);
 
 	arm->core_cache = NULL;
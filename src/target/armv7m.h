@@ -161,6 +161,9 @@ struct armv7m_common {
 	/* Direct processor core register read and writes */
 	int (*load_core_reg_u32)(struct target *target, uint32_t num, uint32_t *value);
 	int (*store_core_reg_u32)(struct target *target, uint32_t num, uint32_t value);
+	/* Read several core registers at once (optional) */
+	int (*load_core_regs_u32)(struct target *target, const uint32_t *num,
+			uint32_t *value, unsigned count);
 
 	int (*examine_debug_reason)(struct target *target);
 	int (*post_debug_entry)(struct target *target);
@@ -24,34 +24,116 @@
 #include <target/cortex_m.h>
 #include <target/armv7m_trace.h>
 #include <jtag/interface.h>
+#include <helper/time_support.h>
 
 #define TRACE_BUF_SIZE	4096
 
+/* The trace ring is large enough to let the file sink batch its writes */
+#define TRACE_RING_SIZE		(64 * TRACE_BUF_SIZE)
+/* Write to the trace file when this much data is waiting, ... */
+#define TRACE_FILE_CHUNK	(16 * TRACE_BUF_SIZE)
+/* ... when the trace goes idle, or at least this often (ms) */
+#define TRACE_FILE_FLUSH_MS	100
+
+static int armv7m_trace_flush_file(struct armv7m_trace_config *trace_config)
+{
+	uint64_t pending = trace_config->trace_head - trace_config->trace_file_tail;
+	size_t offset = trace_config->trace_file_tail % TRACE_RING_SIZE;
+	int retval = ERROR_OK;
+
+	trace_config->trace_file_flush_ms = timeval_ms();
+	if (!pending)
+		return ERROR_OK;
+
+	/* the pending data wraps around the end of the ring at most once */
+	while (pending) {
+		size_t size = MIN(pending, TRACE_RING_SIZE - offset);
+
+		if (fwrite(&trace_config->trace_buf[offset], 1, size, trace_config->trace_file) != size) {
+			LOG_ERROR("Error writing to the trace destination file");
+			trace_config->stat_dropped += pending;
+			retval = ERROR_FAIL;
+			break;
+		}
+		pending -= size;
+		offset = 0;
+	}
+
+	if (retval == ERROR_OK)
+		fflush(trace_config->trace_file);
+
+	trace_config->stat_file_writes++;
+	trace_config->trace_file_tail = trace_config->trace_head;
+	return retval;
+}
+
 static int armv7m_poll_trace(void *target)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
-	uint8_t buf[TRACE_BUF_SIZE];
-	size_t size = sizeof(buf);
+	struct armv7m_trace_config *trace_config = &armv7m->trace_config;
 	int retval;
 
+	if (!trace_config->trace_buf) {
+		trace_config->trace_buf = malloc(TRACE_RING_SIZE);
+		if (!trace_config->trace_buf) {
+			LOG_ERROR("Unable to allocate trace buffer");
+			return ERROR_FAIL;
+		}
+	}
+
+	/* make room for a complete adapter read */
+	if (TRACE_RING_SIZE - (trace_config->trace_head - trace_config->trace_file_tail) < TRACE_BUF_SIZE) {
+		trace_config->stat_ring_full++;
+		retval = armv7m_trace_flush_file(trace_config);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	/* the adapter writes straight into the ring and the callbacks get the
+	 * data from there, no intermediate copies are made */
+	size_t offset = trace_config->trace_head % TRACE_RING_SIZE;
+	uint8_t *buf = &trace_config->trace_buf[offset];
+	size_t size = MIN(TRACE_BUF_SIZE, TRACE_RING_SIZE - offset);
+
+	trace_config->stat_polls++;
 	retval = adapter_poll_trace(buf, &size);
-	if (retval != ERROR_OK || !size)
+	if (retval != ERROR_OK)
 		return retval;
 
-	target_call_trace_callbacks(target, size, buf);
+	if (size) {
+		trace_config->trace_head += size;
+		target_call_trace_callbacks(target, size, buf);
+	}
 
-	if (armv7m->trace_config.trace_file != NULL) {
-		if (fwrite(buf, 1, size, armv7m->trace_config.trace_file) == size)
-			fflush(armv7m->trace_config.trace_file);
-		else {
-			LOG_ERROR("Error writing to the trace destination file");
-			return ERROR_FAIL;
-		}
+	if (trace_config->trace_file == NULL) {
+		trace_config->trace_file_tail = trace_config->trace_head;
+		return ERROR_OK;
 	}
 
+	size_t pending = trace_config->trace_head - trace_config->trace_file_tail;
+	if (pending > trace_config->stat_max_fill)
+		trace_config->stat_max_fill = pending;
+
+	if (pending >= TRACE_FILE_CHUNK || (pending && !size) ||
+			timeval_ms() - trace_config->trace_file_flush_ms >= TRACE_FILE_FLUSH_MS)
+		return armv7m_trace_flush_file(trace_config);
+
 	return ERROR_OK;
 }
 
+static void armv7m_trace_reset_buffer(struct armv7m_trace_config *trace_config)
+{
+	free(trace_config->trace_buf);
+	trace_config->trace_buf = NULL;
+	trace_config->trace_head = 0;
+	trace_config->trace_file_tail = 0;
+	trace_config->stat_polls = 0;
+	trace_config->stat_ring_full = 0;
+	trace_config->stat_dropped = 0;
+	trace_config->stat_file_writes = 0;
+	trace_config->stat_max_fill = 0;
+}
+
 int armv7m_trace_tpiu_config(struct target *target)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
@@ -60,6 +142,7 @@ int armv7m_trace_tpiu_config(struct target *target)
 	int retval;
 
 	target_unregister_timer_callback(armv7m_poll_trace, target);
+	armv7m_trace_reset_buffer(trace_config);
 
 	retval = adapter_config_trace(trace_config->config_type == TRACE_CONFIG_TYPE_INTERNAL,
 		trace_config->pin_protocol, trace_config->port_size,
@@ -138,11 +221,22 @@ int armv7m_trace_itm_config(struct target *target)
 
 static void close_trace_file(struct armv7m_common *armv7m)
 {
-	if (armv7m->trace_config.trace_file)
+	if (armv7m->trace_config.trace_file) {
+		armv7m_trace_flush_file(&armv7m->trace_config);
 		fclose(armv7m->trace_config.trace_file);
+	}
 	armv7m->trace_config.trace_file = NULL;
 }
 
+void armv7m_trace_free(struct target *target)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	target_unregister_timer_callback(armv7m_poll_trace, target);
+	close_trace_file(armv7m);
+	armv7m_trace_reset_buffer(&armv7m->trace_config);
+}
+
 COMMAND_HANDLER(handle_tpiu_config_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -238,6 +332,28 @@ COMMAND_HANDLER(handle_tpiu_config_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+COMMAND_HANDLER(handle_tpiu_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct armv7m_trace_config *trace_config = &armv7m->trace_config;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD, "captured %" PRIu64 " bytes in %" PRIu64 " polls",
+			trace_config->trace_head, trace_config->stat_polls);
+	command_print(CMD, "file: %" PRIu64 " writes, %" PRIu64 " bytes pending, %" PRIu64 " bytes dropped",
+			trace_config->stat_file_writes,
+			trace_config->trace_head - trace_config->trace_file_tail,
+			trace_config->stat_dropped);
+	command_print(CMD, "ring: %d bytes, max fill %zu bytes, full %" PRIu64 " times",
+			TRACE_RING_SIZE, trace_config->stat_max_fill,
+			trace_config->stat_ring_full);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_itm_port_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -294,6 +410,13 @@ static const struct command_registration tpiu_command_handlers[] = {
 		"(sync <port width> | ((manchester | uart) <formatter enable>)) "
 		"<TRACECLKIN freq> [<trace freq>]))",
 	},
+	{
+		.name = "stats",
+		.handler = handle_tpiu_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "Show trace capture statistics",
+		.usage = "",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -75,6 +75,28 @@ struct armv7m_trace_config {
 	unsigned int trace_freq;
 	/** Handle to output trace data in INTERNAL capture mode */
 	FILE *trace_file;
+
+	/** Ring buffer the adapter trace data is captured into in INTERNAL
+	 * capture mode; it holds the data until the file sink consumes it */
+	uint8_t *trace_buf;
+	/** Total number of bytes captured into the ring buffer */
+	uint64_t trace_head;
+	/** Total number of bytes consumed by the file sink */
+	uint64_t trace_file_tail;
+	/** Time of the last write to the trace file */
+	int64_t trace_file_flush_ms;
+
+	/** Number of adapter polls */
+	uint64_t stat_polls;
+	/** Number of times the ring was too full for a complete adapter read
+	 * and the file sink had to be drained first */
+	uint64_t stat_ring_full;
+	/** Number of bytes lost due to errors writing the trace file */
+	uint64_t stat_dropped;
+	/** Number of writes to the trace file */
+	uint64_t stat_file_writes;
+	/** Maximum amount of data waiting in the ring buffer */
+	size_t stat_max_fill;
 };
 
 extern const struct command_registration armv7m_trace_command_handlers[];
@@ -87,5 +109,9 @@ int armv7m_trace_tpiu_config(struct target *target);
  * Configure hardware accordingly to the current ITM target settings
  */
 int armv7m_trace_itm_config(struct target *target);
+/**
+ * Stop the trace capture and release the trace buffer and file
+ */
+void armv7m_trace_free(struct target *target);
 
 #endif /* OPENOCD_TARGET_ARMV7M_TRACE_H */
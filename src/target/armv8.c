@@ -1503,6 +1503,25 @@ static int armv8_get_core_reg(struct reg *reg)
 	return arm->read_core_reg(target, reg, armv8_reg->num, arm->core_mode);
 }
 
+static int armv8_get_core_regs(struct reg **reg_list, unsigned num_regs)
+{
+	int retval = ERROR_OK;
+	struct arm_reg *armv8_reg = reg_list[0]->arch_info;
+	struct target *target = armv8_reg->target;
+	struct arm *arm = target_to_arm(target);
+
+	if (target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	if (!arm->read_core_regs) {
+		for (unsigned i = 0; i < num_regs && retval == ERROR_OK; i++)
+			retval = armv8_get_core_reg(reg_list[i]);
+		return retval;
+	}
+
+	return arm->read_core_regs(target, reg_list, num_regs);
+}
+
 static int armv8_set_core_reg(struct reg *reg, uint8_t *buf)
 {
 	struct arm_reg *armv8_reg = reg->arch_info;
@@ -1536,6 +1555,7 @@ static int armv8_set_core_reg(struct reg *reg, uint8_t *buf)
 static const struct reg_arch_type armv8_reg_type = {
 	.get = armv8_get_core_reg,
 	.set = armv8_set_core_reg,
+	.get_multiple = armv8_get_core_regs,
 };
 
 static int armv8_get_core_reg32(struct reg *reg)
@@ -1607,8 +1627,8 @@ struct reg_cache *armv8_build_reg_cache(struct target *target)
 	int num_regs = ARMV8_NUM_REGS;
 	int num_regs32 = ARMV8_NUM_REGS32;
 	struct reg_cache **cache_p = register_get_last_cache_p(&target->reg_cache);
-	struct reg_cache *cache = malloc(sizeof(struct reg_cache));
-	struct reg_cache *cache32 = malloc(sizeof(struct reg_cache));
+	struct reg_cache *cache = calloc(1, sizeof(struct reg_cache));
+	struct reg_cache *cache32 = calloc(1, sizeof(struct reg_cache));
 	struct reg *reg_list = calloc(num_regs, sizeof(struct reg));
 	struct reg *reg_list32 = calloc(num_regs32, sizeof(struct reg));
 	struct arm_reg *arch_info = calloc(num_regs, sizeof(struct arm_reg));
@@ -1723,6 +1743,7 @@ static void armv8_free_cache(struct reg_cache *cache, bool regs32)
 	if (!regs32)
 		free(cache->reg_list[0].arch_info);
 	free(cache->reg_list);
+	register_cache_index_free(cache);
 	free(cache);
 }
 
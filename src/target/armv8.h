@@ -198,6 +198,8 @@ struct armv8_common {
 	struct arm_dpm dpm;
 	uint32_t debug_base;
 	struct adiv5_ap *debug_ap;
+	/* system bus MEM-AP, if any, for direct memory access */
+	struct adiv5_ap *memory_ap;
 
 	const uint32_t *opcodes;
 
@@ -985,6 +985,32 @@ fail:
 	return retval;
 }
 
+/* Read several core registers within a single prepare/finish sequence. */
+static int armv8_dpm_read_core_regs(struct target *target, struct reg **reg_list,
+	unsigned num_regs)
+{
+	struct arm *arm = target_to_arm(target);
+	struct arm_dpm *dpm = arm->dpm;
+	int max = arm->core_cache->num_regs;
+	int retval;
+
+	retval = dpm->prepare(dpm);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned i = 0; i < num_regs && retval == ERROR_OK; i++) {
+		struct arm_reg *arm_reg = reg_list[i]->arch_info;
+
+		if (arm_reg->num < 0 || arm_reg->num >= max)
+			retval = ERROR_COMMAND_SYNTAX_ERROR;
+		else
+			retval = dpmv8_read_reg(dpm, reg_list[i], arm_reg->num);
+	}
+
+	/* (void) */ dpm->finish(dpm);
+	return retval;
+}
+
 static int armv8_dpm_write_core_reg(struct target *target, struct reg *r,
 	int regnum, enum arm_mode mode, uint8_t *value)
 {
@@ -1419,6 +1445,7 @@ int armv8_dpm_setup(struct arm_dpm *dpm)
 	/* register access setup */
 	arm->full_context = armv8_dpm_full_context;
 	arm->read_core_reg = armv8_dpm_read_core_reg;
+	arm->read_core_regs = armv8_dpm_read_core_regs;
 	arm->write_core_reg = armv8_dpm_write_core_reg;
 
 	if (arm->core_cache == NULL) {
@@ -26,6 +26,7 @@
 #include "target.h"
 #include <helper/log.h>
 #include "breakpoints.h"
+#include "smp.h"
 
 static const char * const breakpoint_type_strings[] = {
 	"hardware",
@@ -41,84 +42,287 @@ static const char * const watchpoint_rw_strings[] = {
 /* monotonic counter/id-number for breakpoints and watch points */
 static int bpwp_unique_id;
 
-static int breakpoint_add_internal(struct target *target,
-	target_addr_t address,
-	uint32_t length,
-	enum breakpoint_type type)
+/*
+ * Each target keeps its breakpoints in a vector sorted by (address, asid),
+ * and its watchpoints in one sorted by address, so that lookups bisect
+ * instead of walking the lists. The lists are kept in the same order as the
+ * vectors: an entry's predecessor in the list is the previous vector slot.
+ */
+
+#define BPWP_INDEX_MIN_SIZE 16
+
+static int breakpoint_index_reserve(struct target *target, unsigned int count)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
-	const char *reason;
-	int retval;
-	int n;
+	unsigned int size = target->breakpoint_index_size;
 
-	n = 0;
-	while (breakpoint) {
-		n++;
-		if (breakpoint->address == address) {
-			/* FIXME don't assume "same address" means "same
-			 * breakpoint" ... check all the parameters before
-			 * succeeding.
-			 */
-			LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
-				address, breakpoint->unique_id);
-			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
-		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+	if (target->breakpoint_count + count <= size)
+		return ERROR_OK;
+
+	if (size < BPWP_INDEX_MIN_SIZE)
+		size = BPWP_INDEX_MIN_SIZE;
+	while (size < target->breakpoint_count + count)
+		size *= 2;
+
+	struct breakpoint **index = realloc(target->breakpoint_index, size * sizeof(*index));
+	if (!index) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	target->breakpoint_index = index;
+	target->breakpoint_index_size = size;
+	return ERROR_OK;
+}
+
+/* first slot whose key is not below (address, asid) */
+static unsigned int breakpoint_lower_bound(struct target *target,
+	target_addr_t address, uint32_t asid)
+{
+	unsigned int lo = 0;
+	unsigned int hi = target->breakpoint_count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		struct breakpoint *breakpoint = target->breakpoint_index[mid];
+
+		if (breakpoint->address < address
+				|| (breakpoint->address == address && breakpoint->asid < asid))
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+	return lo;
+}
+
+static struct breakpoint *breakpoint_at(struct target *target, unsigned int pos)
+{
+	return pos < target->breakpoint_count ? target->breakpoint_index[pos] : NULL;
+}
+
+static int breakpoint_index_insert(struct target *target, unsigned int pos,
+	struct breakpoint *breakpoint)
+{
+	struct breakpoint **index;
+
+	if (breakpoint_index_reserve(target, 1) != ERROR_OK)
+		return ERROR_FAIL;
+
+	index = target->breakpoint_index;
+	memmove(&index[pos + 1], &index[pos],
+		(target->breakpoint_count - pos) * sizeof(*index));
+	index[pos] = breakpoint;
+	target->breakpoint_count++;
+
+	breakpoint->next = breakpoint_at(target, pos + 1);
+	if (pos > 0)
+		index[pos - 1]->next = breakpoint;
+	else
+		target->breakpoints = breakpoint;
+	return ERROR_OK;
+}
+
+static void breakpoint_index_remove(struct target *target, unsigned int pos)
+{
+	struct breakpoint **index = target->breakpoint_index;
+	struct breakpoint *next = breakpoint_at(target, pos + 1);
+
+	if (pos > 0)
+		index[pos - 1]->next = next;
+	else
+		target->breakpoints = next;
+
+	memmove(&index[pos], &index[pos + 1],
+		(target->breakpoint_count - pos - 1) * sizeof(*index));
+	target->breakpoint_count--;
+}
+
+/* drop the NULL slots left by a batch removal and relink the list */
+static void breakpoint_index_compact(struct target *target)
+{
+	struct breakpoint **index = target->breakpoint_index;
+	unsigned int n = 0;
+
+	for (unsigned int i = 0; i < target->breakpoint_count; i++)
+		if (index[i])
+			index[n++] = index[i];
+	target->breakpoint_count = n;
+
+	for (unsigned int i = 0; i < n; i++)
+		index[i]->next = breakpoint_at(target, i + 1);
+	target->breakpoints = breakpoint_at(target, 0);
+}
+
+static struct breakpoint *breakpoint_new(target_addr_t address, uint32_t asid,
+	uint32_t length, enum breakpoint_type type)
+{
+	struct breakpoint *breakpoint = malloc(sizeof(struct breakpoint));
+	if (!breakpoint)
+		return NULL;
+
+	breakpoint->address = address;
+	breakpoint->asid = asid;
+	breakpoint->length = length;
+	breakpoint->type = type;
+	breakpoint->set = 0;
+	breakpoint->orig_instr = malloc(length);
+	breakpoint->next = NULL;
+	breakpoint->unique_id = bpwp_unique_id++;
+	return breakpoint;
+}
+
+/* unlink a breakpoint and release it */
+static void breakpoint_discard(struct target *target, unsigned int pos)
+{
+	struct breakpoint *breakpoint = target->breakpoint_index[pos];
+
+	breakpoint_index_remove(target, pos);
+	free(breakpoint->orig_instr);
+	free(breakpoint);
+}
+
+static void breakpoint_add_failed(int retval)
+{
+	const char *reason;
 
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = address;
-	(*breakpoint_p)->asid = 0;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->set = 0;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
-
-	retval = target_add_breakpoint(target, *breakpoint_p);
 	switch (retval) {
-		case ERROR_OK:
-			break;
 		case ERROR_TARGET_RESOURCE_NOT_AVAILABLE:
 			reason = "resource not available";
-			goto fail;
+			break;
 		case ERROR_TARGET_NOT_HALTED:
 			reason = "target running";
-			goto fail;
+			break;
 		default:
 			reason = "unknown reason";
-fail:
-			LOG_ERROR("can't add breakpoint: %s", reason);
-			free((*breakpoint_p)->orig_instr);
-			free(*breakpoint_p);
-			*breakpoint_p = NULL;
-			return retval;
+			break;
 	}
+	LOG_ERROR("can't add breakpoint: %s", reason);
+}
 
+static void breakpoint_added(struct breakpoint *breakpoint)
+{
 	LOG_DEBUG("added %s breakpoint at " TARGET_ADDR_FMT " of length 0x%8.8x, (BPID: %" PRIu32 ")",
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->address, (*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->address, breakpoint->length,
+		breakpoint->unique_id);
+}
+
+static int breakpoint_add_internal(struct target *target,
+	target_addr_t address,
+	uint32_t length,
+	enum breakpoint_type type)
+{
+	struct breakpoint *breakpoint;
+	unsigned int pos;
+	int retval;
+
+	pos = breakpoint_lower_bound(target, address, 0);
+	breakpoint = breakpoint_at(target, pos);
+	if (breakpoint && breakpoint->address == address) {
+		/* FIXME don't assume "same address" means "same
+		 * breakpoint" ... check all the parameters before
+		 * succeeding.
+		 */
+		LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
+			address, breakpoint->unique_id);
+		return ERROR_TARGET_DUPLICATE_BREAKPOINT;
+	}
+
+	breakpoint = breakpoint_new(address, 0, length, type);
+	if (!breakpoint || breakpoint_index_insert(target, pos, breakpoint) != ERROR_OK) {
+		LOG_ERROR("Out of memory");
+		if (breakpoint)
+			free(breakpoint->orig_instr);
+		free(breakpoint);
+		return ERROR_FAIL;
+	}
+
+	retval = target_add_breakpoint(target, breakpoint);
+	if (retval != ERROR_OK) {
+		breakpoint_add_failed(retval);
+		breakpoint_discard(target, pos);
+		return retval;
+	}
 
+	breakpoint_added(breakpoint);
 	return ERROR_OK;
 }
 
+/* add a set of software breakpoints, letting the target insert them
+ * together; whatever it leaves unset goes through add_breakpoint() */
+static int breakpoint_add_soft_batch(struct target *target,
+	const target_addr_t *addresses,
+	const uint32_t *lengths,
+	unsigned int count)
+{
+	struct breakpoint **added;
+	unsigned int n = 0;
+	int retval = ERROR_OK;
+
+	if (breakpoint_index_reserve(target, count) != ERROR_OK)
+		return ERROR_FAIL;
+
+	added = malloc(count * sizeof(*added));
+	if (!added) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int pos = breakpoint_lower_bound(target, addresses[i], 0);
+		struct breakpoint *breakpoint = breakpoint_at(target, pos);
+
+		if (breakpoint && breakpoint->address == addresses[i]) {
+			LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
+				addresses[i], breakpoint->unique_id);
+			retval = ERROR_TARGET_DUPLICATE_BREAKPOINT;
+			continue;
+		}
+
+		breakpoint = breakpoint_new(addresses[i], 0, lengths[i], BKPT_SOFT);
+		if (!breakpoint) {
+			LOG_ERROR("Out of memory");
+			retval = ERROR_FAIL;
+			break;
+		}
+		/* cannot fail, the index was grown above */
+		breakpoint_index_insert(target, pos, breakpoint);
+		added[n++] = breakpoint;
+	}
+
+	int batch_retval = target_add_breakpoints(target, added, n);
+	if (batch_retval != ERROR_OK)
+		LOG_DEBUG("batched breakpoint insertion failed, retrying one by one");
+
+	for (unsigned int i = 0; i < n; i++) {
+		struct breakpoint *breakpoint = added[i];
+		int r = ERROR_OK;
+
+		if (!breakpoint->set)
+			r = target_add_breakpoint(target, breakpoint);
+		if (r != ERROR_OK) {
+			breakpoint_add_failed(r);
+			breakpoint_discard(target,
+				breakpoint_lower_bound(target, breakpoint->address, 0));
+			retval = r;
+			continue;
+		}
+		breakpoint_added(breakpoint);
+	}
+
+	free(added);
+	return retval;
+}
+
 static int context_breakpoint_add_internal(struct target *target,
 	uint32_t asid,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *breakpoint;
+	unsigned int pos;
 	int retval;
-	int n;
 
-	n = 0;
-	while (breakpoint) {
-		n++;
+	/* any breakpoint on that asid clashes, not only context ones */
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
 		if (breakpoint->asid == asid) {
 			/* FIXME don't assume "same address" means "same
 			 * breakpoint" ... check all the parameters before
@@ -128,32 +332,29 @@ static int context_breakpoint_add_internal(struct target *target,
 				asid, breakpoint->unique_id);
 			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
 	}
 
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = 0;
-	(*breakpoint_p)->asid = asid;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->set = 0;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
-	retval = target_add_context_breakpoint(target, *breakpoint_p);
+	pos = breakpoint_lower_bound(target, 0, asid);
+	breakpoint = breakpoint_new(0, asid, length, type);
+	if (!breakpoint || breakpoint_index_insert(target, pos, breakpoint) != ERROR_OK) {
+		LOG_ERROR("Out of memory");
+		if (breakpoint)
+			free(breakpoint->orig_instr);
+		free(breakpoint);
+		return ERROR_FAIL;
+	}
+
+	retval = target_add_context_breakpoint(target, breakpoint);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("could not add breakpoint");
-		free((*breakpoint_p)->orig_instr);
-		free(*breakpoint_p);
-		*breakpoint_p = NULL;
+		breakpoint_discard(target, pos);
 		return retval;
 	}
 
 	LOG_DEBUG("added %s Context breakpoint at 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %" PRIu32 ")",
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->asid, (*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->asid, breakpoint->length,
+		breakpoint->unique_id);
 
 	return ERROR_OK;
 }
@@ -164,55 +365,50 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *breakpoint;
+	unsigned int pos;
 	int retval;
-	int n;
-	n = 0;
-	while (breakpoint) {
-		n++;
-		if ((breakpoint->asid == asid) && (breakpoint->address == address)) {
-			/* FIXME don't assume "same address" means "same
-			 * breakpoint" ... check all the parameters before
-			 * succeeding.
-			 */
-			LOG_ERROR("Duplicate Hybrid Breakpoint asid: 0x%08" PRIx32 " (BP %" PRIu32 ")",
-				asid, breakpoint->unique_id);
-			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
-		} else if ((breakpoint->address == address) && (breakpoint->asid == 0)) {
-			LOG_ERROR("Duplicate Breakpoint IVA: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
-				address, breakpoint->unique_id);
-			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 
-		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+	breakpoint = breakpoint_at(target, breakpoint_lower_bound(target, address, 0));
+	if (breakpoint && breakpoint->address == address && breakpoint->asid == 0) {
+		LOG_ERROR("Duplicate Breakpoint IVA: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
+			address, breakpoint->unique_id);
+		return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 	}
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = address;
-	(*breakpoint_p)->asid = asid;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->set = 0;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
-
-
-	retval = target_add_hybrid_breakpoint(target, *breakpoint_p);
+
+	pos = breakpoint_lower_bound(target, address, asid);
+	breakpoint = breakpoint_at(target, pos);
+	if (breakpoint && breakpoint->address == address && breakpoint->asid == asid) {
+		/* FIXME don't assume "same address" means "same
+		 * breakpoint" ... check all the parameters before
+		 * succeeding.
+		 */
+		LOG_ERROR("Duplicate Hybrid Breakpoint asid: 0x%08" PRIx32 " (BP %" PRIu32 ")",
+			asid, breakpoint->unique_id);
+		return ERROR_TARGET_DUPLICATE_BREAKPOINT;
+	}
+
+	breakpoint = breakpoint_new(address, asid, length, type);
+	if (!breakpoint || breakpoint_index_insert(target, pos, breakpoint) != ERROR_OK) {
+		LOG_ERROR("Out of memory");
+		if (breakpoint)
+			free(breakpoint->orig_instr);
+		free(breakpoint);
+		return ERROR_FAIL;
+	}
+
+	retval = target_add_hybrid_breakpoint(target, breakpoint);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("could not add breakpoint");
-		free((*breakpoint_p)->orig_instr);
-		free(*breakpoint_p);
-		*breakpoint_p = NULL;
+		breakpoint_discard(target, pos);
 		return retval;
 	}
 	LOG_DEBUG(
 		"added %s Hybrid breakpoint at address " TARGET_ADDR_FMT " of length 0x%8.8x, (BPID: %" PRIu32 ")",
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->address,
-		(*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->address,
+		breakpoint->length,
+		breakpoint->unique_id);
 
 	return ERROR_OK;
 }
@@ -287,75 +483,168 @@ int hybrid_breakpoint_add(struct target *target,
 		return hybrid_breakpoint_add_internal(target, address, asid, length, type);
 }
 
-/* free up a breakpoint */
-static void breakpoint_free(struct target *target, struct breakpoint *breakpoint_to_remove)
+int breakpoint_add_batch(struct target *target,
+	const target_addr_t *addresses,
+	const uint32_t *lengths,
+	unsigned int count,
+	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
-	int retval;
+	int retval = ERROR_OK;
 
-	while (breakpoint) {
-		if (breakpoint == breakpoint_to_remove)
-			break;
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+	/* software breakpoints of an SMP group live on its first target */
+	if (type == BKPT_SOFT) {
+		if (target->smp)
+			target = target->head->target;
+		return breakpoint_add_soft_batch(target, addresses, lengths, count);
 	}
 
-	if (breakpoint == NULL)
-		return;
+	/* grow the indexes once for the whole batch */
+	if (target->smp) {
+		struct target_list *head;
+		foreach_smp_target(head, target->head) {
+			if (breakpoint_index_reserve(head->target, count) != ERROR_OK)
+				return ERROR_FAIL;
+		}
+	} else if (breakpoint_index_reserve(target, count) != ERROR_OK)
+		return ERROR_FAIL;
 
-	retval = target_remove_breakpoint(target, breakpoint);
+	/* keep going past failures, like separate requests would */
+	for (unsigned int i = 0; i < count; i++) {
+		int r = breakpoint_add(target, addresses[i], lengths[i], type);
+		if (r != ERROR_OK)
+			retval = r;
+	}
+	return retval;
+}
 
-	LOG_DEBUG("free BPID: %" PRIu32 " --> %d", breakpoint->unique_id, retval);
-	(*breakpoint_p) = breakpoint->next;
-	free(breakpoint->orig_instr);
-	free(breakpoint);
+/* slot of the breakpoint "rbp address" refers to: an IVA or hybrid
+ * breakpoint at that address, else a context breakpoint on that asid */
+static int breakpoint_lookup_remove(struct target *target, target_addr_t address)
+{
+	unsigned int pos = breakpoint_lower_bound(target, address, 0);
+	struct breakpoint *breakpoint = breakpoint_at(target, pos);
+
+	if (breakpoint && breakpoint->address == address)
+		return pos;
+
+	if (address > UINT32_MAX)
+		return -1;
+
+	pos = breakpoint_lower_bound(target, 0, address);
+	breakpoint = breakpoint_at(target, pos);
+	if (breakpoint && breakpoint->address == 0 && breakpoint->asid == address)
+		return pos;
+
+	return -1;
 }
 
-static int breakpoint_remove_internal(struct target *target, target_addr_t address)
+/* remove and free the breakpoints found at the given addresses, found[i]
+ * is set for every address that had one */
+static void breakpoint_remove_batch_internal(struct target *target,
+	const target_addr_t *addresses,
+	unsigned int count,
+	bool *found)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint **victims;
+	int *slots;
+	unsigned int n = 0;
+
+	if (count == 1) {
+		int pos = breakpoint_lookup_remove(target, addresses[0]);
+		if (pos < 0)
+			return;
+
+		struct breakpoint *breakpoint = target->breakpoint_index[pos];
+		int retval = target_remove_breakpoint(target, breakpoint);
+		LOG_DEBUG("free BPID: %" PRIu32 " --> %d", breakpoint->unique_id, retval);
+		breakpoint_discard(target, pos);
+		found[0] = true;
+		return;
+	}
 
-	while (breakpoint) {
-		if ((breakpoint->address == address) ||
-		    (breakpoint->address == 0 && breakpoint->asid == address))
-			break;
-		breakpoint = breakpoint->next;
+	slots = malloc(count * sizeof(*slots));
+	victims = malloc(count * sizeof(*victims));
+	if (!slots || !victims) {
+		LOG_ERROR("Out of memory");
+		free(slots);
+		free(victims);
+		return;
 	}
 
-	if (breakpoint) {
-		breakpoint_free(target, breakpoint);
-		return 1;
-	} else {
-		if (!target->smp)
-			LOG_ERROR("no breakpoint at address " TARGET_ADDR_FMT " found", address);
-		return 0;
+	/* look everything up before the index changes */
+	for (unsigned int i = 0; i < count; i++)
+		slots[i] = breakpoint_lookup_remove(target, addresses[i]);
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (slots[i] < 0)
+			continue;
+		found[i] = true;
+		if (!target->breakpoint_index[slots[i]])
+			continue;
+		victims[n++] = target->breakpoint_index[slots[i]];
+		target->breakpoint_index[slots[i]] = NULL;
 	}
+
+	/* the target still sees the complete list while removing */
+	target_remove_breakpoints(target, victims, n);
+
+	breakpoint_index_compact(target);
+
+	for (unsigned int i = 0; i < n; i++) {
+		free(victims[i]->orig_instr);
+		free(victims[i]);
+	}
+	free(victims);
+	free(slots);
 }
-void breakpoint_remove(struct target *target, target_addr_t address)
+
+void breakpoint_remove_batch(struct target *target,
+	const target_addr_t *addresses,
+	unsigned int count)
 {
-	int found = 0;
+	bool *found;
+
+	if (count == 0)
+		return;
+
+	found = calloc(count, sizeof(*found));
+	if (!found) {
+		LOG_ERROR("Out of memory");
+		return;
+	}
+
 	if (target->smp) {
 		struct target_list *head;
-		struct target *curr;
-		head = target->head;
-		while (head != (struct target_list *)NULL) {
-			curr = head->target;
-			found += breakpoint_remove_internal(curr, address);
-			head = head->next;
-		}
-		if (found == 0)
-			LOG_ERROR("no breakpoint at address " TARGET_ADDR_FMT " found", address);
+		foreach_smp_target(head, target->head)
+			breakpoint_remove_batch_internal(head->target, addresses, count, found);
 	} else
-		breakpoint_remove_internal(target, address);
+		breakpoint_remove_batch_internal(target, addresses, count, found);
+
+	for (unsigned int i = 0; i < count; i++)
+		if (!found[i])
+			LOG_ERROR("no breakpoint at address " TARGET_ADDR_FMT " found", addresses[i]);
+	free(found);
+}
+
+void breakpoint_remove(struct target *target, target_addr_t address)
+{
+	breakpoint_remove_batch(target, &address, 1);
 }
 
 void breakpoint_clear_target_internal(struct target *target)
 {
 	LOG_DEBUG("Delete all breakpoints for target: %s",
 		target_name(target));
-	while (target->breakpoints != NULL)
-		breakpoint_free(target, target->breakpoints);
+
+	target_remove_breakpoints(target, target->breakpoint_index,
+		target->breakpoint_count);
+
+	for (unsigned int i = 0; i < target->breakpoint_count; i++) {
+		free(target->breakpoint_index[i]->orig_instr);
+		free(target->breakpoint_index[i]);
+	}
+	target->breakpoint_count = 0;
+	target->breakpoints = NULL;
 }
 
 void breakpoint_clear_target(struct target *target)
@@ -376,53 +665,134 @@ void breakpoint_clear_target(struct target *target)
 
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint;
 
-	while (breakpoint) {
-		if (breakpoint->address == address)
-			return breakpoint;
-		breakpoint = breakpoint->next;
-	}
+	breakpoint = breakpoint_at(target, breakpoint_lower_bound(target, address, 0));
+	if (breakpoint && breakpoint->address == address)
+		return breakpoint;
 
 	return NULL;
 }
 
+static int watchpoint_index_reserve(struct target *target, unsigned int count)
+{
+	unsigned int size = target->watchpoint_index_size;
+
+	if (target->watchpoint_count + count <= size)
+		return ERROR_OK;
+
+	if (size < BPWP_INDEX_MIN_SIZE)
+		size = BPWP_INDEX_MIN_SIZE;
+	while (size < target->watchpoint_count + count)
+		size *= 2;
+
+	struct watchpoint **index = realloc(target->watchpoint_index, size * sizeof(*index));
+	if (!index) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	target->watchpoint_index = index;
+	target->watchpoint_index_size = size;
+	return ERROR_OK;
+}
+
+static unsigned int watchpoint_lower_bound(struct target *target, target_addr_t address)
+{
+	unsigned int lo = 0;
+	unsigned int hi = target->watchpoint_count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (target->watchpoint_index[mid]->address < address)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static struct watchpoint *watchpoint_at(struct target *target, unsigned int pos)
+{
+	return pos < target->watchpoint_count ? target->watchpoint_index[pos] : NULL;
+}
+
+static int watchpoint_index_insert(struct target *target, unsigned int pos,
+	struct watchpoint *watchpoint)
+{
+	struct watchpoint **index;
+
+	if (watchpoint_index_reserve(target, 1) != ERROR_OK)
+		return ERROR_FAIL;
+
+	index = target->watchpoint_index;
+	memmove(&index[pos + 1], &index[pos],
+		(target->watchpoint_count - pos) * sizeof(*index));
+	index[pos] = watchpoint;
+	target->watchpoint_count++;
+
+	watchpoint->next = watchpoint_at(target, pos + 1);
+	if (pos > 0)
+		index[pos - 1]->next = watchpoint;
+	else
+		target->watchpoints = watchpoint;
+	return ERROR_OK;
+}
+
+static void watchpoint_index_remove(struct target *target, unsigned int pos)
+{
+	struct watchpoint **index = target->watchpoint_index;
+	struct watchpoint *next = watchpoint_at(target, pos + 1);
+
+	if (pos > 0)
+		index[pos - 1]->next = next;
+	else
+		target->watchpoints = next;
+
+	memmove(&index[pos], &index[pos + 1],
+		(target->watchpoint_count - pos - 1) * sizeof(*index));
+	target->watchpoint_count--;
+}
+
 int watchpoint_add(struct target *target, target_addr_t address, uint32_t length,
 	enum watchpoint_rw rw, uint32_t value, uint32_t mask)
 {
-	struct watchpoint *watchpoint = target->watchpoints;
-	struct watchpoint **watchpoint_p = &target->watchpoints;
+	struct watchpoint *watchpoint;
+	unsigned int pos;
 	int retval;
 	const char *reason;
 
-	while (watchpoint) {
-		if (watchpoint->address == address) {
-			if (watchpoint->length != length
-				|| watchpoint->value != value
-				|| watchpoint->mask != mask
-				|| watchpoint->rw != rw) {
-				LOG_ERROR("address " TARGET_ADDR_FMT
-					" already has watchpoint %d",
-					address, watchpoint->unique_id);
-				return ERROR_FAIL;
-			}
-
-			/* ignore duplicate watchpoint */
-			return ERROR_OK;
+	pos = watchpoint_lower_bound(target, address);
+	watchpoint = watchpoint_at(target, pos);
+	if (watchpoint && watchpoint->address == address) {
+		if (watchpoint->length != length
+			|| watchpoint->value != value
+			|| watchpoint->mask != mask
+			|| watchpoint->rw != rw) {
+			LOG_ERROR("address " TARGET_ADDR_FMT
+				" already has watchpoint %d",
+				address, watchpoint->unique_id);
+			return ERROR_FAIL;
 		}
-		watchpoint_p = &watchpoint->next;
-		watchpoint = watchpoint->next;
-	}
 
-	(*watchpoint_p) = calloc(1, sizeof(struct watchpoint));
-	(*watchpoint_p)->address = address;
-	(*watchpoint_p)->length = length;
-	(*watchpoint_p)->value = value;
-	(*watchpoint_p)->mask = mask;
-	(*watchpoint_p)->rw = rw;
-	(*watchpoint_p)->unique_id = bpwp_unique_id++;
+		/* ignore duplicate watchpoint */
+		return ERROR_OK;
+	}
 
-	retval = target_add_watchpoint(target, *watchpoint_p);
+	watchpoint = calloc(1, sizeof(struct watchpoint));
+	if (!watchpoint || watchpoint_index_insert(target, pos, watchpoint) != ERROR_OK) {
+		LOG_ERROR("Out of memory");
+		free(watchpoint);
+		return ERROR_FAIL;
+	}
+	watchpoint->address = address;
+	watchpoint->length = length;
+	watchpoint->value = value;
+	watchpoint->mask = mask;
+	watchpoint->rw = rw;
+	watchpoint->unique_id = bpwp_unique_id++;
+
+	retval = target_add_watchpoint(target, watchpoint);
 	switch (retval) {
 		case ERROR_OK:
 			break;
@@ -436,56 +806,41 @@ int watchpoint_add(struct target *target, target_addr_t address, uint32_t length
 			reason = "unrecognized error";
 bye:
 			LOG_ERROR("can't add %s watchpoint at " TARGET_ADDR_FMT ", %s",
-				watchpoint_rw_strings[(*watchpoint_p)->rw],
+				watchpoint_rw_strings[watchpoint->rw],
 				address, reason);
-			free(*watchpoint_p);
-			*watchpoint_p = NULL;
+			watchpoint_index_remove(target, pos);
+			free(watchpoint);
 			return retval;
 	}
 
 	LOG_DEBUG("added %s watchpoint at " TARGET_ADDR_FMT
 		" of length 0x%8.8" PRIx32 " (WPID: %d)",
-		watchpoint_rw_strings[(*watchpoint_p)->rw],
-		(*watchpoint_p)->address,
-		(*watchpoint_p)->length,
-		(*watchpoint_p)->unique_id);
+		watchpoint_rw_strings[watchpoint->rw],
+		watchpoint->address,
+		watchpoint->length,
+		watchpoint->unique_id);
 
 	return ERROR_OK;
 }
 
-static void watchpoint_free(struct target *target, struct watchpoint *watchpoint_to_remove)
+static void watchpoint_free(struct target *target, unsigned int pos)
 {
-	struct watchpoint *watchpoint = target->watchpoints;
-	struct watchpoint **watchpoint_p = &target->watchpoints;
+	struct watchpoint *watchpoint = target->watchpoint_index[pos];
 	int retval;
 
-	while (watchpoint) {
-		if (watchpoint == watchpoint_to_remove)
-			break;
-		watchpoint_p = &watchpoint->next;
-		watchpoint = watchpoint->next;
-	}
-
-	if (watchpoint == NULL)
-		return;
 	retval = target_remove_watchpoint(target, watchpoint);
 	LOG_DEBUG("free WPID: %d --> %d", watchpoint->unique_id, retval);
-	(*watchpoint_p) = watchpoint->next;
+	watchpoint_index_remove(target, pos);
 	free(watchpoint);
 }
 
 void watchpoint_remove(struct target *target, target_addr_t address)
 {
-	struct watchpoint *watchpoint = target->watchpoints;
-
-	while (watchpoint) {
-		if (watchpoint->address == address)
-			break;
-		watchpoint = watchpoint->next;
-	}
+	unsigned int pos = watchpoint_lower_bound(target, address);
+	struct watchpoint *watchpoint = watchpoint_at(target, pos);
 
-	if (watchpoint)
-		watchpoint_free(target, watchpoint);
+	if (watchpoint && watchpoint->address == address)
+		watchpoint_free(target, pos);
 	else
 		LOG_ERROR("no watchpoint at address " TARGET_ADDR_FMT " found", address);
 }
@@ -494,8 +849,8 @@ void watchpoint_clear_target(struct target *target)
 {
 	LOG_DEBUG("Delete all watchpoints for target: %s",
 		target_name(target));
-	while (target->watchpoints != NULL)
-		watchpoint_free(target, target->watchpoints);
+	while (target->watchpoint_count > 0)
+		watchpoint_free(target, target->watchpoint_count - 1);
 }
 
 int watchpoint_hit(struct target *target, enum watchpoint_rw *rw,
@@ -64,6 +64,13 @@ int hybrid_breakpoint_add(struct target *target,
 		target_addr_t address, uint32_t asid, uint32_t length, enum breakpoint_type type);
 void breakpoint_remove(struct target *target, target_addr_t address);
 
+/* add or remove several breakpoints, growing or compacting the target's
+ * breakpoint index once for the whole set */
+int breakpoint_add_batch(struct target *target, const target_addr_t *addresses,
+		const uint32_t *lengths, unsigned int count, enum breakpoint_type type);
+void breakpoint_remove_batch(struct target *target, const target_addr_t *addresses,
+		unsigned int count);
+
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address);
 
 void watchpoint_clear_target(struct target *target);
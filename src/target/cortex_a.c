@@ -79,6 +79,10 @@ static int cortex_a_virt2phys(struct target *target,
 	target_addr_t virt, target_addr_t *phys);
 static int cortex_a_read_cpu_memory(struct target *target,
 	uint32_t address, uint32_t size, uint32_t count, uint8_t *buffer);
+static int cortex_a_write_memory_no_flush(struct target *target,
+	target_addr_t address, uint32_t size, uint32_t count, const uint8_t *buffer);
+static int cortex_a_set_dcc_mode(struct target *target, uint32_t mode,
+	uint32_t *dscr);
 
 
 /*  restore cp15_control_reg at resume */
@@ -466,6 +470,76 @@ static int cortex_a_instr_write_data_r0(struct arm_dpm *dpm,
 	return retval;
 }
 
+static int cortex_a_instr_write_data_r0_range(struct arm_dpm *dpm,
+	uint32_t opcode, uint32_t data, uint32_t step, uint32_t count)
+{
+	struct cortex_a_common *a = dpm_to_a(dpm);
+	struct armv7a_common *armv7a = &a->armv7a_common;
+	struct target *target = armv7a->arm.target;
+	uint32_t dscr;
+	int retval, final_retval;
+
+	retval = mem_ap_read_atomic_u32(armv7a->debug_ap,
+			armv7a->debug_base + CPUDBG_DSCR, &dscr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* In stall mode writes to DTRRX and ITR wait for the core to be ready,
+	 * so a whole batch can be queued and run at once. */
+	retval = cortex_a_set_dcc_mode(target, DSCR_EXT_DCC_STALL_MODE, &dscr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	while (count > 0) {
+		uint32_t batch = MIN(count, CORTEX_A_DPM_BATCH_INSTR);
+
+		for (uint32_t i = 0; i < batch; i++) {
+			/* DCCRX to R0, then the opcode */
+			retval = mem_ap_write_u32(armv7a->debug_ap,
+					armv7a->debug_base + CPUDBG_DTRRX, data);
+			if (retval == ERROR_OK)
+				retval = mem_ap_write_u32(armv7a->debug_ap,
+						armv7a->debug_base + CPUDBG_ITR,
+						ARMV4_5_MRC(14, 0, 0, 0, 5, 0));
+			if (retval == ERROR_OK)
+				retval = mem_ap_write_u32(armv7a->debug_ap,
+						armv7a->debug_base + CPUDBG_ITR, opcode);
+			if (retval != ERROR_OK)
+				break;
+			data += step;
+		}
+		if (retval == ERROR_OK)
+			retval = dap_run(armv7a->debug_ap->dap);
+		if (retval != ERROR_OK)
+			break;
+
+		armv7a->armv7a_mmu.armv7a_cache.maint_flushes++;
+		count -= batch;
+		keep_alive();
+	}
+
+	final_retval = retval;
+
+	retval = cortex_a_set_dcc_mode(target, DSCR_EXT_DCC_NON_BLOCKING, &dscr);
+	if (final_retval == ERROR_OK)
+		final_retval = retval;
+
+	/* restore the DPM invariant */
+	retval = cortex_a_wait_instrcmpl(target, &dscr, true);
+	if (final_retval == ERROR_OK)
+		final_retval = retval;
+
+	if (dscr & (DSCR_STICKY_ABORT_PRECISE | DSCR_STICKY_ABORT_IMPRECISE)) {
+		LOG_ERROR("abort during queued instructions, dscr = 0x%08" PRIx32, dscr);
+		mem_ap_write_atomic_u32(armv7a->debug_ap,
+				armv7a->debug_base + CPUDBG_DRCR, DRCR_CLEAR_EXCEPTIONS);
+		if (final_retval == ERROR_OK)
+			final_retval = ERROR_TARGET_DATA_ABORT;
+	}
+
+	return final_retval;
+}
+
 static int cortex_a_instr_cpsr_sync(struct arm_dpm *dpm)
 {
 	struct target *target = dpm->arm->target;
@@ -607,6 +681,7 @@ static int cortex_a_dpm_setup(struct cortex_a_common *a, uint32_t didr)
 
 	dpm->instr_write_data_dcc = cortex_a_instr_write_data_dcc;
 	dpm->instr_write_data_r0 = cortex_a_instr_write_data_r0;
+	dpm->instr_write_data_r0_range = cortex_a_instr_write_data_r0_range;
 	dpm->instr_cpsr_sync = cortex_a_instr_cpsr_sync;
 
 	dpm->instr_read_data_dcc = cortex_a_instr_read_data_dcc;
@@ -635,22 +710,117 @@ static struct target *get_cortex_a(struct target *target, int32_t coreid)
 	}
 	return target;
 }
-static int cortex_a_halt(struct target *target);
+/*
+ * Runs the debug register accesses queued for the cores of an SMP group,
+ * flushing each DAP once, so that the cost does not grow with the number
+ * of cores.
+ */
+static int cortex_a_dap_run_smp(struct target *target)
+{
+	struct target_list *head, *prev;
+	int retval = ERROR_OK;
+
+	foreach_smp_target(head, target->head) {
+		struct target *curr = head->target;
+		if (!target_was_examined(curr))
+			continue;
+
+		struct adiv5_dap *dap = target_to_armv7a(curr)->debug_ap->dap;
+		bool flushed = false;
+		foreach_smp_target(prev, target->head) {
+			if (prev == head)
+				break;
+			if (target_was_examined(prev->target)
+					&& target_to_armv7a(prev->target)->debug_ap->dap == dap) {
+				flushed = true;
+				break;
+			}
+		}
+		if (flushed)
+			continue;
+
+		int r = dap_run(dap);
+		if (retval == ERROR_OK)
+			retval = r;
+	}
+
+	return retval;
+}
+
+/*
+ * Waits until DSCR matches value under mask on every examined core of the
+ * SMP group but target. The DSCRs of all cores are sampled together.
+ */
+static int cortex_a_wait_dscr_smp(struct target *target, uint32_t mask,
+	uint32_t value)
+{
+	struct target_list *head;
+	int retval;
+
+	int64_t then = timeval_ms();
+	for (;;) {
+		foreach_smp_target(head, target->head) {
+			struct target *curr = head->target;
+			if (curr == target || !target_was_examined(curr))
+				continue;
+
+			struct cortex_a_common *cortex_a = target_to_cortex_a(curr);
+			retval = mem_ap_read_u32(cortex_a->armv7a_common.debug_ap,
+					cortex_a->armv7a_common.debug_base + CPUDBG_DSCR,
+					&cortex_a->cpudbg_dscr);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		retval = cortex_a_dap_run_smp(target);
+		if (retval != ERROR_OK)
+			return retval;
+
+		bool done = true;
+		foreach_smp_target(head, target->head) {
+			struct target *curr = head->target;
+			if (curr == target || !target_was_examined(curr))
+				continue;
+			if ((target_to_cortex_a(curr)->cpudbg_dscr & mask) != value) {
+				done = false;
+				break;
+			}
+		}
+		if (done)
+			return ERROR_OK;
+
+		if (timeval_ms() > then + 1000) {
+			LOG_ERROR("Timeout waiting for SMP group, dscr mask 0x%08" PRIx32, mask);
+			return ERROR_TARGET_TIMEOUT;
+		}
+	}
+}
 
 static int cortex_a_halt_smp(struct target *target)
 {
-	int retval = 0;
 	struct target_list *head;
-	struct target *curr;
-	head = target->head;
-	while (head != (struct target_list *)NULL) {
-		curr = head->target;
-		if ((curr != target) && (curr->state != TARGET_HALTED)
-			&& target_was_examined(curr))
-			retval += cortex_a_halt(curr);
-		head = head->next;
+	int retval;
+
+	/* send the halt requests of all the running cores in one go */
+	foreach_smp_target(head, target->head) {
+		struct target *curr = head->target;
+		if (curr == target || curr->state == TARGET_HALTED
+				|| !target_was_examined(curr))
+			continue;
+
+		struct armv7a_common *armv7a = target_to_armv7a(curr);
+		retval = mem_ap_write_u32(armv7a->debug_ap,
+				armv7a->debug_base + CPUDBG_DRCR, DRCR_HALT);
+		if (retval != ERROR_OK)
+			return retval;
+		curr->debug_reason = DBG_REASON_DBGRQ;
 	}
-	return retval;
+
+	retval = cortex_a_dap_run_smp(target);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return cortex_a_wait_dscr_smp(target, DSCR_CORE_HALTED, DSCR_CORE_HALTED);
 }
 
 static int update_halt_gdb(struct target *target)
@@ -934,24 +1104,91 @@ static int cortex_a_internal_restart(struct target *target)
 
 static int cortex_a_restore_smp(struct target *target, int handle_breakpoints)
 {
-	int retval = 0;
+	int retval = ERROR_OK;
 	struct target_list *head;
 	struct target *curr;
 	target_addr_t address;
-	head = target->head;
-	while (head != (struct target_list *)NULL) {
+
+	/* restoring a context runs the DAP queue, so do it for every core
+	 * before any restart is queued */
+	foreach_smp_target(head, target->head) {
 		curr = head->target;
-		if ((curr != target) && (curr->state != TARGET_RUNNING)
-			&& target_was_examined(curr)) {
-			/*  resume current address , not in step mode */
-			retval += cortex_a_internal_restore(curr, 1, &address,
-					handle_breakpoints, 0);
-			retval += cortex_a_internal_restart(curr);
-		}
-		head = head->next;
+		if ((curr == target) || (curr->state == TARGET_RUNNING)
+			|| !target_was_examined(curr))
+			continue;
 
+		/*  resume current address , not in step mode */
+		retval = cortex_a_internal_restore(curr, 1, &address,
+				handle_breakpoints, 0);
+		if (retval != ERROR_OK)
+			return retval;
 	}
-	return retval;
+
+	/* sample the DSCRs together, see cortex_a_internal_restart() */
+	foreach_smp_target(head, target->head) {
+		curr = head->target;
+		if ((curr == target) || (curr->state == TARGET_RUNNING)
+			|| !target_was_examined(curr))
+			continue;
+
+		struct cortex_a_common *cortex_a = target_to_cortex_a(curr);
+		retval = mem_ap_read_u32(cortex_a->armv7a_common.debug_ap,
+				cortex_a->armv7a_common.debug_base + CPUDBG_DSCR,
+				&cortex_a->cpudbg_dscr);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	retval = cortex_a_dap_run_smp(target);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* queue the restart of every core, then issue them together */
+	foreach_smp_target(head, target->head) {
+		curr = head->target;
+		if ((curr == target) || (curr->state == TARGET_RUNNING)
+			|| !target_was_examined(curr))
+			continue;
+
+		struct cortex_a_common *cortex_a = target_to_cortex_a(curr);
+		struct armv7a_common *armv7a = &cortex_a->armv7a_common;
+		uint32_t dscr = cortex_a->cpudbg_dscr;
+
+		if ((dscr & DSCR_INSTR_COMP) == 0)
+			LOG_ERROR("DSCR InstrCompl must be set before leaving debug!");
+
+		retval = mem_ap_write_u32(armv7a->debug_ap,
+				armv7a->debug_base + CPUDBG_DSCR, dscr & ~DSCR_ITR_EN);
+		if (retval == ERROR_OK)
+			retval = mem_ap_write_u32(armv7a->debug_ap,
+					armv7a->debug_base + CPUDBG_DRCR, DRCR_RESTART |
+					DRCR_CLEAR_EXCEPTIONS);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	retval = cortex_a_dap_run_smp(target);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cortex_a_wait_dscr_smp(target, DSCR_CORE_RESTARTED, DSCR_CORE_RESTARTED);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error waiting for resume");
+		return retval;
+	}
+
+	foreach_smp_target(head, target->head) {
+		curr = head->target;
+		if ((curr == target) || (curr->state == TARGET_RUNNING)
+			|| !target_was_examined(curr))
+			continue;
+
+		curr->debug_reason = DBG_REASON_NOTHALTED;
+		curr->state = TARGET_RUNNING;
+
+		/* registers are now invalid */
+		register_cache_invalidate(target_to_armv7a(curr)->arm.core_cache);
+	}
+
+	return ERROR_OK;
 }
 
 static int cortex_a_resume(struct target *target, int current,
@@ -1657,6 +1894,133 @@ static int cortex_a_remove_breakpoint(struct target *target, struct breakpoint *
 	return ERROR_OK;
 }
 
+static int cortex_a_breakpoint_cmp(const void *a, const void *b)
+{
+	const struct breakpoint *bp_a = *(const struct breakpoint * const *)a;
+	const struct breakpoint *bp_b = *(const struct breakpoint * const *)b;
+
+	if (bp_a->address != bp_b->address)
+		return bp_a->address < bp_b->address ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Insert or remove a set of software breakpoints. Every memory access on
+ * Cortex-A is a DCC sequence run by the core, so the breakpoints are still
+ * read and written one at a time. The cache maintenance is shared instead:
+ * it is done once for each run of adjacent cache lines holding breakpoints,
+ * rather than around every access. Breakpoints not handled here keep their
+ * state and are done one by one by the caller.
+ */
+static int cortex_a_patch_breakpoints(struct target *target,
+	struct breakpoint **breakpoints, unsigned int count, bool insert)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	struct armv7a_cache_common *armv7a_cache = &armv7a->armv7a_mmu.armv7a_cache;
+	uint32_t linelen = MAX(armv7a_cache->dminline, armv7a_cache->iminline);
+	struct breakpoint **bps;
+	unsigned int n = 0;
+	int retval = ERROR_OK;
+
+	/* caches not identified, maintenance is skipped anyway */
+	if (!linelen)
+		linelen = 4;
+
+	bps = malloc(count * sizeof(*bps));
+	if (!bps) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct breakpoint *breakpoint = breakpoints[i];
+
+		if (breakpoint->type != BKPT_SOFT || (breakpoint->set != 0) == insert)
+			continue;
+		bps[n++] = breakpoint;
+	}
+
+	/* breakpoints in the same or adjacent cache lines end up together */
+	qsort(bps, n, sizeof(*bps), cortex_a_breakpoint_cmp);
+
+	unsigned int first = 0;
+	while (first < n) {
+		uint32_t start = (bps[first]->address & 0xFFFFFFFE) & -linelen;
+		uint64_t end = start;
+		unsigned int last = first;
+
+		for (; last < n; last++) {
+			uint32_t address = bps[last]->address & 0xFFFFFFFE;
+			/* a Thumb-2 breakpoint (length 3) replaces four bytes */
+			uint32_t length = bps[last]->length == 2 ? 2 : 4;
+
+			if ((address & -linelen) > end)
+				break;
+			end = MAX(end, (((uint64_t)address + length - 1) | (linelen - 1)) + 1);
+		}
+		uint32_t size = end - start;
+
+		/* make sure data cache is cleaned & invalidated down to PoC */
+		armv7a_cache_flush_virt(target, start, size);
+
+		for (unsigned int i = first; i < last; i++) {
+			struct breakpoint *breakpoint = bps[i];
+			uint32_t address = breakpoint->address & 0xFFFFFFFE;
+			uint8_t code[4];
+			int r;
+
+			if (!insert) {
+				/* restore original instruction (kept in target endianness) */
+				r = cortex_a_write_memory_no_flush(target, address,
+						breakpoint->length == 4 ? 4 : 2, 1,
+						breakpoint->orig_instr);
+				if (r == ERROR_OK)
+					breakpoint->set = 0;
+			} else {
+				/* same encodings as cortex_a_set_breakpoint() */
+				if (breakpoint->length == 2)
+					buf_set_u32(code, 0, 32, ARMV5_T_BKPT(0x11));
+				else if (breakpoint->length == 3) {
+					buf_set_u32(code, 0, 32, ARMV5_T_BKPT(0x11));
+					breakpoint->length = 4;
+				} else
+					buf_set_u32(code, 0, 32, ARMV5_BKPT(0x11));
+
+				r = target_read_memory(target, address,
+						breakpoint->length, 1, breakpoint->orig_instr);
+				if (r == ERROR_OK)
+					r = cortex_a_write_memory_no_flush(target, address,
+							breakpoint->length, 1, code);
+				if (r == ERROR_OK)
+					breakpoint->set = 0x11;	/* Any nice value but 0 */
+			}
+			if (r != ERROR_OK)
+				retval = r;
+		}
+
+		/* update caches at the breakpoint locations */
+		armv7a_l1_d_cache_flush_virt(target, start, size);
+		armv7a_l1_i_cache_inval_virt(target, start, size);
+
+		first = last;
+	}
+
+	free(bps);
+	return retval;
+}
+
+static int cortex_a_add_breakpoints(struct target *target,
+	struct breakpoint **breakpoints, unsigned int count)
+{
+	return cortex_a_patch_breakpoints(target, breakpoints, count, true);
+}
+
+static int cortex_a_remove_breakpoints(struct target *target,
+	struct breakpoint **breakpoints, unsigned int count)
+{
+	return cortex_a_patch_breakpoints(target, breakpoints, count, false);
+}
+
 /*
  * Cortex-A Reset functions
  */
@@ -2013,9 +2377,31 @@ static int cortex_a_write_cpu_memory_fast(struct target *target,
 	if (retval != ERROR_OK)
 		return retval;
 
-	/* Transfer all the data and issue all the instructions. */
-	return mem_ap_write_buf_noincr(armv7a->debug_ap, buffer,
-			4, count, armv7a->debug_base + CPUDBG_DTRRX);
+	/* Transfer the data and issue the instructions in batches, checking the
+	 * sticky abort flags in between so that a fault does not stream the
+	 * rest of the buffer into a core that no longer executes them. */
+	while (count > 0) {
+		uint32_t batch = MIN(count, CORTEX_A_DCC_BATCH_WORDS);
+
+		retval = mem_ap_write_buf_noincr(armv7a->debug_ap, buffer,
+				4, batch, armv7a->debug_base + CPUDBG_DTRRX);
+		if (retval != ERROR_OK)
+			return retval;
+
+		buffer += batch * 4;
+		count -= batch;
+		if (!count)
+			break;
+
+		retval = mem_ap_read_atomic_u32(armv7a->debug_ap,
+				armv7a->debug_base + CPUDBG_DSCR, dscr);
+		if (retval != ERROR_OK)
+			return retval;
+		if (*dscr & (DSCR_STICKY_ABORT_PRECISE | DSCR_STICKY_ABORT_IMPRECISE))
+			return ERROR_OK; /* A data fault is not considered a system failure. */
+	}
+
+	return ERROR_OK;
 }
 
 static int cortex_a_write_cpu_memory(struct target *target,
@@ -2292,14 +2678,29 @@ static int cortex_a_read_cpu_memory_fast(struct target *target,
 		 * then reissues the read instruction to read the next word from
 		 * memory. The last read of DTRTX in this call reads the second-to-last
 		 * word from memory and issues the read instruction for the last word.
+		 * The sticky abort flags are checked once per batch.
 		 */
-		retval = mem_ap_read_buf_noincr(armv7a->debug_ap, buffer,
-				4, count, armv7a->debug_base + CPUDBG_DTRTX);
-		if (retval != ERROR_OK)
-			return retval;
+		while (count > 0) {
+			uint32_t batch = MIN(count, CORTEX_A_DCC_BATCH_WORDS);
 
-		/* Advance. */
-		buffer += count * 4;
+			retval = mem_ap_read_buf_noincr(armv7a->debug_ap, buffer,
+					4, batch, armv7a->debug_base + CPUDBG_DTRTX);
+			if (retval != ERROR_OK)
+				return retval;
+
+			/* Advance. */
+			buffer += batch * 4;
+			count -= batch;
+			if (!count)
+				break;
+
+			retval = mem_ap_read_atomic_u32(armv7a->debug_ap,
+					armv7a->debug_base + CPUDBG_DSCR, dscr);
+			if (retval != ERROR_OK)
+				return retval;
+			if (*dscr & (DSCR_STICKY_ABORT_PRECISE | DSCR_STICKY_ABORT_IMPRECISE))
+				return ERROR_OK; /* A data fault is not considered a system failure. */
+		}
 	}
 
 	/* Wait for last issued instruction to complete. */
@@ -2487,6 +2888,27 @@ out:
  * ap number for every access.
  */
 
+/*
+ * Physical memory can be accessed directly through a system bus MEM-AP,
+ * which runs at full DAP speed, as long as the data cache is off so the
+ * bus sees the same data as the core.
+ */
+static bool cortex_a_use_memory_ap(struct target *target, int phys_access)
+{
+	struct cortex_a_common *cortex_a = target_to_cortex_a(target);
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+
+	if (cortex_a->memory_ap_mode != CORTEX_A_MEMORY_AP_AUTO || !armv7a->memory_ap)
+		return false;
+	if (target->state != TARGET_HALTED)
+		return false;
+	if (armv7a->armv7a_mmu.armv7a_cache.d_u_cache_enabled)
+		return false;
+
+	/* virtual addresses are only physical ones with the MMU off */
+	return phys_access || armv7a->is_armv7r || !armv7a->armv7a_mmu.mmu_enabled;
+}
+
 static int cortex_a_read_phys_memory(struct target *target,
 	target_addr_t address, uint32_t size,
 	uint32_t count, uint8_t *buffer)
@@ -2499,6 +2921,10 @@ static int cortex_a_read_phys_memory(struct target *target,
 	LOG_DEBUG("Reading memory at real address " TARGET_ADDR_FMT "; size %" PRId32 "; count %" PRId32,
 		address, size, count);
 
+	if (cortex_a_use_memory_ap(target, 1))
+		return mem_ap_read_buf(target_to_armv7a(target)->memory_ap,
+				buffer, size, count, address);
+
 	/* read memory through the CPU */
 	cortex_a_prep_memaccess(target, 1);
 	retval = cortex_a_read_cpu_memory(target, address, size, count, buffer);
@@ -2516,6 +2942,10 @@ static int cortex_a_read_memory(struct target *target, target_addr_t address,
 	LOG_DEBUG("Reading memory at address " TARGET_ADDR_FMT "; size %" PRId32 "; count %" PRId32,
 		address, size, count);
 
+	if (cortex_a_use_memory_ap(target, 0))
+		return mem_ap_read_buf(target_to_armv7a(target)->memory_ap,
+				buffer, size, count, address);
+
 	cortex_a_prep_memaccess(target, 0);
 	retval = cortex_a_read_cpu_memory(target, address, size, count, buffer);
 	cortex_a_post_memaccess(target, 0);
@@ -2535,6 +2965,10 @@ static int cortex_a_write_phys_memory(struct target *target,
 	LOG_DEBUG("Writing memory to real address " TARGET_ADDR_FMT "; size %" PRId32 "; count %" PRId32,
 		address, size, count);
 
+	if (cortex_a_use_memory_ap(target, 1))
+		return mem_ap_write_buf(target_to_armv7a(target)->memory_ap,
+				buffer, size, count, address);
+
 	/* write memory through the CPU */
 	cortex_a_prep_memaccess(target, 1);
 	retval = cortex_a_write_cpu_memory(target, address, size, count, buffer);
@@ -2546,8 +2980,6 @@ static int cortex_a_write_phys_memory(struct target *target,
 static int cortex_a_write_memory(struct target *target, target_addr_t address,
 	uint32_t size, uint32_t count, const uint8_t *buffer)
 {
-	int retval;
-
 	/* cortex_a handles unaligned memory access */
 	LOG_DEBUG("Writing memory at address " TARGET_ADDR_FMT "; size %" PRId32 "; count %" PRId32,
 		address, size, count);
@@ -2555,6 +2987,19 @@ static int cortex_a_write_memory(struct target *target, target_addr_t address,
 	/* memory writes bypass the caches, must flush before writing */
 	armv7a_cache_auto_flush_on_write(target, address, size * count);
 
+	return cortex_a_write_memory_no_flush(target, address, size, count, buffer);
+}
+
+/* cortex_a_write_memory() for callers doing their own cache maintenance */
+static int cortex_a_write_memory_no_flush(struct target *target,
+	target_addr_t address, uint32_t size, uint32_t count, const uint8_t *buffer)
+{
+	int retval;
+
+	if (cortex_a_use_memory_ap(target, 0))
+		return mem_ap_write_buf(target_to_armv7a(target)->memory_ap,
+				buffer, size, count, address);
+
 	cortex_a_prep_memaccess(target, 0);
 	retval = cortex_a_write_cpu_memory(target, address, size, count, buffer);
 	cortex_a_post_memaccess(target, 0);
@@ -2695,6 +3140,20 @@ static int cortex_a_examine_first(struct target *target)
 
 	armv7a->debug_ap->memaccess_tck = 80;
 
+	/* A system bus MEM-AP is optional, it only speeds up memory access */
+	armv7a->memory_ap = NULL;
+	if (dap_find_ap(swjdp, AP_TYPE_AXI_AP, &armv7a->memory_ap) != ERROR_OK
+			&& dap_find_ap(swjdp, AP_TYPE_AHB3_AP, &armv7a->memory_ap) != ERROR_OK
+			&& dap_find_ap(swjdp, AP_TYPE_AHB5_AP, &armv7a->memory_ap) != ERROR_OK)
+		armv7a->memory_ap = NULL;
+	if (armv7a->memory_ap && mem_ap_init(armv7a->memory_ap) != ERROR_OK) {
+		LOG_WARNING("Could not initialize the system bus MEM-AP");
+		armv7a->memory_ap = NULL;
+	}
+	if (armv7a->memory_ap)
+		LOG_DEBUG("%s: using AP #%" PRIu8 " for direct memory access",
+				target_name(target), armv7a->memory_ap->ap_num);
+
 	if (!target->dbgbase_set) {
 		uint32_t dbgbase;
 		/* Get ROM Table base */
@@ -2863,6 +3322,7 @@ static int cortex_a_init_arch_info(struct target *target,
 
 	armv7a->armv7a_mmu.read_physical_memory = cortex_a_read_phys_memory;
 
+	cortex_a->memory_ap_mode = CORTEX_A_MEMORY_AP_OFF;
 
 /*	arm7_9->handle_target_request = cortex_a_handle_target_request; */
 
@@ -3059,6 +3519,31 @@ COMMAND_HANDLER(handle_cortex_a_dacrfixup_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_cortex_a_memory_ap_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct cortex_a_common *cortex_a = target_to_cortex_a(target);
+
+	static const Jim_Nvp nvp_memory_ap_modes[] = {
+		{ .name = "off", .value = CORTEX_A_MEMORY_AP_OFF },
+		{ .name = "auto", .value = CORTEX_A_MEMORY_AP_AUTO },
+		{ .name = NULL, .value = -1 },
+	};
+	const Jim_Nvp *n;
+
+	if (CMD_ARGC > 0) {
+		n = Jim_Nvp_name2value_simple(nvp_memory_ap_modes, CMD_ARGV[0]);
+		if (n->name == NULL)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		cortex_a->memory_ap_mode = n->value;
+	}
+
+	n = Jim_Nvp_value2name_simple(nvp_memory_ap_modes, cortex_a->memory_ap_mode);
+	command_print(CMD, "cortex_a memory access through the system bus %s", n->name);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration cortex_a_exec_command_handlers[] = {
 	{
 		.name = "cache_info",
@@ -3089,6 +3574,14 @@ static const struct command_registration cortex_a_exec_command_handlers[] = {
 			"on memory access",
 		.usage = "['on'|'off']",
 	},
+	{
+		.name = "memory_ap",
+		.handler = handle_cortex_a_memory_ap_command,
+		.mode = COMMAND_ANY,
+		.help = "access memory through the system bus MEM-AP "
+			"while the data cache is off",
+		.usage = "['auto'|'off']",
+	},
 	{
 		.chain = armv7a_mmu_command_handlers,
 	},
@@ -3148,6 +3641,8 @@ struct target_type cortexa_target = {
 	.add_context_breakpoint = cortex_a_add_context_breakpoint,
 	.add_hybrid_breakpoint = cortex_a_add_hybrid_breakpoint,
 	.remove_breakpoint = cortex_a_remove_breakpoint,
+	.add_breakpoints = cortex_a_add_breakpoints,
+	.remove_breakpoints = cortex_a_remove_breakpoints,
 	.add_watchpoint = NULL,
 	.remove_watchpoint = NULL,
 
@@ -3225,6 +3720,8 @@ struct target_type cortexr4_target = {
 	.add_context_breakpoint = cortex_a_add_context_breakpoint,
 	.add_hybrid_breakpoint = cortex_a_add_hybrid_breakpoint,
 	.remove_breakpoint = cortex_a_remove_breakpoint,
+	.add_breakpoints = cortex_a_add_breakpoints,
+	.remove_breakpoints = cortex_a_remove_breakpoints,
 	.add_watchpoint = NULL,
 	.remove_watchpoint = NULL,
 
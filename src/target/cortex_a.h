@@ -63,6 +63,17 @@ enum cortex_a_dacrfixup_mode {
 	CORTEX_A_DACRFIXUP_ON
 };
 
+enum cortex_a_memory_ap_mode {
+	CORTEX_A_MEMORY_AP_OFF,
+	CORTEX_A_MEMORY_AP_AUTO,
+};
+
+/* words moved through the DCC between two checks of the sticky aborts */
+#define CORTEX_A_DCC_BATCH_WORDS 4096
+
+/* instructions queued in stall mode per dap_run() */
+#define CORTEX_A_DPM_BATCH_INSTR 1024
+
 struct cortex_a_brp {
 	int used;
 	int type;
@@ -98,6 +109,7 @@ struct cortex_a_common {
 
 	enum cortex_a_isrmasking_mode isrmasking_mode;
 	enum cortex_a_dacrfixup_mode dacrfixup_mode;
+	enum cortex_a_memory_ap_mode memory_ap_mode;
 
 	struct armv7a_common armv7a_common;
 
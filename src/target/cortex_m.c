@@ -568,6 +568,8 @@ static int cortex_m_poll(struct target *target)
 		target->state = TARGET_UNKNOWN;
 		return retval;
 	}
+	cortex_m->dcb_dhcsr |= cortex_m->dcb_dhcsr_sticky;
+	cortex_m->dcb_dhcsr_sticky = 0;
 
 	/* Recover from lockup.  See ARMv7-M architecture spec,
 	 * section B1.5.15 "Unrecoverable exception cases".
@@ -765,11 +767,20 @@ static int cortex_m_soft_reset_halt(struct target *target)
 	return ERROR_OK;
 }
 
+static int cortex_m_patch_breakpoints(struct target *target,
+	struct breakpoint **breakpoints, unsigned int count, bool insert);
+
 void cortex_m_enable_breakpoints(struct target *target)
 {
+	struct armv7m_common *armv7m = target_to_armv7m(target);
 	struct breakpoint *breakpoint = target->breakpoints;
 
-	/* set any pending breakpoints */
+	/* set any pending software breakpoints together (hla has no AP) ... */
+	if (armv7m->debug_ap && target->breakpoint_count > 1)
+		cortex_m_patch_breakpoints(target, target->breakpoint_index,
+			target->breakpoint_count, true);
+
+	/* ... and whatever is left one by one */
 	while (breakpoint) {
 		if (!breakpoint->set)
 			cortex_m_set_breakpoint(target, breakpoint);
@@ -1393,6 +1404,178 @@ int cortex_m_remove_breakpoint(struct target *target, struct breakpoint *breakpo
 	return cortex_m_unset_breakpoint(target, breakpoint);
 }
 
+static int cortex_m_breakpoint_cmp(const void *a, const void *b)
+{
+	const struct breakpoint *bp_a = *(const struct breakpoint * const *)a;
+	const struct breakpoint *bp_b = *(const struct breakpoint * const *)b;
+
+	if (bp_a->address != bp_b->address)
+		return bp_a->address < bp_b->address ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Insert or remove a set of software breakpoints with one queued run to
+ * read the words holding them and a second one to write them back, rather
+ * than two runs per breakpoint. Whole words are accessed so that the reads
+ * can be queued; the core is halted, so a neighbouring halfword is written
+ * back unchanged. Breakpoints not handled here keep their state and are
+ * done one by one by the caller.
+ */
+static int cortex_m_patch_breakpoints(struct target *target,
+	struct breakpoint **breakpoints, unsigned int count, bool insert)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct adiv5_ap *ap = armv7m->debug_ap;
+	struct breakpoint **bps;
+	uint32_t *orig, *words;
+	unsigned int n = 0;
+	int retval = ERROR_OK;
+
+	bps = malloc(count * sizeof(*bps));
+	orig = malloc(count * sizeof(*orig));
+	words = malloc(count * sizeof(*words));
+	if (!bps || !orig || !words) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct breakpoint *breakpoint = breakpoints[i];
+
+		if (breakpoint->type != BKPT_SOFT)
+			continue;
+		if (insert) {
+			if (breakpoint->set)
+				continue;
+			if (breakpoint->length == 3) {
+				LOG_DEBUG("Using a two byte breakpoint for 32bit Thumb-2 request");
+				breakpoint->length = 2;
+			}
+			/* reported by cortex_m_add_breakpoint() */
+			if (breakpoint->length != 2)
+				continue;
+		} else if (!breakpoint->set)
+			continue;
+		bps[n++] = breakpoint;
+	}
+	if (!n)
+		goto out;
+
+	/* breakpoints sharing a word end up next to each other */
+	qsort(bps, n, sizeof(*bps), cortex_m_breakpoint_cmp);
+
+	/* words[i] is only used for the first breakpoint of each word */
+	for (unsigned int i = 0; i < n; i++) {
+		uint32_t address = bps[i]->address & ~0x3u;
+
+		if (i > 0 && (bps[i - 1]->address & ~0x3u) == address)
+			continue;
+		retval = mem_ap_read_u32(ap, address, &orig[i]);
+		if (retval != ERROR_OK)
+			goto out;
+	}
+	retval = dap_run(ap->dap);
+	if (retval != ERROR_OK)
+		goto out;
+
+	unsigned int first = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		unsigned int shift = 8 * (bps[i]->address & 0x2);
+		uint32_t halfword;
+
+		if (i == 0 || (bps[i - 1]->address & ~0x3u) != (bps[i]->address & ~0x3u)) {
+			first = i;
+			words[first] = orig[first];
+		}
+
+		if (insert) {
+			/* NOTE: BKPT(0xab) is used for semihosting, see
+			 * cortex_m_set_breakpoint() */
+			h_u16_to_le(bps[i]->orig_instr, orig[first] >> shift);
+			halfword = ARMV5_T_BKPT(0x11) & 0xffff;
+		} else
+			halfword = le_to_h_u16(bps[i]->orig_instr);
+
+		words[first] &= ~(0xffffu << shift);
+		words[first] |= halfword << shift;
+
+		if (i + 1 == n || (bps[i + 1]->address & ~0x3u) != (bps[i]->address & ~0x3u)) {
+			retval = mem_ap_write_u32(ap, bps[i]->address & ~0x3u, words[first]);
+			if (retval != ERROR_OK)
+				goto out;
+		}
+	}
+	retval = dap_run(ap->dap);
+	if (retval != ERROR_OK) {
+		if (insert) {
+			/* don't leave BKPTs behind that no breakpoint owns */
+			for (unsigned int i = 0; i < n; i++)
+				if (i == 0 || (bps[i - 1]->address & ~0x3u) != (bps[i]->address & ~0x3u))
+					mem_ap_write_u32(ap, bps[i]->address & ~0x3u, orig[i]);
+			dap_run(ap->dap);
+		}
+		goto out;
+	}
+
+	for (unsigned int i = 0; i < n; i++) {
+		bps[i]->set = insert;
+		LOG_DEBUG("BPID: %" PRIu32 ", Type: %d, Address: " TARGET_ADDR_FMT " Length: %d (set=%d)",
+			bps[i]->unique_id,
+			(int)(bps[i]->type),
+			bps[i]->address,
+			bps[i]->length,
+			bps[i]->set);
+	}
+
+out:
+	free(words);
+	free(orig);
+	free(bps);
+	return retval;
+}
+
+static int cortex_m_add_breakpoints(struct target *target,
+	struct breakpoint **breakpoints, unsigned int count)
+{
+	return cortex_m_patch_breakpoints(target, breakpoints, count, true);
+}
+
+static int cortex_m_remove_breakpoints(struct target *target,
+	struct breakpoint **breakpoints, unsigned int count)
+{
+	return cortex_m_patch_breakpoints(target, breakpoints, count, false);
+}
+
+static int cortex_m_write_u32_list(struct target *target,
+	const target_addr_t *addresses, const uint32_t *values, unsigned int count)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct adiv5_ap *ap = armv7m->debug_ap;
+	bool queue = ap && target->endianness == TARGET_LITTLE_ENDIAN;
+	int retval;
+
+	for (unsigned int i = 0; i < count && queue; i++)
+		queue = !(addresses[i] & 0x3);
+
+	if (!queue) {
+		for (unsigned int i = 0; i < count; i++) {
+			retval = target_write_u32(target, addresses[i], values[i]);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		return ERROR_OK;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		retval = mem_ap_write_u32(ap, addresses[i], values[i]);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	return dap_run(ap->dap);
+}
+
 int cortex_m_set_watchpoint(struct target *target, struct watchpoint *watchpoint)
 {
 	int dwt_num = 0;
@@ -1672,6 +1855,102 @@ static int cortex_m_load_core_reg_u32(struct target *target,
 	return ERROR_OK;
 }
 
+/**
+ * Read several core registers with a single run of the DAP queue. Each
+ * DCRSR write is followed by reads of DHCSR and DCRDR; registers whose
+ * transfer had not completed (S_REGRDY clear) are read again one by one.
+ */
+static int cortex_m_load_core_regs_u32(struct target *target,
+		const uint32_t *num, uint32_t *value, unsigned count)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	int retval = ERROR_OK;
+
+	/* the emulated DCC channel needs DCRDR saved around each access */
+	if (target->dbg_msg_enabled) {
+		for (unsigned i = 0; i < count && retval == ERROR_OK; i++)
+			retval = cortex_m_load_core_reg_u32(target, num[i], &value[i]);
+		return retval;
+	}
+
+	uint32_t *dhcsr = malloc(count * sizeof(uint32_t));
+	if (!dhcsr)
+		return ERROR_FAIL;
+
+	for (unsigned i = 0; i < count && retval == ERROR_OK; i++) {
+		uint32_t selector;
+
+		switch (num[i]) {
+			case 0 ... 18:
+				selector = num[i];
+				break;
+			case ARMV7M_FPSCR:
+				selector = 0x21;
+				break;
+			case ARMV7M_S0 ... ARMV7M_S31:
+				selector = num[i] - ARMV7M_S0 + 0x40;
+				break;
+			case ARMV7M_PRIMASK:
+			case ARMV7M_BASEPRI:
+			case ARMV7M_FAULTMASK:
+			case ARMV7M_CONTROL:
+				selector = 20;
+				break;
+			default:
+				free(dhcsr);
+				return ERROR_COMMAND_SYNTAX_ERROR;
+		}
+
+		retval = mem_ap_write_u32(armv7m->debug_ap, DCB_DCRSR, selector);
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(armv7m->debug_ap, DCB_DHCSR, &dhcsr[i]);
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(armv7m->debug_ap, DCB_DCRDR, &value[i]);
+	}
+
+	if (retval == ERROR_OK)
+		retval = dap_run(armv7m->debug_ap->dap);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("JTAG failure %i", retval);
+		free(dhcsr);
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	/* reading DHCSR cleared its sticky bits, keep them for cortex_m_poll() */
+	for (unsigned i = 0; i < count; i++) {
+		cortex_m->dcb_dhcsr |= dhcsr[i] & (S_RESET_ST | S_RETIRE_ST);
+		cortex_m->dcb_dhcsr_sticky |= dhcsr[i] & (S_RESET_ST | S_RETIRE_ST);
+	}
+
+	for (unsigned i = 0; i < count && retval == ERROR_OK; i++) {
+		if (!(dhcsr[i] & S_REGRDY)) {
+			retval = cortex_m_load_core_reg_u32(target, num[i], &value[i]);
+			continue;
+		}
+
+		switch (num[i]) {
+			case ARMV7M_PRIMASK:
+				value[i] = buf_get_u32((uint8_t *)&value[i], 0, 1);
+				break;
+			case ARMV7M_BASEPRI:
+				value[i] = buf_get_u32((uint8_t *)&value[i], 8, 8);
+				break;
+			case ARMV7M_FAULTMASK:
+				value[i] = buf_get_u32((uint8_t *)&value[i], 16, 1);
+				break;
+			case ARMV7M_CONTROL:
+				value[i] = buf_get_u32((uint8_t *)&value[i], 24, 2);
+				break;
+		}
+
+		LOG_DEBUG("load from core reg %i value 0x%" PRIx32, (int)num[i], value[i]);
+	}
+
+	free(dhcsr);
+	return retval;
+}
+
 static int cortex_m_store_core_reg_u32(struct target *target,
 		uint32_t num, uint32_t value)
 {
@@ -1804,6 +2083,7 @@ void cortex_m_deinit_target(struct target *target)
 
 	cortex_m_dwt_free(target);
 	armv7m_free_reg_cache(target);
+	armv7m_trace_free(target);
 
 	free(target->private_config);
 	free(cortex_m);
@@ -2387,6 +2667,7 @@ static int cortex_m_init_arch_info(struct target *target,
 	armv7m->pre_restore_context = NULL;
 
 	armv7m->load_core_reg_u32 = cortex_m_load_core_reg_u32;
+	armv7m->load_core_regs_u32 = cortex_m_load_core_regs_u32;
 	armv7m->store_core_reg_u32 = cortex_m_store_core_reg_u32;
 
 	target_register_timer_callback(cortex_m_handle_target_request, 1,
@@ -2666,6 +2947,7 @@ struct target_type cortexm_target = {
 
 	.read_memory = cortex_m_read_memory,
 	.write_memory = cortex_m_write_memory,
+	.write_u32_list = cortex_m_write_u32_list,
 	.checksum_memory = armv7m_checksum_memory,
 	.blank_check_memory = armv7m_blank_check_memory,
 
@@ -2675,6 +2957,8 @@ struct target_type cortexm_target = {
 
 	.add_breakpoint = cortex_m_add_breakpoint,
 	.remove_breakpoint = cortex_m_remove_breakpoint,
+	.add_breakpoints = cortex_m_add_breakpoints,
+	.remove_breakpoints = cortex_m_remove_breakpoints,
 	.add_watchpoint = cortex_m_add_watchpoint,
 	.remove_watchpoint = cortex_m_remove_watchpoint,
 
@@ -33,6 +33,10 @@
 #include "target.h"
 #include <helper/log.h>
 
+#ifndef NT_GNU_BUILD_ID
+#define NT_GNU_BUILD_ID		3
+#endif
+
 /* convert ELF header field to host endianness */
 #define field16(elf, field) \
 	((elf->endianness == ELFDATA2LSB) ? \
@@ -520,6 +524,191 @@ static int image_elf_read_section(struct image *image,
 	return ERROR_OK;
 }
 
+static int image_elf_read_at(struct image_elf *elf, uint32_t offset,
+	uint32_t size, void *buffer)
+{
+	size_t read_bytes;
+
+	int retval = fileio_seek(elf->fileio, offset);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = fileio_read(elf->fileio, size, buffer, &read_bytes);
+	if (retval != ERROR_OK)
+		return retval;
+	if (read_bytes != size)
+		return ERROR_FILEIO_OPERATION_FAILED;
+
+	return ERROR_OK;
+}
+
+static int image_elf_read_section_headers(struct image_elf *elf)
+{
+	if (elf->sections)
+		return ERROR_OK;
+
+	uint32_t count = field16(elf, elf->header->e_shnum);
+	if (count == 0 || field16(elf, elf->header->e_shentsize) != sizeof(Elf32_Shdr)) {
+		LOG_DEBUG("ELF file has no usable section headers");
+		return ERROR_IMAGE_FORMAT_ERROR;
+	}
+
+	elf->sections = malloc(count * sizeof(Elf32_Shdr));
+	if (!elf->sections) {
+		LOG_ERROR("insufficient memory to perform operation ");
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+
+	int retval = image_elf_read_at(elf, field32(elf, elf->header->e_shoff),
+			count * sizeof(Elf32_Shdr), elf->sections);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("cannot read ELF section headers");
+		free(elf->sections);
+		elf->sections = NULL;
+		return retval;
+	}
+	elf->section_count = count;
+
+	return ERROR_OK;
+}
+
+/* read the contents of a section, the caller frees them */
+static uint8_t *image_elf_load_section(struct image_elf *elf, Elf32_Shdr *section)
+{
+	uint32_t offset = field32(elf, section->sh_offset);
+	uint32_t size = field32(elf, section->sh_size);
+	size_t filesize;
+
+	if (fileio_size(elf->fileio, &filesize) != ERROR_OK)
+		return NULL;
+	if (offset > filesize || size > filesize - offset) {
+		LOG_ERROR("ELF section content beyond end of file");
+		return NULL;
+	}
+
+	uint8_t *data = malloc((size_t)size + 1);
+	if (!data) {
+		LOG_ERROR("insufficient memory to perform operation ");
+		return NULL;
+	}
+
+	if (image_elf_read_at(elf, offset, size, data) != ERROR_OK) {
+		LOG_ERROR("cannot read ELF section content");
+		free(data);
+		return NULL;
+	}
+	/* keeps string tables terminated */
+	data[size] = 0;
+
+	return data;
+}
+
+int image_elf_for_each_symbol(struct image *image,
+	image_symbol_handler_t handler, void *priv)
+{
+	if (image->type != IMAGE_ELF)
+		return ERROR_IMAGE_TYPE_UNKNOWN;
+
+	struct image_elf *elf = image->type_private;
+	int retval = image_elf_read_section_headers(elf);
+	if (retval != ERROR_OK)
+		return retval;
+
+	Elf32_Shdr *symtab = NULL;
+	for (uint32_t i = 0; i < elf->section_count; i++) {
+		if (field32(elf, elf->sections[i].sh_type) == SHT_SYMTAB) {
+			symtab = &elf->sections[i];
+			break;
+		}
+	}
+
+	uint32_t strtab_index = symtab ? field32(elf, symtab->sh_link) : 0;
+	if (!symtab || strtab_index >= elf->section_count) {
+		LOG_DEBUG("ELF file has no symbol table");
+		return ERROR_IMAGE_FORMAT_ERROR;
+	}
+	if (field32(elf, symtab->sh_entsize) != sizeof(Elf32_Sym)) {
+		LOG_ERROR("ELF symbol table has unexpected entry size");
+		return ERROR_IMAGE_FORMAT_ERROR;
+	}
+	Elf32_Shdr *strtab = &elf->sections[strtab_index];
+	uint32_t strtab_size = field32(elf, strtab->sh_size);
+
+	uint8_t *symbols = image_elf_load_section(elf, symtab);
+	uint8_t *strings = image_elf_load_section(elf, strtab);
+	if (!symbols || !strings) {
+		free(symbols);
+		free(strings);
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+
+	uint32_t count = field32(elf, symtab->sh_size) / sizeof(Elf32_Sym);
+	for (uint32_t i = 0; i < count && retval == ERROR_OK; i++) {
+		Elf32_Sym *sym = (Elf32_Sym *)symbols + i;
+		uint32_t name = field32(elf, sym->st_name);
+
+		if (name == 0 || name >= strtab_size ||
+				field16(elf, sym->st_shndx) == SHN_UNDEF ||
+				ELF32_ST_TYPE(sym->st_info) == STT_SECTION ||
+				ELF32_ST_TYPE(sym->st_info) == STT_FILE)
+			continue;
+
+		retval = handler((char *)strings + name, field32(elf, sym->st_value), priv);
+	}
+
+	free(symbols);
+	free(strings);
+	return retval;
+}
+
+int image_elf_build_id(struct image *image, uint8_t *build_id, size_t *size)
+{
+	if (image->type != IMAGE_ELF)
+		return ERROR_IMAGE_TYPE_UNKNOWN;
+
+	struct image_elf *elf = image->type_private;
+	int retval = image_elf_read_section_headers(elf);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (uint32_t i = 0; i < elf->section_count; i++) {
+		if (field32(elf, elf->sections[i].sh_type) != SHT_NOTE)
+			continue;
+
+		uint32_t notes_size = field32(elf, elf->sections[i].sh_size);
+		uint8_t *notes = image_elf_load_section(elf, &elf->sections[i]);
+		if (!notes)
+			return ERROR_FILEIO_OPERATION_FAILED;
+
+		/* name and descriptor are each padded to four bytes */
+		uint32_t offset = 0;
+		while (offset + sizeof(Elf32_Nhdr) <= notes_size) {
+			Elf32_Nhdr *note = (Elf32_Nhdr *)(notes + offset);
+			uint32_t namesz = field32(elf, note->n_namesz);
+			uint32_t descsz = field32(elf, note->n_descsz);
+			uint32_t name = offset + sizeof(Elf32_Nhdr);
+			uint32_t desc = name + ((namesz + 3) & ~3);
+
+			if (desc < name || desc + descsz < desc || desc + descsz > notes_size)
+				break;
+
+			if (field32(elf, note->n_type) == NT_GNU_BUILD_ID && namesz == 4 &&
+					!memcmp(notes + name, "GNU", 4) &&
+					descsz > 0 && descsz <= IMAGE_BUILD_ID_MAX_SIZE) {
+				memcpy(build_id, notes + desc, descsz);
+				*size = descsz;
+				free(notes);
+				return ERROR_OK;
+			}
+
+			offset = desc + ((descsz + 3) & ~3);
+		}
+		free(notes);
+	}
+
+	return ERROR_FAIL;
+}
+
 static int image_mot_buffer_complete_inner(struct image *image,
 	char *lpszLine,
 	struct imagesection *section)
@@ -772,6 +961,8 @@ int image_open(struct image *image, const char *url, const char *type_string)
 		struct image_elf *image_elf;
 
 		image_elf = image->type_private = malloc(sizeof(struct image_elf));
+		image_elf->sections = NULL;
+		image_elf->section_count = 0;
 
 		retval = fileio_open(&image_elf->fileio, url, FILEIO_READ, FILEIO_BINARY);
 		if (retval != ERROR_OK)
@@ -1002,6 +1193,9 @@ void image_close(struct image *image)
 			free(image_elf->segments);
 			image_elf->segments = NULL;
 		}
+
+		free(image_elf->sections);
+		image_elf->sections = NULL;
 	} else if (image->type == IMAGE_MEMORY) {
 		struct image_memory *image_memory = image->type_private;
 
@@ -83,6 +83,9 @@ struct image_elf {
 	Elf32_Ehdr *header;
 	Elf32_Phdr *segments;
 	uint32_t segment_count;
+	/* section headers, only read when needed */
+	Elf32_Shdr *sections;
+	uint32_t section_count;
 	uint8_t endianness;
 };
 
@@ -102,6 +105,19 @@ int image_add_section(struct image *image, uint32_t base, uint32_t size,
 int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes,
 		uint32_t *checksum);
 
+/** Largest GNU build-id returned by image_elf_build_id(). */
+#define IMAGE_BUILD_ID_MAX_SIZE		(64)
+
+/**
+ * Called for each defined symbol of an ELF image, local symbols first.
+ * Returning anything but ERROR_OK stops the walk.
+ */
+typedef int (*image_symbol_handler_t)(const char *name, uint32_t value, void *priv);
+
+int image_elf_for_each_symbol(struct image *image,
+		image_symbol_handler_t handler, void *priv);
+int image_elf_build_id(struct image *image, uint8_t *build_id, size_t *size);
+
 #define ERROR_IMAGE_FORMAT_ERROR	(-1400)
 #define ERROR_IMAGE_TYPE_UNKNOWN	(-1401)
 #define ERROR_IMAGE_TEMPORARILY_UNAVAILABLE		(-1402)
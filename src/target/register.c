@@ -36,19 +36,166 @@
  * may be separate registers associated with debug or trace modules.
  */
 
-struct reg *register_get_by_number(struct reg_cache *first,
-		uint32_t reg_num, bool search_all)
+/**
+ * Hash index of the registers of a cache, by name and by number. Both tables
+ * use open addressing with linear probing and hold the position of the
+ * register in reg_list plus one, zero meaning an empty slot. Registers are
+ * inserted in reg_list order, so a probe finds duplicates in the same order
+ * as a linear search would.
+ */
+struct reg_cache_index {
+	/* reg_list and num_regs the index was built for */
+	struct reg *reg_list;
+	unsigned num_regs;
+	unsigned mask;
+	unsigned *by_name;
+	unsigned *by_number;
+};
+
+static unsigned register_hash_name(const char *name)
 {
-	unsigned i;
-	struct reg_cache *cache = first;
+	/* FNV-1a */
+	uint32_t hash = 2166136261u;
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
 
-	while (cache) {
-		for (i = 0; i < cache->num_regs; i++) {
+static unsigned register_hash_number(uint32_t number)
+{
+	return number * 2654435761u;
+}
+
+void register_cache_index_free(struct reg_cache *cache)
+{
+	if (!cache->index)
+		return;
+
+	free(cache->index->by_name);
+	free(cache->index->by_number);
+	free(cache->index);
+	cache->index = NULL;
+}
+
+/**
+ * Returns the index of the cache, building it on first use or when the
+ * register list has been replaced. Returns NULL if it can't be allocated,
+ * callers then fall back to a linear search.
+ */
+static struct reg_cache_index *register_cache_get_index(struct reg_cache *cache)
+{
+	struct reg_cache_index *index = cache->index;
+
+	if (index && index->reg_list == cache->reg_list && index->num_regs == cache->num_regs)
+		return index;
+
+	register_cache_index_free(cache);
+
+	if (!cache->reg_list || cache->num_regs == 0)
+		return NULL;
+
+	unsigned size = 16;
+	while (size < 2 * cache->num_regs)
+		size *= 2;
+
+	index = calloc(1, sizeof(*index));
+	if (!index)
+		return NULL;
+	index->by_name = calloc(size, sizeof(*index->by_name));
+	index->by_number = calloc(size, sizeof(*index->by_number));
+	if (!index->by_name || !index->by_number) {
+		free(index->by_name);
+		free(index->by_number);
+		free(index);
+		return NULL;
+	}
+
+	index->reg_list = cache->reg_list;
+	index->num_regs = cache->num_regs;
+	index->mask = size - 1;
+
+	for (unsigned i = 0; i < cache->num_regs; i++) {
+		struct reg *reg = &cache->reg_list[i];
+		unsigned slot;
+
+		if (reg->name) {
+			slot = register_hash_name(reg->name) & index->mask;
+			while (index->by_name[slot])
+				slot = (slot + 1) & index->mask;
+			index->by_name[slot] = i + 1;
+		}
+
+		slot = register_hash_number(reg->number) & index->mask;
+		while (index->by_number[slot])
+			slot = (slot + 1) & index->mask;
+		index->by_number[slot] = i + 1;
+	}
+
+	cache->index = index;
+	return index;
+}
+
+static struct reg *register_cache_get_by_number(struct reg_cache *cache, uint32_t reg_num)
+{
+	struct reg_cache_index *index = register_cache_get_index(cache);
+
+	if (!index) {
+		for (unsigned i = 0; i < cache->num_regs; i++) {
 			if (cache->reg_list[i].exist == false)
 				continue;
 			if (cache->reg_list[i].number == reg_num)
 				return &(cache->reg_list[i]);
 		}
+		return NULL;
+	}
+
+	unsigned slot = register_hash_number(reg_num) & index->mask;
+	while (index->by_number[slot]) {
+		struct reg *reg = &cache->reg_list[index->by_number[slot] - 1];
+		if (reg->exist && reg->number == reg_num)
+			return reg;
+		slot = (slot + 1) & index->mask;
+	}
+
+	return NULL;
+}
+
+static struct reg *register_cache_get_by_name(struct reg_cache *cache, const char *name)
+{
+	struct reg_cache_index *index = register_cache_get_index(cache);
+
+	if (!index) {
+		for (unsigned i = 0; i < cache->num_regs; i++) {
+			if (cache->reg_list[i].exist == false)
+				continue;
+			if (strcmp(cache->reg_list[i].name, name) == 0)
+				return &(cache->reg_list[i]);
+		}
+		return NULL;
+	}
+
+	unsigned slot = register_hash_name(name) & index->mask;
+	while (index->by_name[slot]) {
+		struct reg *reg = &cache->reg_list[index->by_name[slot] - 1];
+		if (reg->exist && strcmp(reg->name, name) == 0)
+			return reg;
+		slot = (slot + 1) & index->mask;
+	}
+
+	return NULL;
+}
+
+struct reg *register_get_by_number(struct reg_cache *first,
+		uint32_t reg_num, bool search_all)
+{
+	struct reg_cache *cache = first;
+
+	while (cache) {
+		struct reg *reg = register_cache_get_by_number(cache, reg_num);
+		if (reg)
+			return reg;
 
 		if (search_all)
 			cache = cache->next;
@@ -62,16 +209,12 @@ struct reg *register_get_by_number(struct reg_cache *first,
 struct reg *register_get_by_name(struct reg_cache *first,
 		const char *name, bool search_all)
 {
-	unsigned i;
 	struct reg_cache *cache = first;
 
 	while (cache) {
-		for (i = 0; i < cache->num_regs; i++) {
-			if (cache->reg_list[i].exist == false)
-				continue;
-			if (strcmp(cache->reg_list[i].name, name) == 0)
-				return &(cache->reg_list[i]);
-		}
+		struct reg *reg = register_cache_get_by_name(cache, name);
+		if (reg)
+			return reg;
 
 		if (search_all)
 			cache = cache->next;
@@ -95,12 +238,13 @@ struct reg_cache **register_get_last_cache_p(struct reg_cache **first)
 	return cache_p;
 }
 
-void register_unlink_cache(struct reg_cache **cache_p, const struct reg_cache *cache)
+void register_unlink_cache(struct reg_cache **cache_p, struct reg_cache *cache)
 {
 	while (*cache_p && *cache_p != cache)
 		cache_p = &((*cache_p)->next);
 	if (*cache_p)
 		*cache_p = cache->next;
+	register_cache_index_free(cache);
 }
 
 /** Marks the contents of the register cache as invalid (and clean). */
@@ -147,16 +147,25 @@ struct reg {
 	const struct reg_arch_type *type;
 };
 
+struct reg_cache_index;
+
 struct reg_cache {
 	const char *name;
 	struct reg_cache *next;
 	struct reg *reg_list;
 	unsigned num_regs;
+	/* Lookup index by name and number, built on first use. Must be NULL
+	 * when the cache is created, free it with register_cache_index_free(). */
+	struct reg_cache_index *index;
 };
 
 struct reg_arch_type {
 	int (*get)(struct reg *reg);
 	int (*set)(struct reg *reg, uint8_t *buf);
+	/* Optional: read several registers of this type, all belonging to the
+	 * same target, at once. Registers left invalid on return are read one
+	 * by one by the caller. */
+	int (*get_multiple)(struct reg **reg_list, unsigned num_regs);
 };
 
 struct reg *register_get_by_number(struct reg_cache *first,
@@ -164,8 +173,9 @@ struct reg *register_get_by_number(struct reg_cache *first,
 struct reg *register_get_by_name(struct reg_cache *first,
 		const char *name, bool search_all);
 struct reg_cache **register_get_last_cache_p(struct reg_cache **first);
-void register_unlink_cache(struct reg_cache **cache_p, const struct reg_cache *cache);
+void register_unlink_cache(struct reg_cache **cache_p, struct reg_cache *cache);
 void register_cache_invalidate(struct reg_cache *cache);
+void register_cache_index_free(struct reg_cache *cache);
 
 void register_init_dummy(struct reg *reg);
 
@@ -31,6 +31,7 @@ void riscv_batch_free(struct riscv_batch *batch)
 	free(batch->data_in);
 	free(batch->data_out);
 	free(batch->fields);
+	free(batch->read_keys);
 	free(batch);
 }
 
@@ -39,6 +40,11 @@ bool riscv_batch_full(struct riscv_batch *batch)
 	return batch->used_scans > (batch->allocated_scans - 4);
 }
 
+size_t riscv_batch_available_scans(struct riscv_batch *batch)
+{
+	return batch->allocated_scans - batch->used_scans - 4;
+}
+
 int riscv_batch_run(struct riscv_batch *batch)
 {
 	if (batch->used_scans == 0) {
@@ -47,6 +47,9 @@ void riscv_batch_free(struct riscv_batch *batch);
 /* Checks to see if this batch is full. */
 bool riscv_batch_full(struct riscv_batch *batch);
 
+/* Returns the number of scans that can still be added to this batch. */
+size_t riscv_batch_available_scans(struct riscv_batch *batch);
+
 /* Executes this scan batch. */
 int riscv_batch_run(struct riscv_batch *batch);
 
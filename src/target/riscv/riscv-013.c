@@ -1835,37 +1835,6 @@ static void log_memory_access(target_addr_t address, uint64_t value,
 	LOG_DEBUG(fmt, value);
 }
 
-/* Read the relevant sbdata regs depending on size, and put the results into
- * buffer. */
-static int read_memory_bus_word(struct target *target, target_addr_t address,
-		uint32_t size, uint8_t *buffer)
-{
-	uint32_t value;
-	if (size > 12) {
-		if (dmi_read(target, &value, DMI_SBDATA3) != ERROR_OK)
-			return ERROR_FAIL;
-		write_to_buf(buffer + 12, value, 4);
-		log_memory_access(address + 12, value, 4, true);
-	}
-	if (size > 8) {
-		if (dmi_read(target, &value, DMI_SBDATA2) != ERROR_OK)
-			return ERROR_FAIL;
-		write_to_buf(buffer + 8, value, 4);
-		log_memory_access(address + 8, value, 4, true);
-	}
-	if (size > 4) {
-		if (dmi_read(target, &value, DMI_SBDATA1) != ERROR_OK)
-			return ERROR_FAIL;
-		write_to_buf(buffer + 4, value, 4);
-		log_memory_access(address + 4, value, 4, true);
-	}
-	if (dmi_read(target, &value, DMI_SBDATA0) != ERROR_OK)
-		return ERROR_FAIL;
-	write_to_buf(buffer, value, MIN(size, 4));
-	log_memory_access(address, value, MIN(size, 4), true);
-	return ERROR_OK;
-}
-
 static uint32_t sb_sbaccess(unsigned size_bytes)
 {
 	switch (size_bytes) {
@@ -2014,8 +1983,102 @@ static int read_memory_bus_v0(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
+static int batch_run(const struct target *target, struct riscv_batch *batch)
+{
+	RISCV013_INFO(info);
+	RISCV_INFO(r);
+	if (r->reset_delays_wait >= 0) {
+		r->reset_delays_wait -= batch->used_scans;
+		if (r->reset_delays_wait <= 0) {
+			batch->idle_count = 0;
+			info->dmi_busy_delay = 0;
+			info->ac_busy_delay = 0;
+		}
+	}
+	return riscv_batch_run(batch);
+}
+
+/* Number of DMI scans queued in one batch by the system bus accesses. */
+#define SB_BATCH_SCANS		1024
+
+/* Number of SBDATA registers accessed for each word of the given size. */
+static unsigned sb_data_regs(uint32_t size)
+{
+	return size > 4 ? size / 4 : 1;
+}
+
+/**
+ * Recover from an error seen at the end of a system bus batch: reset the DMI
+ * if it reported busy, clear sbbusyerror and slow down the bus accesses.
+ * On return sbcs holds the state the error was found in. Returns ERROR_FAIL
+ * if the bus access itself failed.
+ */
+static int sb_batch_error(struct target *target, bool dmi_busy, uint32_t *sbcs,
+		bool read)
+{
+	RISCV013_INFO(info);
+
+	if (dmi_busy) {
+		/* The DMI ignored everything after the busy response. */
+		increase_dmi_busy_delay(target);
+		if (read_sbcs_nonbusy(target, sbcs) != ERROR_OK)
+			return ERROR_FAIL;
+	}
+
+	if (get_field(*sbcs, DMI_SBCS_SBERROR)) {
+		/* Some error indicating the bus access failed, but not because of
+		 * something we did wrong. */
+		dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
+		return ERROR_FAIL;
+	}
+
+	if (get_field(*sbcs, DMI_SBCS_SBBUSYERROR)) {
+		/* We accessed sbdata while the target was busy. Slow down. */
+		dmi_write(target, DMI_SBCS, DMI_SBCS_SBBUSYERROR);
+		if (read)
+			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
+		else
+			info->bus_master_write_delay += info->bus_master_write_delay / 10 + 1;
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Run a system bus batch whose last scan reads sbcs. Sets *dmi_busy if the
+ * DMI reported busy during the batch (the status is sticky, so it shows in
+ * the last read), otherwise returns the final sbcs in *sbcs, waiting for the
+ * bus if wait is set.
+ */
+static int sb_batch_run(struct target *target, struct riscv_batch *batch,
+		size_t sbcs_key, bool wait, bool *dmi_busy, uint32_t *sbcs)
+{
+	if (batch_run(target, batch) != ERROR_OK)
+		return ERROR_FAIL;
+
+	uint64_t dmi_out = riscv_batch_get_dmi_read(batch, sbcs_key);
+	dmi_status_t status = get_field(dmi_out, DTM_DMI_OP);
+	if (status == DMI_STATUS_FAILED) {
+		LOG_ERROR("System bus access failed with a DMI error.");
+		return ERROR_FAIL;
+	}
+
+	*dmi_busy = status == DMI_STATUS_BUSY;
+	*sbcs = get_field(dmi_out, DTM_DMI_DATA);
+	if (!*dmi_busy && wait && get_field(*sbcs, DMI_SBCS_SBBUSY))
+		return read_sbcs_nonbusy(target, sbcs);
+
+	return ERROR_OK;
+}
+
 /**
  * Read the requested memory using the system bus interface.
+ *
+ * The sbdata reads of many words are queued in one batch: with sbreadondata
+ * set, reading sbdata0 returns a word and starts the bus read of the next
+ * one, which gets bus_master_read_delay idle cycles to complete. sbcs is
+ * read at the end of every batch to catch sbbusyerror, in which case the
+ * delay is increased and the read restarted where the bus stopped.
  */
 static int read_memory_bus_v1(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, uint8_t *buffer)
@@ -2023,12 +2086,14 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 	RISCV013_INFO(info);
 	target_addr_t next_address = address;
 	target_addr_t end_address = address + count * size;
+	unsigned data_regs = sb_data_regs(size);
 
 	while (next_address < end_address) {
+		uint32_t start = (next_address - address) / size;
 		uint32_t sbcs = set_field(0, DMI_SBCS_SBREADONADDR, 1);
 		sbcs |= sb_sbaccess(size);
 		sbcs = set_field(sbcs, DMI_SBCS_SBAUTOINCREMENT, 1);
-		sbcs = set_field(sbcs, DMI_SBCS_SBREADONDATA, count > 1);
+		sbcs = set_field(sbcs, DMI_SBCS_SBREADONDATA, count - start > 1);
 		dmi_write(target, DMI_SBCS, sbcs);
 
 		/* This address write will trigger the first read. */
@@ -2042,57 +2107,91 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 			}
 		}
 
-		for (uint32_t i = (next_address - address) / size; i < count - 1; i++) {
-			read_memory_bus_word(target, address + i * size, size,
-					buffer + i * size);
-		}
+		bool restart = false;
+		while (!restart && start < count) {
+			struct riscv_batch *batch = riscv_batch_alloc(target, SB_BATCH_SCANS,
+					info->dmi_busy_delay + info->bus_master_read_delay);
+
+			uint32_t end = start;
+			while (end < count &&
+					riscv_batch_available_scans(batch) >= 2 * (data_regs + 2)) {
+				/* Don't start a bus read past the end. */
+				if (end == count - 1 && get_field(sbcs, DMI_SBCS_SBREADONDATA))
+					riscv_batch_add_dmi_write(batch, DMI_SBCS,
+							set_field(sbcs, DMI_SBCS_SBREADONDATA, 0));
+				for (unsigned j = data_regs; j > 0; j--)
+					riscv_batch_add_dmi_read(batch, DMI_SBDATA0 + j - 1);
+				end++;
+			}
+			size_t sbcs_key = riscv_batch_add_dmi_read(batch, DMI_SBCS);
 
-		sbcs = set_field(sbcs, DMI_SBCS_SBREADONDATA, 0);
-		dmi_write(target, DMI_SBCS, sbcs);
+			bool dmi_busy;
+			uint32_t batch_sbcs;
+			if (sb_batch_run(target, batch, sbcs_key, end == count,
+						&dmi_busy, &batch_sbcs) != ERROR_OK) {
+				riscv_batch_free(batch);
+				return ERROR_FAIL;
+			}
 
-		read_memory_bus_word(target, address + (count - 1) * size, size,
-				buffer + (count - 1) * size);
+			uint32_t valid_end = end;
+			if (dmi_busy) {
+				/* Keep the words read before the first busy response. */
+				size_t key = 0;
+				for (valid_end = start; valid_end < end; valid_end++) {
+					unsigned j;
+					for (j = 0; j < data_regs; j++) {
+						uint64_t dmi_out = riscv_batch_get_dmi_read(batch, key + j);
+						if (get_field(dmi_out, DTM_DMI_OP) != DMI_STATUS_SUCCESS)
+							break;
+					}
+					if (j < data_regs)
+						break;
+					key += data_regs;
+				}
+				restart = true;
+			} else if (get_field(batch_sbcs, DMI_SBCS_SBBUSYERROR) ||
+					get_field(batch_sbcs, DMI_SBCS_SBERROR)) {
+				restart = true;
+			}
 
-		if (read_sbcs_nonbusy(target, &sbcs) != ERROR_OK)
-			return ERROR_FAIL;
+			if (restart) {
+				if (sb_batch_error(target, dmi_busy, &batch_sbcs, true) != ERROR_OK) {
+					riscv_batch_free(batch);
+					return ERROR_FAIL;
+				}
+				if (get_field(batch_sbcs, DMI_SBCS_SBBUSYERROR)) {
+					/* sbaddress is one word past the read that was in
+					 * progress when sbdata0 was read too early. */
+					target_addr_t sbaddress = sb_read_address(target);
+					uint32_t busy_word = start;
+					if (sbaddress > next_address + size &&
+							sbaddress <= address + (end + 1) * size)
+						busy_word = (sbaddress - size - address) / size;
+					valid_end = MIN(valid_end, busy_word);
+				}
+			}
 
-		if (get_field(sbcs, DMI_SBCS_SBBUSYERROR)) {
-			/* We read while the target was busy. Slow down and try again. */
-			dmi_write(target, DMI_SBCS, DMI_SBCS_SBBUSYERROR);
-			next_address = sb_read_address(target);
-			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
-			continue;
-		}
+			size_t key = 0;
+			for (uint32_t i = start; i < valid_end; i++) {
+				for (unsigned j = data_regs; j > 0; j--) {
+					uint64_t dmi_out = riscv_batch_get_dmi_read(batch, key++);
+					uint32_t value = get_field(dmi_out, DTM_DMI_DATA);
+					unsigned offset = (j - 1) * 4;
+					write_to_buf(buffer + i * size + offset, value, MIN(size, 4));
+					log_memory_access(address + i * size + offset, value,
+							MIN(size, 4), true);
+				}
+			}
+			riscv_batch_free(batch);
 
-		unsigned error = get_field(sbcs, DMI_SBCS_SBERROR);
-		if (error == 0) {
-			next_address = end_address;
-		} else {
-			/* Some error indicating the bus access failed, but not because of
-			 * something we did wrong. */
-			dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
-			return ERROR_FAIL;
+			start = valid_end;
+			next_address = address + start * size;
 		}
 	}
 
 	return ERROR_OK;
 }
 
-static int batch_run(const struct target *target, struct riscv_batch *batch)
-{
-	RISCV013_INFO(info);
-	RISCV_INFO(r);
-	if (r->reset_delays_wait >= 0) {
-		r->reset_delays_wait -= batch->used_scans;
-		if (r->reset_delays_wait <= 0) {
-			batch->idle_count = 0;
-			info->dmi_busy_delay = 0;
-			info->ac_busy_delay = 0;
-		}
-	}
-	return riscv_batch_run(batch);
-}
-
 /**
  * Read the requested memory, taking care to execute every read exactly once,
  * even if cmderr=busy is encountered.
@@ -2494,78 +2593,70 @@ static int write_memory_bus_v0(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
+/**
+ * Write the requested memory using the system bus interface.
+ *
+ * The sbdata writes of many words are queued in one batch, writing sbdata0
+ * starts the bus write of a word. Each scan is followed by
+ * bus_master_write_delay idle cycles, and sbcs is read at the end of every
+ * batch to catch errors. On sbbusyerror the delay is increased and the write
+ * restarted from sbaddress, which only advances for completed writes.
+ */
 static int write_memory_bus_v1(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, const uint8_t *buffer)
 {
 	RISCV013_INFO(info);
-	uint32_t sbcs = sb_sbaccess(size);
-	sbcs = set_field(sbcs, DMI_SBCS_SBAUTOINCREMENT, 1);
-	dmi_write(target, DMI_SBCS, sbcs);
-
 	target_addr_t next_address = address;
 	target_addr_t end_address = address + count * size;
+	unsigned data_regs = sb_data_regs(size);
 
-	sb_write_address(target, next_address);
 	while (next_address < end_address) {
-		for (uint32_t i = (next_address - address) / size; i < count; i++) {
-			const uint8_t *p = buffer + i * size;
-			if (size > 12)
-				dmi_write(target, DMI_SBDATA3,
-						((uint32_t) p[12]) |
-						(((uint32_t) p[13]) << 8) |
-						(((uint32_t) p[14]) << 16) |
-						(((uint32_t) p[15]) << 24));
-			if (size > 8)
-				dmi_write(target, DMI_SBDATA2,
-						((uint32_t) p[8]) |
-						(((uint32_t) p[9]) << 8) |
-						(((uint32_t) p[10]) << 16) |
-						(((uint32_t) p[11]) << 24));
-			if (size > 4)
-				dmi_write(target, DMI_SBDATA1,
-						((uint32_t) p[4]) |
-						(((uint32_t) p[5]) << 8) |
-						(((uint32_t) p[6]) << 16) |
-						(((uint32_t) p[7]) << 24));
-			uint32_t value = p[0];
-			if (size > 2) {
-				value |= ((uint32_t) p[2]) << 16;
-				value |= ((uint32_t) p[3]) << 24;
-			}
-			if (size > 1)
-				value |= ((uint32_t) p[1]) << 8;
-			dmi_write(target, DMI_SBDATA0, value);
+		uint32_t sbcs = sb_sbaccess(size);
+		sbcs = set_field(sbcs, DMI_SBCS_SBAUTOINCREMENT, 1);
+		dmi_write(target, DMI_SBCS, sbcs);
 
-			log_memory_access(address + i * size, value, size, false);
+		sb_write_address(target, next_address);
 
-			if (info->bus_master_write_delay) {
-				jtag_add_runtest(info->bus_master_write_delay, TAP_IDLE);
-				if (jtag_execute_queue() != ERROR_OK) {
-					LOG_ERROR("Failed to scan idle sequence");
-					return ERROR_FAIL;
+		bool restart = false;
+		while (!restart && next_address < end_address) {
+			uint32_t start = (next_address - address) / size;
+			uint32_t end = start;
+			struct riscv_batch *batch = riscv_batch_alloc(target, SB_BATCH_SCANS,
+					info->dmi_busy_delay + info->bus_master_write_delay);
+
+			while (end < count &&
+					riscv_batch_available_scans(batch) >= data_regs + 2) {
+				const uint8_t *p = buffer + end * size;
+				for (unsigned j = data_regs; j > 0; j--) {
+					unsigned offset = (j - 1) * 4;
+					uint32_t value = buf_get_u32(p + offset, 0, 8 * MIN(size, 4));
+					riscv_batch_add_dmi_write(batch, DMI_SBDATA0 + j - 1, value);
+					log_memory_access(address + end * size + offset, value,
+							MIN(size, 4), false);
 				}
+				end++;
 			}
-		}
-
-		if (read_sbcs_nonbusy(target, &sbcs) != ERROR_OK)
-			return ERROR_FAIL;
+			size_t sbcs_key = riscv_batch_add_dmi_read(batch, DMI_SBCS);
 
-		if (get_field(sbcs, DMI_SBCS_SBBUSYERROR)) {
-			/* We wrote while the target was busy. Slow down and try again. */
-			dmi_write(target, DMI_SBCS, DMI_SBCS_SBBUSYERROR);
-			next_address = sb_read_address(target);
-			info->bus_master_write_delay += info->bus_master_write_delay / 10 + 1;
-			continue;
-		}
+			bool dmi_busy;
+			uint32_t batch_sbcs;
+			int result = sb_batch_run(target, batch, sbcs_key, end == count,
+					&dmi_busy, &batch_sbcs);
+			riscv_batch_free(batch);
+			if (result != ERROR_OK)
+				return ERROR_FAIL;
 
-		unsigned error = get_field(sbcs, DMI_SBCS_SBERROR);
-		if (error == 0) {
-			next_address = end_address;
-		} else {
-			/* Some error indicating the bus access failed, but not because of
-			 * something we did wrong. */
-			dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
-			return ERROR_FAIL;
+			if (dmi_busy || get_field(batch_sbcs, DMI_SBCS_SBBUSYERROR) ||
+					get_field(batch_sbcs, DMI_SBCS_SBERROR)) {
+				if (sb_batch_error(target, dmi_busy, &batch_sbcs, false) != ERROR_OK)
+					return ERROR_FAIL;
+				target_addr_t sbaddress = sb_read_address(target);
+				if (sbaddress >= next_address && sbaddress < end_address)
+					next_address = sbaddress;
+				restart = true;
+			} else {
+				next_address = address + end * size;
+			}
 		}
 	}
 
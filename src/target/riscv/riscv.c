@@ -283,6 +283,7 @@ static void riscv_free_registers(struct target *target)
 				free(target->reg_cache->reg_list[i].arch_info);
 			free(target->reg_cache->reg_list);
 		}
+		register_cache_index_free(target->reg_cache);
 		free(target->reg_cache);
 	}
 }
@@ -0,0 +1,773 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/log.h>
+#include <helper/command.h>
+#include <helper/time_support.h>
+
+#include "target.h"
+#include "rtt.h"
+
+/* Polling starts at the minimum interval and backs off, doubling, up to the
+ * maximum interval while the up channels stay empty. */
+#define RTT_POLL_MIN_DEFAULT	10
+#define RTT_POLL_MAX_DEFAULT	100
+
+/* Chunk size used while scanning target memory for the control block. */
+#define RTT_SEARCH_CHUNK	1024
+
+/* Upper bound on the buffer counts read from the control block, so that a
+ * corrupted block does not make us allocate (and read) megabytes. */
+#define RTT_MAX_CHANNELS	32
+
+#define RTT_CHANNEL_NAME_LENGTH	32
+
+struct rtt_channel {
+	char name[RTT_CHANNEL_NAME_LENGTH];
+	uint32_t name_addr;
+	uint32_t buffer_addr;
+	uint32_t size;
+	uint32_t write_offset;
+	uint32_t read_offset;
+	uint32_t flags;
+	/* bytes transferred since rtt start */
+	uint64_t bytes;
+};
+
+struct rtt_sink {
+	unsigned int channel;
+	rtt_sink_t sink;
+	void *priv;
+	struct rtt_sink *next;
+};
+
+static struct {
+	struct target *target;
+	bool configured;
+	target_addr_t address;
+	uint32_t size;
+	char id[RTT_ID_MAX_LENGTH + 1];
+
+	bool started;
+	bool found;
+	target_addr_t cb_address;
+	uint32_t num_up;
+	uint32_t num_down;
+	struct rtt_channel up[RTT_MAX_CHANNELS];
+	struct rtt_channel down[RTT_MAX_CHANNELS];
+
+	unsigned int interval_min;
+	unsigned int interval_max;
+	unsigned int interval;
+	int64_t last_poll;
+	bool read_error;
+
+	uint64_t polls;
+	uint64_t start_time;
+
+	struct rtt_sink *sinks;
+} rtt = {
+	.id = "SEGGER RTT",
+	.interval_min = RTT_POLL_MIN_DEFAULT,
+	.interval_max = RTT_POLL_MAX_DEFAULT,
+	.interval = RTT_POLL_MIN_DEFAULT,
+};
+
+static bool rtt_channel_has_sink(unsigned int channel)
+{
+	for (struct rtt_sink *s = rtt.sinks; s; s = s->next)
+		if (s->channel == channel)
+			return true;
+	return false;
+}
+
+static void rtt_parse_channel(struct target *target, const uint8_t *buf,
+		struct rtt_channel *channel)
+{
+	channel->name_addr = target_buffer_get_u32(target, buf);
+	channel->buffer_addr = target_buffer_get_u32(target, buf + 4);
+	channel->size = target_buffer_get_u32(target, buf + 8);
+	channel->write_offset = target_buffer_get_u32(target, buf + 12);
+	channel->read_offset = target_buffer_get_u32(target, buf + 16);
+	channel->flags = target_buffer_get_u32(target, buf + 20);
+}
+
+static bool rtt_channel_valid(const struct rtt_channel *channel)
+{
+	return channel->buffer_addr && channel->size &&
+		channel->write_offset < channel->size &&
+		channel->read_offset < channel->size;
+}
+
+static void rtt_read_channel_name(struct target *target,
+		struct rtt_channel *channel)
+{
+	uint8_t name[RTT_CHANNEL_NAME_LENGTH];
+
+	channel->name[0] = '\0';
+	if (!channel->name_addr)
+		return;
+
+	if (target_read_buffer(target, channel->name_addr, sizeof(name), name) != ERROR_OK)
+		return;
+
+	memcpy(channel->name, name, sizeof(name));
+	channel->name[sizeof(channel->name) - 1] = '\0';
+}
+
+/*
+ * Read the whole control block, header and all buffer descriptors, with a
+ * single memory access.
+ */
+static int rtt_read_control_block(bool read_names)
+{
+	struct target *target = rtt.target;
+	uint8_t header[RTT_CB_HEADER_SIZE];
+	int retval;
+
+	if (!rtt.num_up && !rtt.num_down) {
+		retval = target_read_buffer(target, rtt.cb_address, sizeof(header), header);
+		if (retval != ERROR_OK)
+			return retval;
+
+		uint32_t num_up = target_buffer_get_u32(target, header + RTT_ID_MAX_LENGTH);
+		uint32_t num_down = target_buffer_get_u32(target, header + RTT_ID_MAX_LENGTH + 4);
+		if (num_up > RTT_MAX_CHANNELS || num_down > RTT_MAX_CHANNELS) {
+			LOG_ERROR("rtt: invalid control block at 0x%" TARGET_PRIxADDR
+					" (%" PRIu32 " up, %" PRIu32 " down buffers)",
+					rtt.cb_address, num_up, num_down);
+			return ERROR_FAIL;
+		}
+		rtt.num_up = num_up;
+		rtt.num_down = num_down;
+	}
+
+	uint32_t size = RTT_CB_HEADER_SIZE +
+		(rtt.num_up + rtt.num_down) * RTT_BUFFER_DESC_SIZE;
+	uint8_t cb[RTT_CB_HEADER_SIZE + 2 * RTT_MAX_CHANNELS * RTT_BUFFER_DESC_SIZE];
+
+	retval = target_read_buffer(target, rtt.cb_address, size, cb);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the target may have been reset and the block moved or cleared */
+	if (strncmp((char *)cb, rtt.id, RTT_ID_MAX_LENGTH)) {
+		LOG_DEBUG("rtt: control block at 0x%" TARGET_PRIxADDR " is gone",
+				rtt.cb_address);
+		rtt.found = false;
+		return ERROR_FAIL;
+	}
+
+	const uint8_t *desc = cb + RTT_CB_HEADER_SIZE;
+	for (unsigned int i = 0; i < rtt.num_up; i++, desc += RTT_BUFFER_DESC_SIZE)
+		rtt_parse_channel(target, desc, &rtt.up[i]);
+	for (unsigned int i = 0; i < rtt.num_down; i++, desc += RTT_BUFFER_DESC_SIZE)
+		rtt_parse_channel(target, desc, &rtt.down[i]);
+
+	if (read_names) {
+		for (unsigned int i = 0; i < rtt.num_up; i++)
+			rtt_read_channel_name(target, &rtt.up[i]);
+		for (unsigned int i = 0; i < rtt.num_down; i++)
+			rtt_read_channel_name(target, &rtt.down[i]);
+	}
+
+	return ERROR_OK;
+}
+
+static int rtt_find_control_block(void)
+{
+	struct target *target = rtt.target;
+	size_t id_length = strlen(rtt.id);
+	uint8_t buf[RTT_SEARCH_CHUNK];
+
+	/* consecutive chunks overlap by the identifier length, so that an
+	 * identifier straddling two chunks is still found */
+	for (uint32_t offset = 0; offset < rtt.size; ) {
+		uint32_t chunk = MIN(rtt.size - offset, RTT_SEARCH_CHUNK);
+		if (chunk < id_length)
+			break;
+
+		int retval = target_read_buffer(target, rtt.address + offset, chunk, buf);
+		if (retval != ERROR_OK)
+			return retval;
+
+		for (uint32_t i = 0; i + id_length <= chunk; i++) {
+			if (!memcmp(buf + i, rtt.id, id_length)) {
+				rtt.cb_address = rtt.address + offset + i;
+				rtt.num_up = 0;
+				rtt.num_down = 0;
+				rtt.found = true;
+				LOG_INFO("rtt: control block found at 0x%" TARGET_PRIxADDR,
+						rtt.cb_address);
+				return ERROR_OK;
+			}
+		}
+
+		if (offset + chunk >= rtt.size)
+			break;
+		offset += chunk - id_length + 1;
+	}
+
+	return ERROR_FAIL;
+}
+
+static int rtt_locate(void)
+{
+	int retval = rtt_find_control_block();
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = rtt_read_control_block(true);
+	if (retval != ERROR_OK) {
+		rtt.found = false;
+		return retval;
+	}
+
+	LOG_INFO("rtt: %" PRIu32 " up and %" PRIu32 " down channels",
+			rtt.num_up, rtt.num_down);
+	return ERROR_OK;
+}
+
+static int rtt_deliver(unsigned int channel, const uint8_t *data, size_t length)
+{
+	for (struct rtt_sink *s = rtt.sinks; s; s = s->next) {
+		if (s->channel != channel)
+			continue;
+		int retval = s->sink(channel, data, length, s->priv);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	return ERROR_OK;
+}
+
+/* Ring segments closer than this are read together, gap included. */
+#define RTT_READ_GAP		64
+/* Upper bound for a single merged read. */
+#define RTT_READ_MAX		16384
+
+/* a part of an up channel ring to read, see rtt_read_segments() */
+struct rtt_segment {
+	uint32_t address;
+	uint32_t length;
+	uint8_t *data;
+};
+
+static int rtt_segment_compare(const void *a, const void *b)
+{
+	const struct rtt_segment *sa = a;
+	const struct rtt_segment *sb = b;
+
+	if (sa->address != sb->address)
+		return sa->address < sb->address ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Read the pending data of all up channels, merging segments that are
+ * next to each other in target memory (the rings are usually allocated
+ * together) into a single memory read.
+ */
+static int rtt_read_segments(struct rtt_segment *segments, unsigned int count)
+{
+	struct target *target = rtt.target;
+
+	qsort(segments, count, sizeof(*segments), rtt_segment_compare);
+
+	for (unsigned int first = 0; first < count; ) {
+		uint32_t start = segments[first].address;
+		uint32_t end = start + segments[first].length;
+		unsigned int last = first + 1;
+
+		for (; last < count; last++) {
+			uint32_t seg_end = segments[last].address + segments[last].length;
+			if (segments[last].address > end + RTT_READ_GAP ||
+					seg_end - start > RTT_READ_MAX)
+				break;
+			if (seg_end > end)
+				end = seg_end;
+		}
+
+		int retval;
+		if (last == first + 1) {
+			retval = target_read_buffer(target, start, end - start,
+					segments[first].data);
+		} else {
+			uint8_t *buf = malloc(end - start);
+			if (!buf) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+			retval = target_read_buffer(target, start, end - start, buf);
+			for (unsigned int i = first; i < last && retval == ERROR_OK; i++)
+				memcpy(segments[i].data, buf + segments[i].address - start,
+						segments[i].length);
+			free(buf);
+		}
+		if (retval != ERROR_OK)
+			return retval;
+
+		first = last;
+	}
+
+	return ERROR_OK;
+}
+
+/*
+ * Drain all up channels that have a sink, the descriptors must be fresh.
+ * The data is read with as few memory reads as possible, then all read
+ * offsets are handed back to the target in one batch, before the data is
+ * delivered.
+ */
+static int rtt_drain_channels(bool *got_data)
+{
+	struct target *target = rtt.target;
+	struct rtt_segment segments[2 * RTT_MAX_CHANNELS];
+	target_addr_t rd_addr[RTT_MAX_CHANNELS];
+	uint32_t rd_value[RTT_MAX_CHANNELS];
+	uint8_t *data[RTT_MAX_CHANNELS] = { NULL };
+	uint32_t length[RTT_MAX_CHANNELS] = { 0 };
+	unsigned int num_segments = 0, num_rd = 0;
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < rtt.num_up; i++) {
+		struct rtt_channel *channel = &rtt.up[i];
+
+		if (!rtt_channel_has_sink(i) || !rtt_channel_valid(channel) ||
+				channel->write_offset == channel->read_offset)
+			continue;
+
+		uint32_t wr = channel->write_offset;
+		uint32_t rd = channel->read_offset;
+		length[i] = (wr > rd) ? wr - rd : channel->size - rd + wr;
+
+		data[i] = malloc(length[i]);
+		if (!data[i]) {
+			LOG_ERROR("Out of memory");
+			retval = ERROR_FAIL;
+			goto out;
+		}
+
+		uint32_t first = (wr > rd) ? length[i] : channel->size - rd;
+		segments[num_segments++] = (struct rtt_segment) {
+			.address = channel->buffer_addr + rd,
+			.length = first,
+			.data = data[i],
+		};
+		if (first < length[i])
+			segments[num_segments++] = (struct rtt_segment) {
+				.address = channel->buffer_addr,
+				.length = wr,
+				.data = data[i] + first,
+			};
+
+		rd_addr[num_rd] = rtt.cb_address + RTT_CB_HEADER_SIZE +
+			i * RTT_BUFFER_DESC_SIZE + 16;
+		rd_value[num_rd] = wr;
+		num_rd++;
+	}
+
+	if (!num_rd)
+		goto out;
+
+	retval = rtt_read_segments(segments, num_segments);
+	if (retval != ERROR_OK)
+		goto out;
+
+	/* hand the space back to the target before delivering the data */
+	retval = target_write_u32_list(target, rd_addr, rd_value, num_rd);
+	if (retval != ERROR_OK)
+		goto out;
+
+	*got_data = true;
+	for (unsigned int i = 0; i < rtt.num_up; i++) {
+		if (!data[i])
+			continue;
+		rtt.up[i].read_offset = rtt.up[i].write_offset;
+		rtt.up[i].bytes += length[i];
+		rtt_deliver(i, data[i], length[i]);
+	}
+
+out:
+	for (unsigned int i = 0; i < rtt.num_up; i++)
+		free(data[i]);
+	return retval;
+}
+
+static int rtt_poll(void)
+{
+	bool got_data = false;
+	int retval;
+
+	if (!rtt.found) {
+		retval = rtt_locate();
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	retval = rtt_read_control_block(false);
+	if (retval != ERROR_OK)
+		return retval;
+
+	rtt.polls++;
+
+	retval = rtt_drain_channels(&got_data);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (got_data)
+		rtt.interval = rtt.interval_min;
+	else
+		rtt.interval = MIN(rtt.interval * 2, rtt.interval_max);
+
+	return ERROR_OK;
+}
+
+static int rtt_timer_callback(void *priv)
+{
+	if (!rtt.started || !rtt.sinks)
+		return ERROR_OK;
+
+	int64_t now = timeval_ms();
+	if (now - rtt.last_poll < rtt.interval)
+		return ERROR_OK;
+	rtt.last_poll = now;
+
+	struct target *target = rtt.target;
+	if (target->state != TARGET_RUNNING && target->state != TARGET_HALTED)
+		return ERROR_OK;
+
+	int retval = rtt_poll();
+	if (retval != ERROR_OK) {
+		if (!rtt.read_error)
+			LOG_WARNING("rtt: failed to poll the control block");
+		rtt.read_error = true;
+		rtt.interval = rtt.interval_max;
+	} else {
+		rtt.read_error = false;
+	}
+
+	return ERROR_OK;
+}
+
+int rtt_register_sink(unsigned int channel, rtt_sink_t sink, void *priv)
+{
+	struct rtt_sink *s = malloc(sizeof(*s));
+	if (!s) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	s->channel = channel;
+	s->sink = sink;
+	s->priv = priv;
+	s->next = rtt.sinks;
+	rtt.sinks = s;
+
+	rtt.interval = rtt.interval_min;
+	return ERROR_OK;
+}
+
+int rtt_unregister_sink(unsigned int channel, rtt_sink_t sink, void *priv)
+{
+	for (struct rtt_sink **p = &rtt.sinks; *p; p = &(*p)->next) {
+		struct rtt_sink *s = *p;
+		if (s->channel == channel && s->sink == sink && s->priv == priv) {
+			*p = s->next;
+			free(s);
+			return ERROR_OK;
+		}
+	}
+	return ERROR_FAIL;
+}
+
+int rtt_write_channel(unsigned int channel, const uint8_t *data,
+		size_t *length)
+{
+	struct target *target = rtt.target;
+
+	if (!rtt.started || !rtt.found || channel >= rtt.num_down) {
+		*length = 0;
+		return ERROR_FAIL;
+	}
+
+	/* the descriptor is refreshed to pick up the target's read offset */
+	target_addr_t desc_addr = rtt.cb_address + RTT_CB_HEADER_SIZE +
+		(rtt.num_up + channel) * RTT_BUFFER_DESC_SIZE;
+	uint8_t desc[RTT_BUFFER_DESC_SIZE];
+	int retval = target_read_buffer(target, desc_addr, sizeof(desc), desc);
+	if (retval != ERROR_OK) {
+		*length = 0;
+		return retval;
+	}
+
+	struct rtt_channel *down = &rtt.down[channel];
+	rtt_parse_channel(target, desc, down);
+	if (!rtt_channel_valid(down)) {
+		*length = 0;
+		return ERROR_FAIL;
+	}
+
+	uint32_t wr = down->write_offset;
+	uint32_t rd = down->read_offset;
+	uint32_t space = (rd > wr) ? rd - wr - 1 : down->size - wr + rd - 1;
+	uint32_t count = MIN(*length, space);
+
+	uint32_t first = MIN(count, down->size - wr);
+	retval = target_write_buffer(target, down->buffer_addr + wr, first, data);
+	if (retval == ERROR_OK && count > first)
+		retval = target_write_buffer(target, down->buffer_addr, count - first,
+				data + first);
+	if (retval != ERROR_OK) {
+		*length = 0;
+		return retval;
+	}
+
+	wr = (wr + count) % down->size;
+	retval = target_write_u32(target, desc_addr + 12, wr);
+	if (retval != ERROR_OK) {
+		*length = 0;
+		return retval;
+	}
+
+	down->write_offset = wr;
+	down->bytes += count;
+	*length = count;
+
+	/* a reply is likely on its way, look for it soon */
+	rtt.interval = rtt.interval_min;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtt_setup_command)
+{
+	if (CMD_ARGC < 2 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_addr_t address;
+	uint32_t size;
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+
+	if (CMD_ARGC == 3) {
+		if (!strlen(CMD_ARGV[2]) || strlen(CMD_ARGV[2]) > RTT_ID_MAX_LENGTH) {
+			command_print(CMD, "control block id must be 1 to %d characters",
+					RTT_ID_MAX_LENGTH);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		strcpy(rtt.id, CMD_ARGV[2]);
+	}
+
+	if (size < strlen(rtt.id)) {
+		command_print(CMD, "search range is smaller than the control block id");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	rtt.address = address;
+	rtt.size = size;
+	rtt.configured = true;
+	rtt.found = false;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtt_start_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!rtt.configured) {
+		command_print(CMD, "rtt is not configured, use 'rtt setup' first");
+		return ERROR_FAIL;
+	}
+
+	if (rtt.started)
+		return ERROR_OK;
+
+	rtt.target = get_current_target(CMD_CTX);
+	rtt.found = false;
+	rtt.num_up = 0;
+	rtt.num_down = 0;
+	memset(rtt.up, 0, sizeof(rtt.up));
+	memset(rtt.down, 0, sizeof(rtt.down));
+
+	int retval = rtt_locate();
+	if (retval != ERROR_OK)
+		LOG_INFO("rtt: control block not found yet, searching in the background");
+
+	retval = target_register_timer_callback(rtt_timer_callback,
+			rtt.interval_min, TARGET_TIMER_TYPE_PERIODIC, NULL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	rtt.started = true;
+	rtt.read_error = false;
+	rtt.interval = rtt.interval_min;
+	rtt.last_poll = 0;
+	rtt.polls = 0;
+	rtt.start_time = timeval_ms();
+	return ERROR_OK;
+}
+
+static void rtt_stop(void)
+{
+	if (!rtt.started)
+		return;
+
+	target_unregister_timer_callback(rtt_timer_callback, NULL);
+	rtt.started = false;
+	rtt.found = false;
+}
+
+COMMAND_HANDLER(handle_rtt_stop_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	rtt_stop();
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtt_polling_interval_command)
+{
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC > 0) {
+		unsigned int min, max;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], min);
+		max = min;
+		if (CMD_ARGC > 1)
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], max);
+		if (!min || max < min) {
+			command_print(CMD, "invalid polling interval");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+
+		rtt.interval_min = min;
+		rtt.interval_max = max;
+		rtt.interval = min;
+
+		if (rtt.started) {
+			target_unregister_timer_callback(rtt_timer_callback, NULL);
+			int retval = target_register_timer_callback(rtt_timer_callback,
+					rtt.interval_min, TARGET_TIMER_TYPE_PERIODIC, NULL);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	command_print(CMD, "rtt polling interval: %u ms to %u ms",
+			rtt.interval_min, rtt.interval_max);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtt_channels_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!rtt.started || !rtt.found) {
+		command_print(CMD, "rtt control block not found");
+		return ERROR_OK;
+	}
+
+	int64_t elapsed = timeval_ms() - rtt.start_time;
+	if (elapsed <= 0)
+		elapsed = 1;
+
+	command_print(CMD, "control block at 0x%" TARGET_PRIxADDR
+			", %" PRIu64 " polls, current interval %u ms",
+			rtt.cb_address, rtt.polls, rtt.interval);
+
+	for (unsigned int i = 0; i < rtt.num_up; i++)
+		command_print(CMD, "up %u: '%s', size %" PRIu32 ", %" PRIu64
+				" bytes (%" PRIu64 " B/s)", i, rtt.up[i].name, rtt.up[i].size,
+				rtt.up[i].bytes, rtt.up[i].bytes * 1000 / elapsed);
+	for (unsigned int i = 0; i < rtt.num_down; i++)
+		command_print(CMD, "down %u: '%s', size %" PRIu32 ", %" PRIu64
+				" bytes (%" PRIu64 " B/s)", i, rtt.down[i].name, rtt.down[i].size,
+				rtt.down[i].bytes, rtt.down[i].bytes * 1000 / elapsed);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration rtt_subcommand_handlers[] = {
+	{
+		.name = "setup",
+		.handler = handle_rtt_setup_command,
+		.mode = COMMAND_ANY,
+		.help = "set the memory range searched for the control block",
+		.usage = "address size [ID]",
+	},
+	{
+		.name = "start",
+		.handler = handle_rtt_start_command,
+		.mode = COMMAND_EXEC,
+		.help = "locate the control block and start polling",
+		.usage = "",
+	},
+	{
+		.name = "stop",
+		.handler = handle_rtt_stop_command,
+		.mode = COMMAND_EXEC,
+		.help = "stop polling",
+		.usage = "",
+	},
+	{
+		.name = "polling_interval",
+		.handler = handle_rtt_polling_interval_command,
+		.mode = COMMAND_ANY,
+		.help = "display or set the minimum and maximum polling interval",
+		.usage = "[min_ms [max_ms]]",
+	},
+	{
+		.name = "channels",
+		.handler = handle_rtt_channels_command,
+		.mode = COMMAND_EXEC,
+		.help = "list the channels and their throughput",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration rtt_command_handlers[] = {
+	{
+		.name = "rtt",
+		.mode = COMMAND_ANY,
+		.help = "target RAM ring buffer console",
+		.usage = "",
+		.chain = rtt_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int rtt_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, rtt_command_handlers);
+}
+
+void rtt_exit(void)
+{
+	rtt_stop();
+
+	while (rtt.sinks) {
+		struct rtt_sink *s = rtt.sinks;
+		rtt.sinks = s->next;
+		free(s);
+	}
+}
@@ -0,0 +1,70 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef OPENOCD_TARGET_RTT_H
+#define OPENOCD_TARGET_RTT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct command_context;
+
+/*
+ * Target RAM ring buffer console.
+ *
+ * The firmware links a control block, laid out like the SEGGER RTT one:
+ *
+ *   char id[16];                 "SEGGER RTT" by default
+ *   int32_t max_up_buffers;
+ *   int32_t max_down_buffers;
+ *   struct rtt_buffer up[max_up_buffers];
+ *   struct rtt_buffer down[max_down_buffers];
+ *
+ * with each buffer descriptor made of six 32-bit words: name, buffer,
+ * size, write offset, read offset and flags. The target writes into the
+ * "up" rings and OpenOCD reads them while the target runs; the "down"
+ * rings carry data the other way.
+ */
+
+/** Maximum length of the control block identifier. */
+#define RTT_ID_MAX_LENGTH 16
+
+/** Size of one buffer descriptor in the control block. */
+#define RTT_BUFFER_DESC_SIZE 24
+
+/** Size of the control block header, before the buffer descriptors. */
+#define RTT_CB_HEADER_SIZE (RTT_ID_MAX_LENGTH + 8)
+
+/**
+ * Called with the data read from an up channel.
+ */
+typedef int (*rtt_sink_t)(unsigned int channel, const uint8_t *data,
+		size_t length, void *priv);
+
+int rtt_register_sink(unsigned int channel, rtt_sink_t sink, void *priv);
+int rtt_unregister_sink(unsigned int channel, rtt_sink_t sink, void *priv);
+
+/**
+ * Write to a down channel. On return @a length holds the number of bytes
+ * that fit into the ring buffer.
+ */
+int rtt_write_channel(unsigned int channel, const uint8_t *data,
+		size_t *length);
+
+int rtt_register_commands(struct command_context *cmd_ctx);
+void rtt_exit(void);
+
+#endif /* OPENOCD_TARGET_RTT_H */
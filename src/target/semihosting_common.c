@@ -74,6 +74,13 @@ static int semihosting_common_fileio_end(struct target *target, int result,
 
 static int semihosting_read_fields(struct target *target, size_t number,
 	uint8_t *fields);
+static int semihosting_read_fields_window(struct target *target, size_t number,
+	uint8_t *fields);
+static const uint8_t *semihosting_window_data(struct semihosting *semihosting,
+	uint64_t addr, size_t len);
+static uint8_t *semihosting_io_buf(struct semihosting *semihosting, size_t len);
+static int semihosting_read_string(struct target *target, uint64_t addr,
+	char **str, size_t *len);
 static int semihosting_write_fields(struct target *target, size_t number,
 	uint8_t *fields);
 static uint64_t semihosting_get_field(struct target *target, size_t index,
@@ -121,6 +128,10 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->result = -1;
 	semihosting->sys_errno = -1;
 	semihosting->cmdline = NULL;
+	semihosting->param_window_addr = 0;
+	semihosting->param_window_len = 0;
+	semihosting->io_buf = NULL;
+	semihosting->io_buf_size = 0;
 
 	/* If possible, update it in setup(). */
 	semihosting->setup_time = clock();
@@ -685,7 +696,7 @@ int semihosting_common(struct target *target)
 					semihosting->result = -1;
 					semihosting->sys_errno = ENOMEM;
 				} else {
-					retval = target_read_memory(target, addr, 1, len, fn);
+					retval = target_read_buffer(target, addr, len, fn);
 					if (retval != ERROR_OK) {
 						free(fn);
 						return retval;
@@ -805,7 +816,7 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = addr;
 					fileio_info->param_3 = len;
 				} else {
-					uint8_t *buf = malloc(len);
+					uint8_t *buf = semihosting_io_buf(semihosting, len);
 					if (!buf) {
 						semihosting->result = -1;
 						semihosting->sys_errno = ENOMEM;
@@ -821,15 +832,12 @@ int semihosting_common(struct target *target)
 							retval = target_write_buffer(target, addr,
 									semihosting->result,
 									buf);
-							if (retval != ERROR_OK) {
-								free(buf);
+							if (retval != ERROR_OK)
 								return retval;
-							}
 							/* the number of bytes NOT filled in */
 							semihosting->result = len -
 								semihosting->result;
 						}
-						free(buf);
 					}
 				}
 			}
@@ -889,7 +897,7 @@ int semihosting_common(struct target *target)
 						semihosting->sys_errno = ENOMEM;
 					} else {
 						retval =
-							target_read_memory(target, addr, 1, len,
+							target_read_buffer(target, addr, len,
 								fn);
 						if (retval != ERROR_OK) {
 							free(fn);
@@ -949,14 +957,14 @@ int semihosting_common(struct target *target)
 						semihosting->result = -1;
 						semihosting->sys_errno = ENOMEM;
 					} else {
-						retval = target_read_memory(target, addr1, 1, len1,
+						retval = target_read_buffer(target, addr1, len1,
 								fn1);
 						if (retval != ERROR_OK) {
 							free(fn1);
 							free(fn2);
 							return retval;
 						}
-						retval = target_read_memory(target, addr2, 1, len2,
+						retval = target_read_buffer(target, addr2, len2,
 								fn2);
 						if (retval != ERROR_OK) {
 							free(fn1);
@@ -1063,10 +1071,7 @@ int semihosting_common(struct target *target)
 						semihosting->result = -1;
 						semihosting->sys_errno = ENOMEM;
 					} else {
-						retval = target_read_memory(target,
-								addr,
-								1,
-								len,
+						retval = target_read_buffer(target, addr, len,
 								cmd);
 						if (retval != ERROR_OK) {
 							free(cmd);
@@ -1130,7 +1135,7 @@ int semihosting_common(struct target *target)
 			 * - 0 if the call is successful.
 			 * - The number of bytes that are not written, if there is an error.
 			 */
-			retval = semihosting_read_fields(target, 3, fields);
+			retval = semihosting_read_fields_window(target, 3, fields);
 			if (retval != ERROR_OK)
 				return retval;
 			else {
@@ -1144,16 +1149,21 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = addr;
 					fileio_info->param_3 = len;
 				} else {
-					uint8_t *buf = malloc(len);
+					/* small payloads usually came with the parameters */
+					const uint8_t *buf = semihosting_window_data(semihosting, addr, len);
+					if (!buf) {
+						uint8_t *io_buf = semihosting_io_buf(semihosting, len);
+						if (io_buf) {
+							retval = target_read_buffer(target, addr, len, io_buf);
+							if (retval != ERROR_OK)
+								return retval;
+						}
+						buf = io_buf;
+					}
 					if (!buf) {
 						semihosting->result = -1;
 						semihosting->sys_errno = ENOMEM;
 					} else {
-						retval = target_read_buffer(target, addr, len, buf);
-						if (retval != ERROR_OK) {
-							free(buf);
-							return retval;
-						}
 						semihosting->result = write(fd, buf, len);
 						semihosting->sys_errno = errno;
 						LOG_DEBUG("write(%d, 0x%" PRIx64 ", %zu)=%d",
@@ -1167,8 +1177,6 @@ int semihosting_common(struct target *target)
 							semihosting->result = len -
 								semihosting->result;
 						}
-
-						free(buf);
 					}
 				}
 			}
@@ -1217,35 +1225,24 @@ int semihosting_common(struct target *target)
 			 * Return
 			 * None. The RETURN REGISTER is corrupted.
 			 */
-			if (semihosting->is_fileio) {
-				size_t count = 0;
-				uint64_t addr = semihosting->param;
-				for (;; addr++) {
-					unsigned char c;
-					retval = target_read_memory(target, addr, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (c == '\0')
-						break;
-					count++;
+			{
+				char *str;
+				size_t count;
+				retval = semihosting_read_string(target, semihosting->param,
+						&str, &count);
+				if (retval != ERROR_OK)
+					return retval;
+				if (semihosting->is_fileio) {
+					semihosting->hit_fileio = true;
+					fileio_info->identifier = "write";
+					fileio_info->param_1 = 1;
+					fileio_info->param_2 = semihosting->param;
+					fileio_info->param_3 = count;
+				} else {
+					fwrite(str, 1, count, stdout);
+					semihosting->result = 0;
 				}
-				semihosting->hit_fileio = true;
-				fileio_info->identifier = "write";
-				fileio_info->param_1 = 1;
-				fileio_info->param_2 = semihosting->param;
-				fileio_info->param_3 = count;
-			} else {
-				uint64_t addr = semihosting->param;
-				do {
-					unsigned char c;
-					retval = target_read_memory(target, addr++, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (!c)
-						break;
-					putchar(c);
-				} while (1);
-				semihosting->result = 0;
+				free(str);
 			}
 			break;
 
@@ -1418,6 +1415,118 @@ static int semihosting_read_fields(struct target *target, size_t number,
 			number * (semihosting->word_size_bytes / 4), fields);
 }
 
+/**
+ * Read the fields of a command together with the target memory that
+ * follows them, up to the next SEMIHOSTING_PARAM_WINDOW boundary, in a
+ * single transfer of words. Like the string blocks below, the window never
+ * crosses into the next (possibly unmapped) region. If the fields
+ * themselves cross the boundary, or the window cannot be read, only the
+ * fields are.
+ */
+static int semihosting_read_fields_window(struct target *target, size_t number,
+	uint8_t *fields)
+{
+	struct semihosting *semihosting = target->semihosting;
+	size_t fields_len = number * semihosting->word_size_bytes;
+	uint64_t start = semihosting->param & ~(uint64_t)3;
+	uint64_t end = (semihosting->param | (SEMIHOSTING_PARAM_WINDOW - 1)) + 1;
+
+	semihosting->param_window_len = 0;
+	if (semihosting->param + fields_len > end)
+		return semihosting_read_fields(target, number, fields);
+
+	if (target_read_memory(target, start, 4, (end - start) / 4,
+			semihosting->param_window) != ERROR_OK)
+		return semihosting_read_fields(target, number, fields);
+
+	semihosting->param_window_addr = start;
+	semihosting->param_window_len = end - start;
+	memcpy(fields, semihosting->param_window + (semihosting->param - start), fields_len);
+	return ERROR_OK;
+}
+
+/**
+ * Return the host copy of [addr, addr + len) if it was read along with the
+ * parameter block, NULL otherwise.
+ */
+static const uint8_t *semihosting_window_data(struct semihosting *semihosting,
+	uint64_t addr, size_t len)
+{
+	uint64_t offset = addr - semihosting->param_window_addr;
+
+	if (addr < semihosting->param_window_addr ||
+			offset > semihosting->param_window_len ||
+			len > semihosting->param_window_len - offset)
+		return NULL;
+
+	return semihosting->param_window + offset;
+}
+
+/**
+ * Return the host-side I/O buffer, grown to at least len bytes.
+ */
+static uint8_t *semihosting_io_buf(struct semihosting *semihosting, size_t len)
+{
+	if (len > semihosting->io_buf_size) {
+		uint8_t *buf = realloc(semihosting->io_buf, len);
+		if (!buf)
+			return NULL;
+		semihosting->io_buf = buf;
+		semihosting->io_buf_size = len;
+	}
+
+	/* never NULL, even for empty transfers */
+	return semihosting->io_buf ? : semihosting->param_window;
+}
+
+/* Strings are fetched in blocks that never cross a block boundary, so at
+ * most the block holding the terminator is read past the end of the string,
+ * and never into the next (possibly unmapped) region. */
+#define SEMIHOSTING_STRING_BLOCK 64
+
+/**
+ * Read a nul-terminated string from target memory, a block at a time
+ * instead of one byte per access.
+ */
+static int semihosting_read_string(struct target *target, uint64_t addr,
+	char **str, size_t *len)
+{
+	uint8_t block[SEMIHOSTING_STRING_BLOCK];
+	char *buf = NULL;
+	size_t count = 0;
+
+	for (;;) {
+		size_t chunk = SEMIHOSTING_STRING_BLOCK - (addr % SEMIHOSTING_STRING_BLOCK);
+		int retval = target_read_buffer(target, addr, chunk, block);
+		if (retval != ERROR_OK) {
+			free(buf);
+			return retval;
+		}
+
+		uint8_t *end = memchr(block, '\0', chunk);
+		size_t n = end ? (size_t)(end - block) : chunk;
+
+		char *new_buf = realloc(buf, count + n + 1);
+		if (!new_buf) {
+			free(buf);
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		buf = new_buf;
+		memcpy(buf + count, block, n);
+		count += n;
+		addr += chunk;
+
+		if (end)
+			break;
+	}
+
+	buf[count] = '\0';
+	*str = buf;
+	*len = count;
+	return ERROR_OK;
+}
+
 /**
  * Write all fields of a command from buffer to target.
  */
@@ -88,6 +88,13 @@ enum semihosting_reported_exceptions {
 	ADP_STOPPED_RUN_TIME_ERROR = ((2 << 16) + 35),
 };
 
+/*
+ * SYS_WRITE reads the parameter block together with the target memory
+ * that follows it, up to the next boundary of this size, hoping to find
+ * the payload there (buffers on the stack right above the block).
+ */
+#define SEMIHOSTING_PARAM_WINDOW	256
+
 struct target;
 
 /*
@@ -152,6 +159,17 @@ struct semihosting {
 	/** The current time when 'execution starts' */
 	clock_t setup_time;
 
+	/** Target memory read along with the parameter block, see
+	 * SEMIHOSTING_PARAM_WINDOW; valid for the current operation only. */
+	uint8_t param_window[SEMIHOSTING_PARAM_WINDOW];
+	uint64_t param_window_addr;
+	size_t param_window_len;
+
+	/** Host-side buffer for the SYS_READ and SYS_WRITE payloads, kept
+	 * between operations. */
+	uint8_t *io_buf;
+	size_t io_buf_size;
+
 	int (*setup)(struct target *target, int enable);
 	int (*post_result)(struct target *target);
 };
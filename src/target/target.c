@@ -55,6 +55,7 @@
 #include "rtos/rtos.h"
 #include "transport/transport.h"
 #include "arm_cti.h"
+#include "semihosting_common.h"
 
 /* default halt wait timeout (ms) */
 #define DEFAULT_HALT_TIMEOUT 5000
@@ -1174,6 +1175,45 @@ int target_remove_breakpoint(struct target *target,
 	return target->type->remove_breakpoint(target, breakpoint);
 }
 
+int target_add_breakpoints(struct target *target,
+		struct breakpoint **breakpoints, unsigned int count)
+{
+	if (target->state != TARGET_HALTED) {
+		LOG_WARNING("target %s is not halted (add breakpoints)", target_name(target));
+		return ERROR_TARGET_NOT_HALTED;
+	}
+	if (!target->type->add_breakpoints || count < 2)
+		return ERROR_OK;
+	return target->type->add_breakpoints(target, breakpoints, count);
+}
+
+int target_remove_breakpoints(struct target *target,
+		struct breakpoint **breakpoints, unsigned int count)
+{
+	int retval = ERROR_OK;
+	bool batched = false;
+
+	if (target->type->remove_breakpoints && count > 1) {
+		if (target->type->remove_breakpoints(target, breakpoints, count) != ERROR_OK)
+			LOG_DEBUG("batched breakpoint removal failed, retrying one by one");
+		batched = true;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct breakpoint *breakpoint = breakpoints[i];
+
+		/* the batch took care of these */
+		if (batched && breakpoint->type == BKPT_SOFT && !breakpoint->set)
+			continue;
+
+		int r = target_remove_breakpoint(target, breakpoint);
+		LOG_DEBUG("free BPID: %" PRIu32 " --> %d", breakpoint->unique_id, r);
+		if (r != ERROR_OK)
+			retval = r;
+	}
+	return retval;
+}
+
 int target_add_watchpoint(struct target *target,
 		struct watchpoint *watchpoint)
 {
@@ -2015,8 +2055,10 @@ static void target_destroy(struct target *target)
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
-	if (target->semihosting)
+	if (target->semihosting) {
+		free(target->semihosting->io_buf);
 		free(target->semihosting);
+	}
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
 
@@ -2042,7 +2084,10 @@ static void target_destroy(struct target *target)
 		target->smp = 0;
 	}
 
+	free(target->breakpoint_index);
+	free(target->watchpoint_index);
 	free(target->gdb_port_override);
+	free(target->rtos_elf);
 	free(target->type);
 	free(target->trace_info);
 	free(target->fileio_info);
@@ -2472,6 +2517,25 @@ int target_write_u32(struct target *target, target_addr_t address, uint32_t valu
 	return retval;
 }
 
+int target_write_u32_list(struct target *target, const target_addr_t *addresses,
+		const uint32_t *values, unsigned int count)
+{
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	if (target->type->write_u32_list && count > 1)
+		return target->type->write_u32_list(target, addresses, values, count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		int retval = target_write_u32(target, addresses[i], values[i]);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	return ERROR_OK;
+}
+
 int target_write_u16(struct target *target, target_addr_t address, uint16_t value)
 {
 	int retval;
@@ -3815,16 +3879,34 @@ COMMAND_HANDLER(handle_bp_command)
 	}
 }
 
+static COMMAND_HELPER(parse_rbp_addresses, target_addr_t *addrs)
+{
+	for (unsigned int i = 0; i < CMD_ARGC; i++)
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[i], addrs[i]);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_rbp_command)
 {
-	if (CMD_ARGC != 1)
+	if (CMD_ARGC < 1)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	target_addr_t addr;
-	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], addr);
+	target_addr_t *addrs = malloc(CMD_ARGC * sizeof(*addrs));
+	if (!addrs) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = CALL_COMMAND_HANDLER(parse_rbp_addresses, addrs);
+	if (retval != ERROR_OK) {
+		free(addrs);
+		return retval;
+	}
 
 	struct target *target = get_current_target(CMD_CTX);
-	breakpoint_remove(target, addr);
+	breakpoint_remove_batch(target, addrs, CMD_ARGC);
+	free(addrs);
 
 	return ERROR_OK;
 }
@@ -4533,6 +4615,231 @@ static int target_array2mem(Jim_Interp *interp, struct target *target,
 	return e;
 }
 
+/* read_memory/write_memory move data in chunks of this size, aligned to it,
+ * and leave any further splitting to the target and adapter code which
+ * knows its best transfer size. */
+#define TARGET_TCL_MEMORY_CHUNK	(64 * 1024)
+
+static int target_jim_memory_args(Jim_Interp *interp, Jim_Obj *const *argv,
+		int argc, const char *usage, target_addr_t *address, unsigned int *width,
+		bool *is_phys)
+{
+	jim_wide wide;
+
+	if (argc < 3 || argc > 4) {
+		Jim_WrongNumArgs(interp, 0, argv, usage);
+		return JIM_ERR;
+	}
+
+	if (Jim_GetWide(interp, argv[0], &wide) != JIM_OK)
+		return JIM_ERR;
+	*address = wide;
+
+	if (Jim_GetWide(interp, argv[1], &wide) != JIM_OK)
+		return JIM_ERR;
+	switch (wide) {
+		case 8:
+		case 16:
+		case 32:
+		case 64:
+			*width = wide / 8;
+			break;
+		default:
+			Jim_SetResultString(interp, "invalid width, must be 8, 16, 32 or 64", -1);
+			return JIM_ERR;
+	}
+
+	if (*address & (*width - 1)) {
+		Jim_SetResultFormatted(interp, "address is not aligned for %d byte accesses", (int)*width);
+		return JIM_ERR;
+	}
+
+	*is_phys = false;
+	if (argc == 4) {
+		if (strcmp(Jim_GetString(argv[3], NULL), "phys")) {
+			Jim_WrongNumArgs(interp, 0, argv, usage);
+			return JIM_ERR;
+		}
+		*is_phys = true;
+	}
+
+	return JIM_OK;
+}
+
+static uint32_t target_jim_memory_chunk(target_addr_t address, unsigned int width,
+		uint64_t count)
+{
+	uint32_t chunk = (TARGET_TCL_MEMORY_CHUNK - (address % TARGET_TCL_MEMORY_CHUNK)) / width;
+	return MIN(count, chunk);
+}
+
+/* read_memory address width count ['phys']: returns a list of numbers */
+static int target_jim_read_memory(Jim_Interp *interp, struct target *target,
+		int argc, Jim_Obj *const *argv)
+{
+	const char *usage = "address width count ['phys']";
+	target_addr_t address;
+	unsigned int width;
+	bool is_phys;
+	jim_wide count;
+
+	if (target_jim_memory_args(interp, argv, argc, usage, &address, &width, &is_phys) != JIM_OK)
+		return JIM_ERR;
+
+	if (Jim_GetWide(interp, argv[2], &count) != JIM_OK)
+		return JIM_ERR;
+	if (count < 0 || (uint64_t)count > UINT32_MAX / width) {
+		Jim_SetResultString(interp, "invalid count", -1);
+		return JIM_ERR;
+	}
+
+	uint8_t *buffer = malloc(MIN((uint64_t)count * width, TARGET_TCL_MEMORY_CHUNK));
+	if (!buffer && count) {
+		LOG_ERROR("Out of memory");
+		return JIM_ERR;
+	}
+
+	Jim_Obj *result = Jim_NewListObj(interp, NULL, 0);
+
+	while (count) {
+		uint32_t n = target_jim_memory_chunk(address, width, count);
+		int retval;
+
+		if (is_phys)
+			retval = target_read_phys_memory(target, address, width, n, buffer);
+		else
+			retval = target_read_memory(target, address, width, n, buffer);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("read_memory: read at " TARGET_ADDR_FMT " with width=%u"
+					" and count=%" PRIu32 " failed", address, width, n);
+			free(buffer);
+			Jim_FreeNewObj(interp, result);
+			Jim_SetResultString(interp, "read_memory: failed to read memory", -1);
+			return JIM_ERR;
+		}
+
+		for (uint32_t i = 0; i < n; i++) {
+			uint64_t v = 0;
+			switch (width) {
+				case 8:
+					v = target_buffer_get_u64(target, &buffer[i * width]);
+					break;
+				case 4:
+					v = target_buffer_get_u32(target, &buffer[i * width]);
+					break;
+				case 2:
+					v = target_buffer_get_u16(target, &buffer[i * width]);
+					break;
+				case 1:
+					v = buffer[i];
+					break;
+			}
+			Jim_ListAppendElement(interp, result, Jim_NewIntObj(interp, v));
+		}
+
+		count -= n;
+		address += n * width;
+	}
+
+	free(buffer);
+	Jim_SetResult(interp, result);
+	return JIM_OK;
+}
+
+/* write_memory address width data ['phys']: data is a list of numbers */
+static int target_jim_write_memory(Jim_Interp *interp, struct target *target,
+		int argc, Jim_Obj *const *argv)
+{
+	const char *usage = "address width data ['phys']";
+	target_addr_t address;
+	unsigned int width;
+	bool is_phys;
+
+	if (target_jim_memory_args(interp, argv, argc, usage, &address, &width, &is_phys) != JIM_OK)
+		return JIM_ERR;
+
+	int count = Jim_ListLength(interp, argv[2]);
+	uint8_t *buffer = malloc(MIN((uint64_t)count * width, TARGET_TCL_MEMORY_CHUNK));
+	if (!buffer && count) {
+		LOG_ERROR("Out of memory");
+		return JIM_ERR;
+	}
+
+	int index = 0;
+	while (index < count) {
+		uint32_t n = target_jim_memory_chunk(address, width, count - index);
+
+		for (uint32_t i = 0; i < n; i++, index++) {
+			jim_wide v;
+			if (Jim_GetWide(interp, Jim_ListGetIndex(interp, argv[2], index), &v) != JIM_OK) {
+				free(buffer);
+				return JIM_ERR;
+			}
+			switch (width) {
+				case 8:
+					target_buffer_set_u64(target, &buffer[i * width], v);
+					break;
+				case 4:
+					target_buffer_set_u32(target, &buffer[i * width], v);
+					break;
+				case 2:
+					target_buffer_set_u16(target, &buffer[i * width], v);
+					break;
+				case 1:
+					buffer[i] = v & 0xff;
+					break;
+			}
+		}
+
+		int retval;
+		if (is_phys)
+			retval = target_write_phys_memory(target, address, width, n, buffer);
+		else
+			retval = target_write_memory(target, address, width, n, buffer);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("write_memory: write at " TARGET_ADDR_FMT " with width=%u"
+					" and count=%" PRIu32 " failed", address, width, n);
+			free(buffer);
+			Jim_SetResultString(interp, "write_memory: failed to write memory", -1);
+			return JIM_ERR;
+		}
+
+		address += n * width;
+	}
+
+	free(buffer);
+	Jim_SetEmptyResult(interp);
+	return JIM_OK;
+}
+
+static int jim_read_memory(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
+{
+	struct command_context *context = current_command_context(interp);
+	assert(context != NULL);
+
+	struct target *target = get_current_target(context);
+	if (target == NULL) {
+		LOG_ERROR("read_memory: no current target");
+		return JIM_ERR;
+	}
+
+	return target_jim_read_memory(interp, target, argc - 1, argv + 1);
+}
+
+static int jim_write_memory(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
+{
+	struct command_context *context = current_command_context(interp);
+	assert(context != NULL);
+
+	struct target *target = get_current_target(context);
+	if (target == NULL) {
+		LOG_ERROR("write_memory: no current target");
+		return JIM_ERR;
+	}
+
+	return target_jim_write_memory(interp, target, argc - 1, argv + 1);
+}
+
 /* FIX? should we propagate errors here rather than printing them
  * and continuing?
  */
@@ -4604,6 +4911,7 @@ enum target_cfg_param {
 	TCFG_CHAIN_POSITION,
 	TCFG_DBGBASE,
 	TCFG_RTOS,
+	TCFG_RTOS_ELF,
 	TCFG_DEFER_EXAMINE,
 	TCFG_GDB_PORT,
 };
@@ -4620,6 +4928,7 @@ static Jim_Nvp nvp_config_opts[] = {
 	{ .name = "-chain-position",   .value = TCFG_CHAIN_POSITION },
 	{ .name = "-dbgbase",          .value = TCFG_DBGBASE },
 	{ .name = "-rtos",             .value = TCFG_RTOS },
+	{ .name = "-rtos-elf",         .value = TCFG_RTOS_ELF },
 	{ .name = "-defer-examine",    .value = TCFG_DEFER_EXAMINE },
 	{ .name = "-gdb-port",         .value = TCFG_GDB_PORT },
 	{ .name = NULL, .value = -1 }
@@ -4903,6 +5212,22 @@ no_params:
 			/* loop for more */
 			break;
 
+		case TCFG_RTOS_ELF:
+			if (goi->isconfigure) {
+				const char *s;
+				e = Jim_GetOpt_String(goi, &s, NULL);
+				if (e != JIM_OK)
+					return e;
+				free(target->rtos_elf);
+				target->rtos_elf = s[0] ? strdup(s) : NULL;
+			} else {
+				if (goi->argc != 0)
+					goto no_params;
+			}
+			Jim_SetResultString(goi->interp, target->rtos_elf ? : "", -1);
+			/* loop for more */
+			break;
+
 		case TCFG_DEFER_EXAMINE:
 			/* DEFER_EXAMINE */
 			target->defer_examine = true;
@@ -4966,6 +5291,20 @@ static int jim_target_array2mem(Jim_Interp *interp,
 	return target_array2mem(interp, target, argc - 1, argv + 1);
 }
 
+static int jim_target_read_memory(Jim_Interp *interp,
+		int argc, Jim_Obj *const *argv)
+{
+	struct target *target = Jim_CmdPrivData(interp);
+	return target_jim_read_memory(interp, target, argc - 1, argv + 1);
+}
+
+static int jim_target_write_memory(Jim_Interp *interp,
+		int argc, Jim_Obj *const *argv)
+{
+	struct target *target = Jim_CmdPrivData(interp);
+	return target_jim_write_memory(interp, target, argc - 1, argv + 1);
+}
+
 static int jim_target_tap_disabled(Jim_Interp *interp)
 {
 	Jim_SetResultFormatted(interp, "[TAP is disabled]");
@@ -5302,6 +5641,21 @@ static const struct command_registration target_instance_command_handlers[] = {
 			"from target memory",
 		.usage = "arrayname bitwidth address count",
 	},
+	{
+		.name = "read_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_target_read_memory,
+		.help = "Read 8/16/32/64 bit values from target memory "
+			"and return them as a list",
+		.usage = "address width count ['phys']",
+	},
+	{
+		.name = "write_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_target_write_memory,
+		.help = "Write a list of 8/16/32/64 bit values to target memory",
+		.usage = "address width data ['phys']",
+	},
 	{
 		.name = "eventlist",
 		.handler = handle_target_event_list,
@@ -5493,6 +5847,7 @@ static int target_create(Jim_GetOptInfo *goi)
 
 	target->rtos = NULL;
 	target->rtos_auto_detect = false;
+	target->rtos_elf = NULL;
 
 	target->gdb_port_override = NULL;
 
@@ -5519,6 +5874,7 @@ static int target_create(Jim_GetOptInfo *goi)
 
 	if (e != JIM_OK) {
 		free(target->gdb_port_override);
+		free(target->rtos_elf);
 		free(target->type);
 		free(target);
 		return e;
@@ -5537,6 +5893,7 @@ static int target_create(Jim_GetOptInfo *goi)
 		if (e != ERROR_OK) {
 			LOG_DEBUG("target_create failed");
 			free(target->gdb_port_override);
+			free(target->rtos_elf);
 			free(target->type);
 			free(target->cmd_name);
 			free(target);
@@ -6309,8 +6666,8 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.name = "rbp",
 		.handler = handle_rbp_command,
 		.mode = COMMAND_EXEC,
-		.help = "remove breakpoint",
-		.usage = "address",
+		.help = "remove breakpoints",
+		.usage = "address [address ...]",
 	},
 	{
 		.name = "wp",
@@ -6373,6 +6730,21 @@ static const struct command_registration target_exec_command_handlers[] = {
 			"and write the 8/16/32 bit values",
 		.usage = "arrayname bitwidth address count",
 	},
+	{
+		.name = "read_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_read_memory,
+		.help = "read 8/16/32/64 bit values from target memory "
+			"and return them as a list",
+		.usage = "address width count ['phys']",
+	},
+	{
+		.name = "write_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_write_memory,
+		.help = "write a list of 8/16/32/64 bit values to target memory",
+		.usage = "address width data ['phys']",
+	},
 	{
 		.name = "reset_nag",
 		.handler = handle_target_reset_nag,
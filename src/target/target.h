@@ -171,6 +171,14 @@ struct target {
 	struct reg_cache *reg_cache;		/* the first register cache of the target (core regs) */
 	struct breakpoint *breakpoints;		/* list of breakpoints */
 	struct watchpoint *watchpoints;		/* list of watchpoints */
+	/* the same breakpoints and watchpoints, sorted by (address, asid) and
+	 * kept in list order, see breakpoints.c */
+	struct breakpoint **breakpoint_index;
+	unsigned int breakpoint_count;
+	unsigned int breakpoint_index_size;
+	struct watchpoint **watchpoint_index;
+	unsigned int watchpoint_count;
+	unsigned int watchpoint_index_size;
 	struct trace *trace_info;			/* generic trace information */
 	struct debug_msg_receiver *dbgmsg;	/* list of debug message receivers */
 	uint32_t dbg_msg_enabled;			/* debug message status */
@@ -196,6 +204,7 @@ struct target {
 	struct rtos *rtos;					/* Instance of Real Time Operating System support */
 	bool rtos_auto_detect;				/* A flag that indicates that the RTOS has been specified as "auto"
 										 * and must be detected when symbols are offered */
+	char *rtos_elf;						/* ELF file to look up the RTOS symbols in, instead of asking GDB */
 	struct backoff_timer backoff;
 	int smp;							/* add some target attributes for smp support */
 	struct target_list *head;
@@ -463,6 +472,19 @@ int target_add_hybrid_breakpoint(struct target *target,
 
 int target_remove_breakpoint(struct target *target,
 		struct breakpoint *breakpoint);
+/**
+ * Insert the software breakpoints in @a breakpoints that are not set yet,
+ * through target->type->add_breakpoints when the target has it. The
+ * caller adds whatever is still unset one by one.
+ */
+int target_add_breakpoints(struct target *target,
+		struct breakpoint **breakpoints, unsigned int count);
+/**
+ * Remove all of @a breakpoints, batching the software ones through
+ * target->type->remove_breakpoints when the target has it.
+ */
+int target_remove_breakpoints(struct target *target,
+		struct breakpoint **breakpoints, unsigned int count);
 /**
  * Add the @a watchpoint for @a target.
  *
@@ -729,6 +751,12 @@ int target_write_u64(struct target *target, target_addr_t address, uint64_t valu
 int target_write_u32(struct target *target, target_addr_t address, uint32_t value);
 int target_write_u16(struct target *target, target_addr_t address, uint16_t value);
 int target_write_u8(struct target *target, target_addr_t address, uint8_t value);
+/**
+ * Write @a count 32-bit values, each to its own address, in a single batch
+ * when the target supports it and one by one otherwise.
+ */
+int target_write_u32_list(struct target *target, const target_addr_t *addresses,
+		const uint32_t *values, unsigned int count);
 
 int target_write_phys_u64(struct target *target, target_addr_t address, uint64_t value);
 int target_write_phys_u32(struct target *target, target_addr_t address, uint32_t value);
@@ -144,6 +144,14 @@ struct target_type {
 	int (*write_buffer)(struct target *target, target_addr_t address,
 			uint32_t size, const uint8_t *buffer);
 
+	/**
+	 * Optional: write each 32-bit value to its (unrelated) address, sharing
+	 * the round trips to the adapter. Do @b not call this function
+	 * directly, use target_write_u32_list() instead.
+	 */
+	int (*write_u32_list)(struct target *target, const target_addr_t *addresses,
+			const uint32_t *values, unsigned int count);
+
 	int (*checksum_memory)(struct target *target, target_addr_t address,
 			uint32_t count, uint32_t *checksum);
 	int (*blank_check_memory)(struct target *target,
@@ -172,6 +180,16 @@ struct target_type {
 	 */
 	int (*remove_breakpoint)(struct target *target, struct breakpoint *breakpoint);
 
+	/* optional: insert or remove a set of software breakpoints at once,
+	 * sharing the memory round trips and cache maintenance. Breakpoints
+	 * the method did not handle keep their "set" state and are passed to
+	 * add_breakpoint()/remove_breakpoint() one by one.
+	 */
+	int (*add_breakpoints)(struct target *target,
+			struct breakpoint **breakpoints, unsigned int count);
+	int (*remove_breakpoints)(struct target *target,
+			struct breakpoint **breakpoints, unsigned int count);
+
 	/* add watchpoint ... see add_breakpoint() comment above. */
 	int (*add_watchpoint)(struct target *target, struct watchpoint *watchpoint);
 
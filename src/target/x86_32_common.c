@@ -1298,6 +1298,8 @@ void x86_32_common_reset_breakpoints_watchpoints(struct target *t)
 		free(t->watchpoints);
 		t->watchpoints = next_w;
 	}
+	t->breakpoint_count = 0;
+	t->watchpoint_count = 0;
 
 	for (int i = 0; i < x86_32->num_hw_bpoints; i++) {
 		debug_reg_list[i].used = 0;
@@ -2878,7 +2878,7 @@ static void xscale_build_reg_cache(struct target *target)
 
 	(*cache_p) = arm_build_reg_cache(target, arm);
 
-	(*cache_p)->next = malloc(sizeof(struct reg_cache));
+	(*cache_p)->next = calloc(1, sizeof(struct reg_cache));
 	cache_p = &(*cache_p)->next;
 
 	/* fill in values for the xscale reg cache */